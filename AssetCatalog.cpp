@@ -0,0 +1,280 @@
+#include "precomp.h"
+
+namespace {
+	constexpr uint ChunkId(const char* id) {
+		return static_cast<uint>(id[0]) | static_cast<uint>(id[1]) << 8 | static_cast<uint>(id[2]) << 16 | static_cast<uint>(id[3]) << 24;
+	}
+
+	// walks the chunk headers of a .vox file and only reads the SIZE chunks, the voxel data is skipped
+	bool ReadVoxInfo(const std::string& path, VoxInfo& info) {
+		FILE* f = fopen(path.c_str(), "rb");
+		if (!f) return false;
+
+		// "VOX ", the version and the MAIN chunk, whose children are the models and the scene graph
+		uint header[5];
+		bool ok = fread(header, sizeof(uint), 5, f) == 5 && header[0] == ChunkId("VOX ") && header[2] == ChunkId("MAIN");
+		if (ok && header[3]) ok = _fseeki64(f, header[3], SEEK_CUR) == 0;
+
+		uint chunk[3];
+		long long largest = -1;
+		while (ok && fread(chunk, sizeof(uint), 3, f) == 3) {
+			uint64_t skip = static_cast<uint64_t>(chunk[1]) + chunk[2];
+			if (chunk[0] == ChunkId("SIZE") && chunk[1] >= 3 * sizeof(int)) {
+				int size[3];
+				ok = fread(size, sizeof(int), 3, f) == 3;
+				const long long volume = static_cast<long long>(size[0]) * size[1] * size[2];
+				if (ok && volume > largest) {
+					largest = volume;
+					info.size = make_int3(size[0], size[2], size[1]);
+				}
+				info.modelCount++;
+				skip -= 3 * sizeof(int);
+			}
+			if (skip) ok = _fseeki64(f, static_cast<long long>(skip), SEEK_CUR) == 0;
+		}
+		fclose(f);
+
+		std::error_code error;
+		info.fileSize = std::filesystem::file_size(path, error);
+		return info.modelCount > 0;
+	}
+
+	bool ReadWholeFile(const std::string& path, std::vector<uint8_t>& data) {
+		FILE* f = fopen(path.c_str(), "rb");
+		if (!f) return false;
+		std::error_code error;
+		const uintmax_t size = std::filesystem::file_size(path, error);
+		bool ok = !error && size > 0;
+		if (ok) {
+			data.resize(static_cast<size_t>(size));
+			ok = fread(data.data(), 1, data.size(), f) == data.size();
+		}
+		fclose(f);
+		return ok;
+	}
+
+	bool HasExtension(const std::string& name, const std::string& extensions) {
+		const std::string extension = std::filesystem::path(name).extension().string();
+		if (extension.empty()) return false;
+		size_t start = 0;
+		while (start <= extensions.size()) {
+			size_t end = extensions.find(';', start);
+			if (end == std::string::npos) end = extensions.size();
+			if (extensions.compare(start, end - start, extension) == 0) return true;
+			start = end + 1;
+		}
+		return false;
+	}
+}
+
+AssetCatalog::AssetCatalog() {
+	wakeEvent = CreateEventA(nullptr, FALSE, FALSE, nullptr);
+	worker = std::thread(&AssetCatalog::WorkerLoop, this);
+}
+
+AssetCatalog::~AssetCatalog() {
+	Stop();
+}
+
+void AssetCatalog::Stop() {
+	if (!running.exchange(false)) return;
+	SetEvent(wakeEvent);
+	if (worker.joinable()) worker.join();
+
+	for (auto& directory : directories) {
+		if (directory.second.notification != INVALID_HANDLE_VALUE) FindCloseChangeNotification(directory.second.notification);
+		directory.second.notification = INVALID_HANDLE_VALUE;
+	}
+	if (wakeEvent) CloseHandle(wakeEvent);
+	wakeEvent = nullptr;
+}
+
+std::string AssetCatalog::Normalize(const std::string& directory) {
+	std::string key = directory;
+	std::replace(key.begin(), key.end(), '\\', '/');
+	if (key.empty() || key.back() != '/') key += '/';
+	return key;
+}
+
+void AssetCatalog::Enqueue(const std::function<void()>& job) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(job);
+	}
+	SetEvent(wakeEvent);
+}
+
+void AssetCatalog::Watch(const std::string& directory) {
+	const std::string key = Normalize(directory);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (directories.count(key)) return;
+		directories[key];
+	}
+	Enqueue([this, key]() { Scan(key); });
+}
+
+void AssetCatalog::WorkerLoop() {
+	while (running) {
+		std::vector<HANDLE> handles = { wakeEvent };
+		std::vector<std::string> watched;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (const auto& directory : directories) {
+				if (directory.second.notification == INVALID_HANDLE_VALUE) continue;
+				handles.push_back(directory.second.notification);
+				watched.push_back(directory.first);
+			}
+		}
+
+		// sleeps until a job comes in or one of the directories changes
+		const DWORD result = WaitForMultipleObjects(static_cast<DWORD>(handles.size()), handles.data(), FALSE, INFINITE);
+		if (!running) break;
+		const DWORD changed = result - WAIT_OBJECT_0;
+		if (changed >= 1 && changed < handles.size()) {
+			FindNextChangeNotification(handles[changed]);
+			Scan(watched[changed - 1]);
+		}
+
+		while (running) {
+			std::function<void()> job;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (jobs.empty()) break;
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+			job();
+		}
+	}
+}
+
+void AssetCatalog::Scan(const std::string& key) {
+	HANDLE notification;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		notification = directories[key].notification;
+	}
+	// the watch starts before the scan, so changes made while scanning trigger another one
+	if (notification == INVALID_HANDLE_VALUE) {
+		notification = FindFirstChangeNotificationA(key.c_str(), FALSE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
+	}
+
+	std::vector<std::string> names;
+	std::unordered_map<std::string, std::filesystem::file_time_type> writeTimes;
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(key, error)) {
+		if (!entry.is_regular_file(error)) continue;
+		const std::string name = entry.path().filename().string();
+		names.push_back(name);
+		writeTimes[name] = entry.last_write_time(error);
+	}
+	std::sort(names.begin(), names.end());
+
+	std::vector<std::string> changedVoxFiles;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Directory& directory = directories[key];
+		directory.notification = notification;
+
+		// anything cached for files that changed or went away is stale
+		for (const auto& previous : directory.writeTimes) {
+			auto current = writeTimes.find(previous.first);
+			if (current != writeTimes.end() && current->second == previous.second) continue;
+			preloaded.erase(key + previous.first);
+			voxInfos.erase(key + previous.first);
+		}
+		for (const auto& name : names) {
+			auto previous = directory.writeTimes.find(name);
+			const bool isNew = previous == directory.writeTimes.end() || previous->second != writeTimes[name];
+			if (isNew && HasExtension(name, ".vox")) changedVoxFiles.push_back(key + name);
+		}
+
+		directory.names = std::move(names);
+		directory.writeTimes = std::move(writeTimes);
+		directory.scanned = true;
+
+		// the lists of this directory get rebuilt on their next use
+		for (auto it = lists.begin(); it != lists.end();) {
+			if (it->second->directory == key) it = lists.erase(it);
+			else ++it;
+		}
+	}
+
+	for (const auto& path : changedVoxFiles) {
+		VoxInfo info;
+		if (!ReadVoxInfo(path, info)) continue;
+		std::lock_guard<std::mutex> lock(mutex);
+		voxInfos[path] = info;
+	}
+}
+
+std::shared_ptr<const AssetList> AssetCatalog::GetList(const std::string& directory, const std::string& extensions) {
+	const std::string key = Normalize(directory);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto cached = lists.find(key + '|' + extensions);
+		if (cached != lists.end()) return cached->second;
+
+		auto scanned = directories.find(key);
+		if (scanned != directories.end() && scanned->second.scanned) {
+			std::shared_ptr<AssetList> list = std::make_shared<AssetList>();
+			list->directory = key;
+			for (const auto& name : scanned->second.names) {
+				if (HasExtension(name, extensions)) list->names.push_back(name);
+			}
+			for (const auto& name : list->names) {
+				list->items.push_back(name.c_str());
+			}
+			lists[key + '|' + extensions] = list;
+			return list;
+		}
+	}
+
+	Watch(directory);
+	std::shared_ptr<AssetList> empty = std::make_shared<AssetList>();
+	empty->directory = key;
+	return empty;
+}
+
+bool AssetCatalog::GetVoxInfo(const std::string& path, VoxInfo& info) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = voxInfos.find(path);
+	if (it == voxInfos.end()) return false;
+	info = it->second;
+	return true;
+}
+
+void AssetCatalog::Preload(const std::string& path) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (preloaded.count(path)) return;
+		preloaded[path] = nullptr;
+	}
+	Enqueue([this, path]() {
+		std::shared_ptr<std::vector<uint8_t>> data = std::make_shared<std::vector<uint8_t>>();
+		const bool ok = ReadWholeFile(path, *data);
+		std::lock_guard<std::mutex> lock(mutex);
+		// gone if the file was read or changed in the meantime
+		auto it = preloaded.find(path);
+		if (it == preloaded.end()) return;
+		if (ok) it->second = data;
+		else preloaded.erase(it);
+	});
+}
+
+bool AssetCatalog::ReadFile(const std::string& path, std::vector<uint8_t>& data) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = preloaded.find(path);
+		if (it != preloaded.end()) {
+			std::shared_ptr<std::vector<uint8_t>> ready = it->second;
+			preloaded.erase(it);
+			if (ready) {
+				data = std::move(*ready);
+				return true;
+			}
+		}
+	}
+	return ReadWholeFile(path, data);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "SvenUtils/Singleton.h"
+
+// what the catalog knows about a .vox file without importing it
+struct VoxInfo {
+	int modelCount = 0;
+	int3 size = int3(0);	// of the largest model, y up like the imported worlds
+	uint64_t fileSize = 0;
+};
+
+// the files in a directory with one of the requested extensions. a snapshot, it stays valid while the catalog rescans
+struct AssetList {
+	std::string directory;				// with a trailing '/'
+	std::vector<std::string> names;
+	std::vector<const char*> items;		// the names as an array for ImGui::Combo
+
+	std::string GetPath(const int index) const { return directory + names[index]; }
+	bool IsEmpty() const { return names.empty(); }
+};
+
+// keeps the contents of the asset directories in memory, so UI and scenes don't hit the filesystem every frame.
+// a worker thread scans a directory once, then waits for change notifications and only rescans when something
+// changed. the headers of .vox files are read in the background, and files can be preloaded ahead of their use.
+class AssetCatalog : public Singleton<AssetCatalog> {
+public:
+	AssetCatalog();
+	~AssetCatalog();
+
+	// starts scanning and watching a directory, GetList does this as well
+	void Watch(const std::string& directory);
+	// extensions separated by ';', like ".png;.hdr". empty until the first scan of the directory is done
+	std::shared_ptr<const AssetList> GetList(const std::string& directory, const std::string& extensions);
+	// false until the header of the file has been read
+	bool GetVoxInfo(const std::string& path, VoxInfo& info);
+
+	// reads a file into memory on the worker, so the next ReadFile doesn't have to wait for the disk
+	void Preload(const std::string& path);
+	// the preloaded contents of a file, or read right away if it isn't. a preloaded copy is handed over, not kept
+	bool ReadFile(const std::string& path, std::vector<uint8_t>& data);
+
+	void Stop();
+
+private:
+	struct Directory {
+		HANDLE notification = INVALID_HANDLE_VALUE;
+		bool scanned = false;
+		std::vector<std::string> names;
+		std::unordered_map<std::string, std::filesystem::file_time_type> writeTimes;
+	};
+
+	void WorkerLoop();
+	void Scan(const std::string& directory);
+	void Enqueue(const std::function<void()>& job);
+	static std::string Normalize(const std::string& directory);
+
+	std::map<std::string, Directory> directories;
+	std::map<std::string, std::shared_ptr<const AssetList>> lists;	// by directory + '|' + extensions
+	std::unordered_map<std::string, VoxInfo> voxInfos;
+	std::unordered_map<std::string, std::shared_ptr<std::vector<uint8_t>>> preloaded;	// null while still being read
+	std::mutex mutex;
+
+	std::deque<std::function<void()>> jobs;
+	HANDLE wakeEvent = nullptr;
+	std::thread worker;
+	std::atomic<bool> running = true;
+};
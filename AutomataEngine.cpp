@@ -0,0 +1,412 @@
+#include "precomp.h"
+
+namespace {
+	// the neighbourhoods of the original CA, Moore leaves out the edges that aren't in the xy plane
+	const int3 VonNeumannOffsets[] = {
+		int3(0, 0, 1), int3(0, 0, -1), int3(1, 0, 0), int3(-1, 0, 0), int3(0, 1, 0), int3(0, -1, 0)
+	};
+	const int3 MooreOffsets[] = {
+		int3(0, 0, 1), int3(0, 0, -1), int3(1, 0, 0), int3(-1, 0, 0), int3(0, 1, 0), int3(0, -1, 0),
+		int3(1, 1, 0), int3(1, -1, 0), int3(-1, 1, 0), int3(-1, -1, 0),
+		int3(1, 1, 1), int3(1, 1, -1), int3(1, -1, 1), int3(1, -1, -1),
+		int3(-1, 1, 1), int3(-1, 1, -1), int3(-1, -1, 1), int3(-1, -1, -1)
+	};
+
+	template <int CountBits>
+	inline void AddToCount(uint64_t* count, uint64_t bits) {
+		for (int k = 0; k < CountBits && bits; k++) {
+			const uint64_t carry = count[k] & bits;
+			count[k] ^= bits;
+			bits = carry;
+		}
+	}
+
+	// a mask of the cells whose count equals value
+	template <int CountBits>
+	inline uint64_t CountEquals(const uint64_t* count, const int value) {
+		uint64_t mask = ~0ull;
+		for (int k = 0; k < CountBits; k++) {
+			mask &= (value >> k & 1) ? count[k] : ~count[k];
+		}
+		return mask;
+	}
+}
+
+AutomataEngine::AutomataEngine(const int3& _dimensions) {
+	dimensions = int3((_dimensions.x + 63) & ~63, (_dimensions.y + BRICKSIZE - 1) & ~(BRICKSIZE - 1), (_dimensions.z + BRICKSIZE - 1) & ~(BRICKSIZE - 1));
+	wordsPerRow = dimensions.x / 64;
+	wordCount = static_cast<size_t>(wordsPerRow) * dimensions.y * dimensions.z;
+	regionCounts = int3(wordsPerRow, dimensions.y / BRICKSIZE, dimensions.z / BRICKSIZE);
+	const size_t regionCount = static_cast<size_t>(regionCounts.x) * regionCounts.y * regionCounts.z;
+	regionActive.resize(regionCount);
+	regionBusy.resize(regionCount);
+	regionAlive.resize(regionCount);
+	regionChangedAt.resize(regionCount);
+
+	alive[0] = static_cast<uint64_t*>(MALLOC64(wordCount * sizeof(uint64_t)));
+	alive[1] = static_cast<uint64_t*>(MALLOC64(wordCount * sizeof(uint64_t)));
+	occupied = static_cast<uint64_t*>(MALLOC64(wordCount * sizeof(uint64_t)));
+	states = static_cast<uint8_t*>(MALLOC64(wordCount * 64));
+	Clear();
+
+	const bool survival[MaxNeighbours] = { 0, 0, 0, 0, 1, 1 };
+	const bool spawn[MaxNeighbours] = { 0, 0, 0, 1 };
+	SetRules(survival, spawn, startState, GetKernel(NeighbourHood::Moore));
+}
+
+AutomataEngine::~AutomataEngine() {
+	FREE64(alive[0]);
+	FREE64(alive[1]);
+	FREE64(occupied);
+	FREE64(states);
+}
+
+std::vector<int3> AutomataEngine::GetKernel(const int neighbourhood) {
+	if (neighbourhood == NeighbourHood::VonNeumann) return std::vector<int3>(std::begin(VonNeumannOffsets), std::end(VonNeumannOffsets));
+	return std::vector<int3>(std::begin(MooreOffsets), std::end(MooreOffsets));
+}
+
+std::vector<int3> AutomataEngine::MakeKernel(const bool* cells) {
+	std::vector<int3> kernel;
+	for (int i = 0; i < 27; i++) {
+		if (i == 13 || !cells[i]) continue;
+		kernel.push_back(int3(i % 3 - 1, i / 3 % 3 - 1, i / 9 - 1));
+	}
+	return kernel;
+}
+
+void AutomataEngine::SetRules(const bool* survival, const bool* spawn, const int _startState, const std::vector<int3>& kernel) {
+	// with a single state there would be nothing to count down from
+	const int previousStartState = startState;
+	startState = std::clamp(_startState, 2, 255);
+	// every voxel gets a new colour, and other cells are alive now
+	if (startState != previousStartState) {
+		MarkAllChanged();
+		RebuildAlive();
+	}
+	// cells without alive neighbours spawn everywhere, so no region can be skipped
+	spawnsEverywhere = spawn[0];
+	if (spawnsEverywhere) ActivateAll();
+
+	// group the offsets per row, so every row of the neighbourhood is loaded once and shifted for x - 1 and x + 1
+	rowOffsets.clear();
+	int neighbourCount = 0;
+	for (const int3& offset : kernel) {
+		if (abs(offset.x) > 1 || abs(offset.y) > 1 || abs(offset.z) > 1 || (offset.x == 0 && offset.y == 0 && offset.z == 0)) continue;
+		auto row = std::find_if(rowOffsets.begin(), rowOffsets.end(), [&](const RowOffset& r) { return r.dy == offset.y && r.dz == offset.z; });
+		if (row == rowOffsets.end()) row = rowOffsets.insert(rowOffsets.end(), RowOffset{ offset.y, offset.z, false, false, false });
+		bool& neighbour = offset.x < 0 ? row->left : offset.x == 0 ? row->center : row->right;
+		if (!neighbour) neighbourCount++;
+		neighbour = true;
+	}
+	// the von neumann counts fit in 3 bits, which saves two planes on every add and compare
+	countBits = neighbourCount < 8 ? 3 : 5;
+
+	// counts the neighbourhood can't reach are left out
+	survivalCounts.clear();
+	spawnCounts.clear();
+	for (int i = 0; i <= min(neighbourCount, MaxNeighbours - 1); i++) {
+		if (survival[i]) survivalCounts.push_back(i);
+		if (spawn[i]) spawnCounts.push_back(i);
+	}
+
+	//color gradient based on state, red is alive, yellow is dying
+	colors[0] = 0;
+	for (int state = 1; state < startState; state++) {
+		const float t = static_cast<float>(state) / static_cast<float>(startState);
+		float4 c = lerp(float4(1, 0, 0, 1), float4(1, 1, 0, 1), t);
+		colors[state] = RGBF32_to_RGB8(&c);
+	}
+	// freshly seeded cells, and cells seeded with a higher start state before the rules changed
+	for (int state = startState; state < 256; state++) colors[state] = 0xff0000;
+}
+
+void AutomataEngine::Clear() {
+	memset(alive[0], 0, wordCount * sizeof(uint64_t));
+	memset(alive[1], 0, wordCount * sizeof(uint64_t));
+	memset(occupied, 0, wordCount * sizeof(uint64_t));
+	memset(states, 0, wordCount * 64);
+	statesValid = true;
+	highestState = 0;
+	aliveCount = 0;
+	MarkAllChanged();
+	std::fill(regionActive.begin(), regionActive.end(), 0);
+	activeRegions.clear();
+	if (spawnsEverywhere) ActivateAll();
+}
+
+void AutomataEngine::Randomize(const int3& center, const int radius, const float probability, const uint seed) {
+	Clear();
+	uint state = InitSeed(seed);
+	const int3 start = center - radius;
+	const int3 end = center + radius;
+	for (int x = start.x; x < end.x; x++) {
+		for (int y = start.y; y < end.y; y++) {
+			for (int z = start.z; z < end.z; z++) {
+				if (RandomFloat(state) > probability) continue;
+				// wrap around like the neighbours do
+				const int wx = (x % dimensions.x + dimensions.x) % dimensions.x;
+				const int wy = (y % dimensions.y + dimensions.y) % dimensions.y;
+				const int wz = (z % dimensions.z + dimensions.z) % dimensions.z;
+				const size_t cell = CellIndex(wx, wy, wz);
+				states[cell] = static_cast<uint8_t>(startState);
+				occupied[cell >> 6] |= 1ull << (cell & 63);
+				Activate(RegionIndex(wx / 64, wy / BRICKSIZE, wz / BRICKSIZE));
+				highestState = max(highestState, startState);
+			}
+		}
+	}
+}
+
+uint8_t AutomataEngine::GetState(const int x, const int y, const int z) const {
+	const size_t cell = CellIndex(x, y, z);
+	if (!statesValid) return static_cast<uint8_t>(occupied[cell >> 6] >> (cell & 63) & 1);
+	return states[cell];
+}
+
+void AutomataEngine::SyncStates() {
+	const long long words = static_cast<long long>(wordCount);
+#pragma omp parallel for schedule(static)
+	for (long long word = 0; word < words; word++) {
+		const uint64_t bits = occupied[word];
+		uint8_t* cells = states + word * 64;
+		for (int bit = 0; bit < 64; bit++) cells[bit] = static_cast<uint8_t>(bits >> bit & 1);
+	}
+	statesValid = true;
+}
+
+void AutomataEngine::RebuildAlive() {
+	if (!statesValid) SyncStates();
+	const uint8_t aliveState = static_cast<uint8_t>(startState - 1);
+	const int regionCount = static_cast<int>(regionActive.size());
+	long long aliveTotal = 0;
+#pragma omp parallel for schedule(dynamic, 4) reduction(+ : aliveTotal)
+	for (int region = 0; region < regionCount; region++) {
+		const int w = region % regionCounts.x;
+		const int startY = (region / regionCounts.x) % regionCounts.y * BRICKSIZE;
+		const int startZ = region / (regionCounts.x * regionCounts.y) * BRICKSIZE;
+		uint64_t busy = 0, anyAlive = 0;
+		for (int z = startZ; z < startZ + BRICKSIZE; z++) {
+			for (int y = startY; y < startY + BRICKSIZE; y++) {
+				const size_t word = WordIndex(w, y, z);
+				uint64_t bits = 0, visit = occupied[word];
+				while (visit) {
+					const int bit = static_cast<int>(_tzcnt_u64(visit));
+					visit &= visit - 1;
+					if (states[word * 64 + bit] == aliveState) bits |= 1ull << bit;
+				}
+				alive[current][word] = bits;
+				busy |= occupied[word];
+				anyAlive |= bits;
+				aliveTotal += static_cast<long long>(_mm_popcnt_u64(bits));
+			}
+		}
+		regionBusy[region] = busy != 0;
+		regionAlive[region] = anyAlive != 0;
+	}
+	aliveCount = aliveTotal;
+	// every region is looked at once, so the usual update picks the ones to step from scratch
+	ActivateAll();
+	UpdateActiveRegions();
+}
+
+void AutomataEngine::MarkAllChanged() {
+	generation++;
+	std::fill(regionChangedAt.begin(), regionChangedAt.end(), generation);
+}
+
+void AutomataEngine::Activate(const int region) {
+	if (regionActive[region]) return;
+	regionActive[region] = 1;
+	activeRegions.push_back(region);
+}
+
+void AutomataEngine::ActivateAll() {
+	for (int region = 0; region < static_cast<int>(regionActive.size()); region++) Activate(region);
+}
+
+void AutomataEngine::Step() {
+	Timer timer;
+	generation++;
+
+	// with two states an occupied cell is an alive one, once seeded cells and cells from rules with more states
+	// have counted down
+	using StepFunction = long long (AutomataEngine::*)();
+	static const StepFunction kernels[2][2] = {
+		{ &AutomataEngine::StepRegions<3, false>, &AutomataEngine::StepRegions<3, true> },
+		{ &AutomataEngine::StepRegions<5, false>, &AutomataEngine::StepRegions<5, true> }
+	};
+	const bool decay = startState > 2 || highestState > 1;
+	if (decay && !statesValid) SyncStates();
+	aliveCount = (this->*kernels[countBits == 3 ? 0 : 1][decay ? 1 : 0])();
+	if (decay) highestState = max(highestState - 1, startState - 1);
+	else statesValid = false;
+
+	current ^= 1;
+	UpdateActiveRegions();
+	lastStepTime = timer.elapsed();
+}
+
+template <int CountBits, bool Decay>
+long long AutomataEngine::StepRegions() {
+	const uint64_t* src = alive[current];
+	uint64_t* dst = alive[current ^ 1];
+	const uint8_t aliveState = static_cast<uint8_t>(startState - 1);
+	const int offsetRows = static_cast<int>(rowOffsets.size());
+	const int lastWord = wordsPerRow - 1;
+	const int activeCount = static_cast<int>(activeRegions.size());
+	long long aliveTotal = 0;
+
+#pragma omp parallel for schedule(dynamic, 4) reduction(+ : aliveTotal)
+	for (int i = 0; i < activeCount; i++) {
+		const int region = activeRegions[i];
+		const int w = region % regionCounts.x;
+		const int startY = (region / regionCounts.x) % regionCounts.y * BRICKSIZE;
+		const int startZ = region / (regionCounts.x * regionCounts.y) * BRICKSIZE;
+		const int left = w == 0 ? lastWord : w - 1;
+		const int right = w == lastWord ? 0 : w + 1;
+		uint64_t busy = 0, anyAlive = 0;
+		bool changed = false;
+
+		for (int z = startZ; z < startZ + BRICKSIZE; z++) {
+			for (int y = startY; y < startY + BRICKSIZE; y++) {
+				// bit-sliced neighbour count of the 64 cells in the word, the rows of the neighbourhood wrap around the torus
+				uint64_t count[CountBits] = {};
+				for (int r = 0; r < offsetRows; r++) {
+					const int ny = (y + rowOffsets[r].dy + dimensions.y) % dimensions.y;
+					const int nz = (z + rowOffsets[r].dz + dimensions.z) % dimensions.z;
+					const uint64_t* neighbours = src + WordIndex(0, ny, nz);
+					const uint64_t bits = neighbours[w];
+					if (rowOffsets[r].center) AddToCount<CountBits>(count, bits);
+					if (rowOffsets[r].left) AddToCount<CountBits>(count, (bits << 1) | (neighbours[left] >> 63));
+					if (rowOffsets[r].right) AddToCount<CountBits>(count, (bits >> 1) | (neighbours[right] << 63));
+				}
+				uint64_t spawnMask = 0, survivalMask = 0;
+				for (const int value : spawnCounts) spawnMask |= CountEquals<CountBits>(count, value);
+				for (const int value : survivalCounts) survivalMask |= CountEquals<CountBits>(count, value);
+
+				const size_t word = WordIndex(w, y, z);
+				const uint64_t wasOccupied = occupied[word];
+				const uint64_t nowAlive = (~wasOccupied & spawnMask) | (src[word] & survivalMask);
+				uint64_t nextAlive = nowAlive, nextOccupied = nowAlive;
+
+				if (Decay) {
+					// only the cells that are occupied or become alive have a state to update. seeded cells count down
+					// into the alive state, so the alive plane is rebuilt from the new states
+					uint64_t visit = wasOccupied | nowAlive;
+					nextAlive = nextOccupied = 0;
+					while (visit) {
+						const int bit = static_cast<int>(_tzcnt_u64(visit));
+						visit &= visit - 1;
+						const size_t cell = word * 64 + bit;
+						const uint8_t previous = states[cell];
+						const uint8_t next = (nowAlive >> bit & 1) ? aliveState : previous - 1;
+						states[cell] = next;
+						if (next) nextOccupied |= 1ull << bit;
+						if (next == aliveState) nextAlive |= 1ull << bit;
+						changed |= next != previous;
+					}
+				} else {
+					// dead cells go straight to 0, so the planes are all there is
+					changed |= nowAlive != wasOccupied;
+				}
+
+				dst[word] = nextAlive;
+				occupied[word] = nextOccupied;
+				busy |= nextOccupied;
+				anyAlive |= nextAlive;
+				aliveTotal += static_cast<long long>(_mm_popcnt_u64(nextAlive));
+			}
+		}
+		regionBusy[region] = busy != 0;
+		regionAlive[region] = anyAlive != 0;
+		if (changed) regionChangedAt[region] = generation;
+	}
+	return aliveTotal;
+}
+
+void AutomataEngine::UpdateActiveRegions() {
+	if (spawnsEverywhere) return;
+
+	// regions with occupied cells keep decaying, the regions around alive cells can spawn
+	std::vector<int> previous;
+	previous.swap(activeRegions);
+	for (const int region : previous) regionActive[region] = 0;
+	for (const int region : previous) {
+		if (regionBusy[region]) Activate(region);
+		if (!regionAlive[region]) continue;
+		const int x = region % regionCounts.x;
+		const int y = (region / regionCounts.x) % regionCounts.y;
+		const int z = region / (regionCounts.x * regionCounts.y);
+		for (int dz = -1; dz <= 1; dz++) {
+			for (int dy = -1; dy <= 1; dy++) {
+				for (int dx = -1; dx <= 1; dx++) {
+					const int nx = (x + dx + regionCounts.x) % regionCounts.x;
+					const int ny = (y + dy + regionCounts.y) % regionCounts.y;
+					const int nz = (z + dz + regionCounts.z) % regionCounts.z;
+					Activate(RegionIndex(nx, ny, nz));
+				}
+			}
+		}
+	}
+
+	// a region that goes to sleep still has an older generation in the other alive plane, which would be read again
+	// once it wakes up. it has no alive cells now, so both planes are cleared
+	for (const int region : previous) {
+		if (regionActive[region]) continue;
+		const int w = region % regionCounts.x;
+		const int startY = (region / regionCounts.x) % regionCounts.y * BRICKSIZE;
+		const int startZ = region / (regionCounts.x * regionCounts.y) * BRICKSIZE;
+		for (int z = startZ; z < startZ + BRICKSIZE; z++) {
+			for (int y = startY; y < startY + BRICKSIZE; y++) {
+				const size_t word = WordIndex(w, y, z);
+				alive[0][word] = alive[1][word] = 0;
+			}
+		}
+	}
+}
+
+void AutomataEngine::Write(BrickStore& store, uint& storeGeneration) const {
+	const int3 gridDimensions = int3(dimensions.x / BRICKSIZE, dimensions.y / BRICKSIZE, dimensions.z / BRICKSIZE);
+	if (store.brickCount != VoxelWorld::GetGridSize(gridDimensions)) return;
+
+	// one region is a row of whole bricks, they are rebuilt from the states instead of written voxel by voxel
+	constexpr int bricksPerWord = 64 / BRICKSIZE;
+	const int regionCount = static_cast<int>(regionChangedAt.size());
+#pragma omp parallel for schedule(dynamic, 16)
+	for (int region = 0; region < regionCount; region++) {
+		if (regionChangedAt[region] <= storeGeneration) continue;
+		const int w = region % regionCounts.x;
+		const int by = (region / regionCounts.x) % regionCounts.y;
+		const int bz = region / (regionCounts.x * regionCounts.y);
+
+		for (int i = 0; i < bricksPerWord; i++) {
+			const int bx = w * bricksPerWord + i;
+			const int index = VoxelWorld::GetBrickIndex(bx, by, bz, gridDimensions);
+			Brick* b = store.bricks[index].load(std::memory_order_relaxed);
+
+			uint voxels[BRICKSIZE3];
+			bool empty = true;
+			for (int z = 0; z < BRICKSIZE; z++) {
+				for (int y = 0; y < BRICKSIZE; y++) {
+					const size_t word = WordIndex(w, by * BRICKSIZE + y, bz * BRICKSIZE + z);
+					const uint64_t bits = occupied[word] >> (i * BRICKSIZE);
+					const uint8_t* row = states + word * 64 + i * BRICKSIZE;
+					uint* out = voxels + y * BRICKSIZE + z * BRICKSIZE2;
+					// after two state steps every occupied cell is alive, in state 1
+					if (statesValid) for (int x = 0; x < BRICKSIZE; x++) out[x] = colors[row[x]];
+					else for (int x = 0; x < BRICKSIZE; x++) out[x] = (bits >> x & 1) ? colors[1] : 0;
+					empty &= (bits & ((1ull << BRICKSIZE) - 1)) == 0;
+				}
+			}
+			if (empty && (!b || b->voxelCount == 0)) continue;
+			if (!b) {
+				b = new Brick(int3(bx, by, bz));
+				store.bricks[index] = b;
+			}
+			b->Assign(voxels);
+			store.MarkChanged(index);
+		}
+	}
+	storeGeneration = generation;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+namespace Tmpl8 {
+	class VoxelWorld;
+	struct BrickStore;
+}
+
+// a 3D cellular automaton on a torus. alive cells are kept in bit planes, 64 cells per word along x, so the neighbours
+// of 64 cells are counted at once with bit-sliced adders. the decay states live in a byte per cell and are only
+// touched for cells that are occupied or become alive. the volume is split in regions of one word by a brick in y and
+// z, and only regions with occupied cells or next to alive cells are stepped, so dead space costs nothing.
+// the step is instantiated per kind of rule set: the counters are as wide as the neighbourhood needs, and rules with
+// two states skip the decay states and only work on the bit planes
+class AutomataEngine {
+public:
+	static constexpr int MaxNeighbours = 26;
+
+	// the width is rounded up to a multiple of 64, the height and depth to a multiple of BRICKSIZE
+	AutomataEngine(const int3& dimensions);
+	~AutomataEngine();
+	AutomataEngine(const AutomataEngine&) = delete;
+	AutomataEngine& operator=(const AutomataEngine&) = delete;
+
+	// the offsets of a NeighbourHood, Moore is the 18 neighbour set of the original CA
+	static std::vector<int3> GetKernel(const int neighbourhood);
+	// the offsets whose flag is set, flags are indexed (x + 1) + (y + 1) * 3 + (z + 1) * 9
+	static std::vector<int3> MakeKernel(const bool* cells);
+
+	// survival and spawn are indexed by the number of alive neighbours. cells are alive in state startState - 1,
+	// and count down to 0 after they die. the kernel holds the neighbour offsets, each at most one cell away
+	void SetRules(const bool* survival, const bool* spawn, const int startState, const std::vector<int3>& kernel);
+	void Clear();
+	// seeds a cube around center, seeded cells start in startState and become alive the generation after. the cells
+	// are drawn from seed instead of the global random state, so the worker thread can seed
+	void Randomize(const int3& center, const int radius, const float probability, const uint seed);
+	void Step();
+	// brings bricks that show storeGeneration up to date with the current generation, only the regions that changed
+	// in between are written. the store has to be as large as the automaton, a new store starts at generation 0
+	void Write(BrickStore& store, uint& storeGeneration) const;
+
+	int3 GetDimensions() const { return dimensions; }
+	uint8_t GetState(const int x, const int y, const int z) const;
+	long long GetAliveCount() const { return aliveCount; }
+	int GetActiveRegionCount() const { return static_cast<int>(activeRegions.size()); }
+	int GetRegionCount() const { return static_cast<int>(regionActive.size()); }
+	uint GetGeneration() const { return generation; }
+	float GetLastStepTime() const { return lastStepTime; }
+
+private:
+	// the neighbours in one row of the neighbourhood, relative to the row of the cell
+	struct RowOffset {
+		int dy, dz;
+		bool left, center, right;
+	};
+
+	// CountBits bit planes hold the neighbour counts, without Decay cells are only dead or alive
+	template <int CountBits, bool Decay>
+	long long StepRegions();
+	// two state steps only keep the bit planes up to date, this brings the states back in line
+	void SyncStates();
+	// the alive cells follow from the states, needed when the alive state moves
+	void RebuildAlive();
+
+	size_t CellIndex(const int x, const int y, const int z) const { return x + (static_cast<size_t>(y) + static_cast<size_t>(z) * dimensions.y) * dimensions.x; }
+	size_t WordIndex(const int w, const int y, const int z) const { return (static_cast<size_t>(y) + static_cast<size_t>(z) * dimensions.y) * wordsPerRow + w; }
+	int RegionIndex(const int x, const int y, const int z) const { return x + (y + z * regionCounts.y) * regionCounts.x; }
+	void Activate(const int region);
+	void ActivateAll();
+	void MarkAllChanged();
+	// builds the regions to step in the next generation from the ones stepped in this one
+	void UpdateActiveRegions();
+
+	int3 dimensions;
+	int wordsPerRow;
+	size_t wordCount;
+
+	uint64_t* alive[2];		// state == startState - 1, double buffered because neighbours read it
+	uint64_t* occupied;		// state != 0
+	uint8_t* states;
+	bool statesValid = true;	// false after two state steps
+	int highestState = 0;		// no cell is above it, two state steps need it to be 1 at most
+	int current = 0;
+
+	std::vector<RowOffset> rowOffsets;
+	std::vector<int> survivalCounts;
+	std::vector<int> spawnCounts;
+	int countBits = 5;
+	int startState = 6;
+	bool spawnsEverywhere = false;
+
+	int3 regionCounts;						// 64 x BRICKSIZE x BRICKSIZE cells each
+	std::vector<int> activeRegions;
+	std::vector<uint8_t> regionActive;		// whether a region is in activeRegions
+	std::vector<uint8_t> regionBusy;		// has occupied cells after the last step
+	std::vector<uint8_t> regionAlive;		// has alive cells after the last step
+	std::vector<uint> regionChangedAt;		// the last generation any state in the region changed
+
+	uint generation = 0;
+	uint colors[256] = {};
+
+	long long aliveCount = 0;
+	float lastStepTime = 0.0f;
+};
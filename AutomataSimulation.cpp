@@ -0,0 +1,204 @@
+#include "precomp.h"
+
+AutomataSimulation::AutomataSimulation(const int3& dimensions) : engine(dimensions) {
+	// a new world starts out with empty bricks, which the worker fills with the first generation it writes
+	stats.regionCount = engine.GetRegionCount();
+	worker = std::thread(&AutomataSimulation::WorkerLoop, this);
+}
+
+AutomataSimulation::~AutomataSimulation() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+	condition.notify_all();
+	if (worker.joinable()) worker.join();
+}
+
+void AutomataSimulation::SetRules(const bool* _survival, const bool* _spawn, const int _startState, const std::vector<int3>& _kernel) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		// called every frame, the worker only has to rebuild the rules when they actually changed
+		const bool sameKernel = std::equal(kernel.begin(), kernel.end(), _kernel.begin(), _kernel.end(),
+			[](const int3& a, const int3& b) { return a == b; });
+		if (memcmp(survival, _survival, sizeof(survival)) == 0 && memcmp(spawn, _spawn, sizeof(spawn)) == 0 &&
+			startState == _startState && sameKernel) return;
+		memcpy(survival, _survival, sizeof(survival));
+		memcpy(spawn, _spawn, sizeof(spawn));
+		startState = _startState;
+		kernel = _kernel;
+		rulesChanged = true;
+	}
+	condition.notify_one();
+}
+
+void AutomataSimulation::SetRate(const float generationsPerSecond) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (rate == generationsPerSecond) return;
+		rate = generationsPerSecond;
+		if (rate <= 0.0f) stats.rate = 0.0f;
+	}
+	condition.notify_one();
+}
+
+void AutomataSimulation::Randomize(const int3& center, const int radius, const float probability) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		seeds.push_back(Seed{ center, radius, probability, RandomUInt() });
+	}
+	condition.notify_one();
+}
+
+void AutomataSimulation::Clear() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		clear = true;
+		seeds.clear();
+	}
+	condition.notify_one();
+}
+
+void AutomataSimulation::StepOnce() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stepsRequested++;
+	}
+	condition.notify_one();
+}
+
+bool AutomataSimulation::Present(VoxelWorld* world) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (ready.empty()) return false;
+	Frame frame = ready.back();
+	ready.pop_back();
+	// the worker writes into the skipped ones next, only the regions that changed since they were written
+	for (Frame& skipped : ready) spare.push_back(skipped);
+	ready.clear();
+
+	if (!world->SwapStore(frame.store)) {
+		spare.push_back(frame);
+		return false;
+	}
+	// frame.store now holds the bricks the world showed until now
+	spare.push_back(Frame{ frame.store, presentedGeneration });
+	presentedGeneration = frame.generation;
+	stats.queued = 0;
+	return true;
+}
+
+AutomataSimulation::Stats AutomataSimulation::GetStats() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return stats;
+}
+
+AutomataSimulation::Frame AutomataSimulation::TakeFreeFrame() {
+	// at most MaxQueued frames are queued, one is being written and one is shown, so a few stores are made and reused
+	if (spare.empty()) {
+		const int3 dimensions = engine.GetDimensions();
+		const int3 gridDimensions = int3(dimensions.x / BRICKSIZE, dimensions.y / BRICKSIZE, dimensions.z / BRICKSIZE);
+		return Frame{ std::make_shared<BrickStore>(VoxelWorld::GetGridSize(gridDimensions)), 0 };
+	}
+	Frame frame = spare.back();
+	spare.pop_back();
+	return frame;
+}
+
+void AutomataSimulation::WorkerLoop() {
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point nextStep = Clock::now();
+	Clock::time_point rateStart = Clock::now();
+	int rateCount = 0;
+	bool written = false;
+	uint writtenGeneration = 0;
+
+	while (true) {
+		bool newRules = false, doClear = false, doStep = false;
+		bool ruleSurvival[AutomataEngine::MaxNeighbours], ruleSpawn[AutomataEngine::MaxNeighbours];
+		int ruleStartState = 0;
+		std::vector<int3> ruleKernel;
+		std::vector<Seed> newSeeds;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (true) {
+				if (!running) return;
+				if (rulesChanged || clear || !seeds.empty() || stepsRequested > 0 || !written) break;
+				if (rate <= 0.0f) {
+					condition.wait(lock);
+					continue;
+				}
+				if (Clock::now() >= nextStep) break;
+				condition.wait_until(lock, nextStep);
+			}
+
+			newRules = rulesChanged;
+			memcpy(ruleSurvival, survival, sizeof(survival));
+			memcpy(ruleSpawn, spawn, sizeof(spawn));
+			ruleStartState = startState;
+			ruleKernel = kernel;
+			rulesChanged = false;
+			doClear = clear;
+			clear = false;
+			newSeeds.swap(seeds);
+
+			// a clear or a new seed wins over generations the renderer hasn't picked up yet
+			if (doClear || !newSeeds.empty()) {
+				for (Frame& stale : ready) spare.push_back(stale);
+				ready.clear();
+				stepsRequested = 0;
+			}
+			if (stepsRequested > 0) {
+				stepsRequested--;
+				doStep = true;
+			} else if (rate > 0.0f && Clock::now() >= nextStep && !doClear && newSeeds.empty()) {
+				doStep = true;
+				// don't try to catch up after falling behind, that would only stall the worker in a burst
+				const auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(1.0f / rate));
+				nextStep += interval;
+				if (nextStep < Clock::now()) nextStep = Clock::now() + interval;
+			}
+		}
+
+		if (newRules) engine.SetRules(ruleSurvival, ruleSpawn, ruleStartState, ruleKernel);
+		if (doClear) engine.Clear();
+		for (const Seed& seed : newSeeds) engine.Randomize(seed.center, seed.radius, seed.probability, seed.seed);
+		if (doStep) engine.Step();
+
+		// rules that keep the colours don't change the bricks
+		if (written && engine.GetGeneration() == writtenGeneration) continue;
+
+		Frame frame;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			frame = TakeFreeFrame();
+		}
+		Timer timer;
+		engine.Write(*frame.store, frame.generation);
+		const float writeTime = timer.elapsed();
+		written = true;
+		writtenGeneration = engine.GetGeneration();
+
+		if (doStep) rateCount++;
+		const float rateTime = std::chrono::duration<float>(Clock::now() - rateStart).count();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		// the renderer is behind, the oldest generation is dropped so the simulation keeps its pace
+		if (static_cast<int>(ready.size()) >= MaxQueued) {
+			spare.push_back(ready.front());
+			ready.pop_front();
+		}
+		ready.push_back(frame);
+
+		stats.generation = engine.GetGeneration();
+		stats.aliveCount = engine.GetAliveCount();
+		stats.activeRegions = engine.GetActiveRegionCount();
+		stats.stepTime = engine.GetLastStepTime();
+		stats.writeTime = writeTime;
+		stats.queued = static_cast<int>(ready.size());
+		if (rateTime >= 1.0f) {
+			stats.rate = static_cast<float>(rateCount) / rateTime;
+			rateCount = 0;
+			rateStart = Clock::now();
+		}
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+namespace Tmpl8 {
+	class VoxelWorld;
+	struct BrickStore;
+}
+
+// runs an AutomataEngine on its own thread. every generation is written into a brick store and queued, and the
+// renderer swaps the newest one into its world between frames. a slow generation never holds up a frame, and when
+// the renderer is slower the generations it doesn't get to are skipped instead of piling up
+class AutomataSimulation {
+public:
+	static constexpr int MaxQueued = 3;
+
+	struct Stats {
+		uint generation = 0;
+		long long aliveCount = 0;
+		int activeRegions = 0;
+		int regionCount = 0;
+		float stepTime = 0.0f;		// seconds for the last generation
+		float writeTime = 0.0f;		// seconds to write it to bricks
+		float rate = 0.0f;			// generations per second, measured
+		int queued = 0;
+	};
+
+	AutomataSimulation(const int3& dimensions);
+	~AutomataSimulation();
+	AutomataSimulation(const AutomataSimulation&) = delete;
+	AutomataSimulation& operator=(const AutomataSimulation&) = delete;
+
+	// the commands below are picked up by the worker before its next generation
+	void SetRules(const bool* survival, const bool* spawn, const int startState, const std::vector<int3>& kernel);
+	// generations per second, 0 pauses
+	void SetRate(const float generationsPerSecond);
+	void Randomize(const int3& center, const int radius, const float probability);
+	void Clear();
+	// one more generation, also while paused
+	void StepOnce();
+
+	// swaps the newest finished generation into the world and recycles the older ones. call between frames, returns
+	// false if there was nothing new
+	bool Present(VoxelWorld* world);
+
+	int3 GetDimensions() const { return engine.GetDimensions(); }
+	Stats GetStats();
+
+private:
+	struct Frame {
+		std::shared_ptr<BrickStore> store;
+		uint generation = 0;	// the generation the bricks show
+	};
+	struct Seed {
+		int3 center;
+		int radius;
+		float probability;
+		uint seed;	// drawn by the caller, the global random state is not the worker's to use
+	};
+
+	void WorkerLoop();
+	Frame TakeFreeFrame();
+
+	AutomataEngine engine;	// only used by the worker after construction
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::thread worker;
+	bool running = true;
+
+	// commands
+	bool rulesChanged = false;
+	bool survival[AutomataEngine::MaxNeighbours] = {};
+	bool spawn[AutomataEngine::MaxNeighbours] = {};
+	int startState = 0;
+	std::vector<int3> kernel;
+	std::vector<Seed> seeds;
+	bool clear = false;
+	int stepsRequested = 0;
+	float rate = 0.0f;
+
+	std::deque<Frame> ready;
+	std::vector<Frame> spare;
+	uint presentedGeneration = 0;	// of the bricks the world shows
+	Stats stats;
+};
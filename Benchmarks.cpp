@@ -0,0 +1,326 @@
+#include "precomp.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+void Benchmarks::MaterialShading() {
+	//material shading test (analytic vs LUT)
+	Material material = Material(0, 0.5f, 0.0f, 0.5f, 1.5f);
+	material.BakeLUT();
+	const float3 normal = float3(0, 1, 0);
+
+	const int numTests = 100'000'000;
+
+	float result = 0;
+	Timer t;
+	for (int i = 0; i < numTests; i++) {
+		const float cosTheta = (i & 1023) / 1023.0f;
+		result += material.ComputeReflectivity(float3(sqrtf(1.0f - cosTheta * cosTheta), cosTheta, 0), normal);
+	}
+	printf("100M Reflectivity (analytic) took: %f seconds\n", t.elapsed());
+	printf("Result: %f\n", result);
+
+	result = 0;
+	t.reset();
+	for (int i = 0; i < numTests; i++) {
+		result += material.GetReflectivity((i & 1023) / 1023.0f);
+	}
+	printf("100M Reflectivity (LUT) took: %f seconds\n", t.elapsed());
+	printf("Result: %f\n", result);
+
+	__m256 sum = _mm256_setzero_ps();
+	t.reset();
+	for (int i = 0; i < numTests; i += 8) {
+		const float c = (i & 1023) / 1023.0f;
+		const __m256 cosTheta = _mm256_set_ps(c, c, c, c, c, c, c, c);
+		sum = _mm256_add_ps(sum, material.GetReflectivity8(cosTheta));
+	}
+	ALIGN(32) float sums[8];
+	_mm256_store_ps(sums, sum);
+	printf("100M Reflectivity (LUT, With SIMD) took: %f seconds\n", t.elapsed());
+	printf("Result: %f\n", sums[0]);
+
+	float3 color = float3(0);
+	t.reset();
+	for (int i = 0; i < numTests; i++) {
+		const float distance = (i & 1023) / 256.0f;
+		color += expf(-material.absorptionCoefficient * distance);
+	}
+	printf("100M Transmission (expf) took: %f seconds\n", t.elapsed());
+	printf("Result: %f, %f, %f\n", color.x, color.y, color.z);
+
+	color = float3(0);
+	t.reset();
+	for (int i = 0; i < numTests; i++) {
+		color += material.GetTransmittedColor(float3(1), (i & 1023) / 256.0f);
+	}
+	printf("100M Transmission (LUT) took: %f seconds\n", t.elapsed());
+	printf("Result: %f, %f, %f\n", color.x, color.y, color.z);
+}
+
+void Benchmarks::BrickAllocation() {
+	//concurrent brick allocation stress test, every thread fills the whole world so all bricks are contended
+	const int iterations = 10;
+	Timer t;
+	for (int iteration = 0; iteration < iterations; iteration++) {
+		VoxelWorld world;
+		const int threads = static_cast<int>(std::thread::hardware_concurrency());
+#pragma omp parallel for
+		for (int thread = 0; thread < threads; thread++) {
+			for (int z = 0; z < WORLDSIZE; z++) {
+				for (int y = 0; y < WORLDSIZE; y++) {
+					// interleave the rows so threads write different voxels of the same bricks
+					for (int x = thread; x < WORLDSIZE; x += threads) {
+						world.Set(x, y, z, 0xffffff);
+					}
+				}
+			}
+		}
+
+		size_t totalVoxels = 0;
+		int brickCount = 0;
+		for (int i = 0; i < GRIDDIMENSIONS * GRIDDIMENSIONS * GRIDDIMENSIONS; i++) {
+			if (Brick* b = world.bricks[i].load()) {
+				totalVoxels += b->voxelCount;
+				brickCount++;
+			}
+		}
+		const bool passed = totalVoxels == WORLDSIZE * WORLDSIZE * WORLDSIZE && brickCount == GRIDDIMENSIONS * GRIDDIMENSIONS * GRIDDIMENSIONS;
+		printf("Stress test %d: %zu voxels in %d bricks, %s\n", iteration, totalVoxels, brickCount, passed ? "passed" : "FAILED");
+	}
+	printf("Brick allocation stress test took: %f seconds\n", t.elapsed());
+}
+
+void Benchmarks::WorldGeneration() {
+	//world generation test, per world size and thread count
+	const int maxThreads = static_cast<int>(std::thread::hardware_concurrency());
+	for (int gridSize = 4; gridSize <= 32; gridSize *= 2) {
+		for (int threads = 1; threads <= maxThreads; threads *= 2) {
+#ifdef _OPENMP
+			omp_set_num_threads(threads);
+#endif
+			VoxelWorld world(make_int3(gridSize));
+			Timer t;
+			world.GenerateGrid();
+			const float elapsed = t.elapsed();
+
+			size_t totalVoxels = 0;
+			for (int i = 0; i < gridSize * gridSize * gridSize; i++) {
+				if (Brick* b = world.bricks[i].load()) totalVoxels += b->voxelCount;
+			}
+			printf("GenerateGrid %d^3 with %d threads took: %f seconds (%zu voxels)\n", gridSize * BRICKSIZE, threads, elapsed, totalVoxels);
+		}
+	}
+#ifdef _OPENMP
+	omp_set_num_threads(maxThreads);
+#endif
+}
+
+void Benchmarks::CellularAutomata() {
+	//cellular automata test, generations per second per size and rule set, seeded with a cube of half the size
+	const bool survival[AutomataEngine::MaxNeighbours] = { 0, 0, 0, 0, 1, 1, 1 };
+	const bool spawn[AutomataEngine::MaxNeighbours] = { 0, 0, 0, 1 };
+	const int generations = 50;
+	for (int size = 64; size <= 512; size *= 2) {
+		for (int neighbourhood = NeighbourHood::Moore; neighbourhood <= NeighbourHood::VonNeumann; neighbourhood++) {
+			for (int startState = 2; startState <= 6; startState += 4) {
+				AutomataEngine engine(make_int3(size));
+				engine.SetRules(survival, spawn, startState, AutomataEngine::GetKernel(neighbourhood));
+				engine.Randomize(int3(size / 2), size / 4, 0.5f, 0);
+				Timer t;
+				for (int i = 0; i < generations; i++) engine.Step();
+				const float elapsed = t.elapsed();
+				printf("CA %d^3 %s with %d states: %.1f generations/s (%lld alive, %d / %d regions active)\n", size,
+					neighbourhood == NeighbourHood::Moore ? "Moore" : "Von Neumann", startState, generations / elapsed,
+					engine.GetAliveCount(), engine.GetActiveRegionCount(), engine.GetRegionCount());
+			}
+		}
+	}
+}
+
+void Benchmarks::RayQueries(Scene& scene, const Camera& camera) {
+	//batched ray query test, a screen of camera rays traced one by one and as a batch
+	RayBatch batch;
+	for (int y = 0; y < SCRHEIGHT; y++) {
+		for (int x = 0; x < SCRWIDTH; x++) {
+			const Ray r = camera.GetPrimaryRay(static_cast<float>(x), static_cast<float>(y));
+			batch.Add(r.O, r.D);
+		}
+	}
+	Timer t;
+	for (int i = 0; i < batch.Size(); i++) {
+		Ray r(batch.GetOrigin(i), batch.GetDirection(i));
+		scene.FindNearest(r);
+	}
+	printf("FindNearest per ray took: %f seconds\n", t.elapsed());
+	t.reset();
+	scene.TraceBatch(batch, RayQueryClosest | RayQueryAttributes);
+	printf("TraceBatch took: %f seconds\n", t.elapsed());
+	t.reset();
+	scene.TraceBatch(batch, RayQueryAnyHit);
+	printf("TraceBatch any hit took: %f seconds\n", t.elapsed());
+
+	// both paths trace the same rays, so every ray has to come out the same
+	scene.TraceBatch(batch, RayQueryClosest);
+	int mismatches = 0;
+	for (int i = 0; i < batch.Size(); i++) {
+		Ray r(batch.GetOrigin(i), batch.GetDirection(i));
+		scene.FindNearest(r);
+		const bool hit = r.voxel != 0;
+		if (hit == (batch.hit[i] != 0) && (!hit || (r.t == batch.t[i] && r.voxel == batch.voxel[i] && r.worldIndex == batch.worldIndex[i]))) continue;
+		if (mismatches++ < 10) {
+			printf("Ray %d: FindNearest t %f voxel %08x world %d, TraceBatch hit %d t %f voxel %08x world %d\n", i, r.t, r.voxel, hit ? r.worldIndex : -1,
+				batch.hit[i], batch.t[i], batch.voxel[i], batch.worldIndex[i]);
+		}
+	}
+	printf("TraceBatch closest hits: %d of %d rays differ from FindNearest\n", mismatches, batch.Size());
+
+	scene.TraceBatch(batch, RayQueryAnyHit);
+	mismatches = 0;
+	for (int i = 0; i < batch.Size(); i++) {
+		Ray r(batch.GetOrigin(i), batch.GetDirection(i), batch.tMax[i]);
+		if (scene.IsOccluded(r) == (batch.hit[i] != 0)) continue;
+		if (mismatches++ < 10) printf("Ray %d: IsOccluded %d, TraceBatch any hit %d\n", i, !batch.hit[i], batch.hit[i]);
+	}
+	printf("TraceBatch any hits: %d of %d rays differ from IsOccluded\n", mismatches, batch.Size());
+}
+
+void Benchmarks::Collisions(Scene& scene) {
+	//collision query test, spheres dropped through the scene tested with the ray grid the ball used and with the voxel queries
+	const int bodies = 1000;
+	const float radius = 0.05f;
+	std::vector<float3> centers(bodies);
+	for (float3& center : centers) center = float3(RandomFloat(), RandomFloat(), RandomFloat());
+	Timer t;
+	int touching = 0;
+	for (const float3& center : centers) {
+		bool touches = false;
+		for (int i = 0; i < 100 && !touches; i++) {
+			for (int j = 0; j < 100 && !touches; j++) {
+				const float theta = i * 2.0f * PI / 100.0f, phi = j * PI / 99.0f - PI / 2.0f;
+				Ray r(center, float3(cos(phi) * sin(theta), sin(phi), cos(phi) * cos(theta)));
+				scene.FindNearest(r);
+				touches = r.voxel != 0 && r.t < radius;
+			}
+		}
+		touching += touches;
+	}
+	printf("Ray grid for %d spheres took: %f seconds (%d touching)\n", bodies, t.elapsed(), touching);
+	t.reset();
+	touching = 0;
+	std::vector<VoxelContact> contacts;
+	for (const float3& center : centers) {
+		contacts.clear();
+		touching += VoxelCollision::OverlapSphere(scene, center, radius, &contacts);
+	}
+	printf("OverlapSphere for %d spheres took: %f seconds (%d touching)\n", bodies, t.elapsed(), touching);
+	t.reset();
+	int hits = 0;
+	for (const float3& center : centers) hits += VoxelCollision::SweepSphere(scene, center, radius, float3(0, -0.1f, 0)).hit;
+	printf("SweepSphere for %d spheres took: %f seconds (%d hits)\n", bodies, t.elapsed(), hits);
+}
+
+void Benchmarks::Explosions() {
+	//explosion test, dozens of spark spheres carved into a solid slab per voxel and as CSG edits
+	VoxelWorld slab(int3(16));
+	slab.FillBox(make_int3(0), make_int3(128, 64, 128), 0x00ff00);
+	std::vector<int3> centers;
+	for (int i = 0; i < 32; i++) centers.push_back(make_int3(RandomUInt() % 128, 64, RandomUInt() % 128));
+	Timer t;
+	for (const int3& center : centers) slab.FillSphere(center, 15.0f, 0xffffff, 0, 0.15f);
+	printf("FillSphere of %zu explosions took: %f seconds\n", centers.size(), t.elapsed());
+	t.reset();
+	for (const int3& center : centers) {
+		slab.CsgSphere(CsgOp::Subtract, make_float3(center), 15.0f, 0);
+		slab.CsgSphere(CsgOp::Union, make_float3(center), 15.0f, 0xffffff, 0, 0.15f, 1234);
+	}
+	printf("CsgSphere of %zu explosions took: %f seconds\n", centers.size(), t.elapsed());
+
+	// with every voxel edited both paths have to carve the same spheres, a union voxel for voxel and a subtract in
+	// occupancy. FillSphere creates every brick in its bounds, so a missing brick counts as empty voxels
+	const auto countDifferences = [](const VoxelWorld& a, const VoxelWorld& b, const bool occupancyOnly) {
+		int differences = 0;
+		for (int i = 0; i < VoxelWorld::GetGridSize(a.gridDimensions); i++) {
+			const Brick* brickA = a.bricks[i].load();
+			const Brick* brickB = b.bricks[i].load();
+			if (!brickA && !brickB) continue;
+			for (int z = 0; z < BRICKSIZE; z++) {
+				for (int y = 0; y < BRICKSIZE; y++) {
+					for (int x = 0; x < BRICKSIZE; x++) {
+						const uint voxelA = brickA ? brickA->Get(x, y, z) : 0;
+						const uint voxelB = brickB ? brickB->Get(x, y, z) : 0;
+						if (occupancyOnly ? ((voxelA & 0x00FFFFFF) != 0) != ((voxelB & 0x00FFFFFF) != 0) : voxelA != voxelB) differences++;
+					}
+				}
+			}
+		}
+		return differences;
+	};
+	VoxelWorld reference(int3(16)), csg(int3(16));
+	reference.FillBox(make_int3(0), make_int3(128, 64, 128), 0x00ff00);
+	csg.FillBox(make_int3(0), make_int3(128, 64, 128), 0x00ff00);
+	for (const int3& center : centers) {
+		reference.FillSphere(center, 15.0f, 0xffffff);
+		csg.CsgSphere(CsgOp::Union, make_float3(center), 15.0f, 0xffffff, 0, 1.0f);
+	}
+	printf("CsgSphere union: %d voxels differ from FillSphere\n", countDifferences(reference, csg, false));
+	for (const int3& center : centers) {
+		reference.FillSphere(center, 15.0f, 0);
+		csg.CsgSphere(CsgOp::Subtract, make_float3(center), 15.0f, 0);
+	}
+	printf("CsgSphere subtract: %d voxels differ in occupancy from FillSphere\n", countDifferences(reference, csg, true));
+}
+
+void Benchmarks::PrimaryHits(Scene& scene, const Camera& camera) {
+	//primary hit cache test, a still frame of primary rays traced and restored from the cache
+	PrimaryHitCache cache;
+	scene.FlushChanges();
+	cache.BeginFrame(camera, scene);
+	for (int i = 0; i < SCRWIDTH * SCRHEIGHT; i++) {
+		Ray r = camera.GetNoEffectPrimaryRay((float)(i % SCRWIDTH), (float)(i / SCRWIDTH));
+		cache.FindNearest(scene, r, i);
+	}
+	Timer t;
+	for (int i = 0; i < SCRWIDTH * SCRHEIGHT; i++) {
+		Ray r = camera.GetNoEffectPrimaryRay((float)(i % SCRWIDTH), (float)(i / SCRWIDTH));
+		scene.FindNearest(r);
+	}
+	printf("Tracing %d primary rays took: %f seconds\n", SCRWIDTH * SCRHEIGHT, t.elapsed());
+	scene.FlushChanges();
+	cache.BeginFrame(camera, scene);
+	t.reset();
+	for (int i = 0; i < SCRWIDTH * SCRHEIGHT; i++) {
+		Ray r = camera.GetNoEffectPrimaryRay((float)(i % SCRWIDTH), (float)(i / SCRWIDTH));
+		cache.FindNearest(scene, r, i);
+	}
+	printf("Restoring %d primary hits took: %f seconds (hit rate %.1f%%)\n", SCRWIDTH * SCRHEIGHT, t.elapsed(), cache.GetHitRate() * 100.0f);
+
+	// nothing changed since the hits were stored, so every restored ray has to be what tracing it gives
+	int mismatches = 0;
+	for (int i = 0; i < SCRWIDTH * SCRHEIGHT; i++) {
+		Ray cached = camera.GetNoEffectPrimaryRay((float)(i % SCRWIDTH), (float)(i / SCRWIDTH));
+		cache.FindNearest(scene, cached, i);
+		Ray traced = camera.GetNoEffectPrimaryRay((float)(i % SCRWIDTH), (float)(i / SCRWIDTH));
+		scene.FindNearest(traced);
+		const bool hit = traced.voxel != 0;
+		if (hit == (cached.voxel != 0) && (!hit || (cached.t == traced.t && cached.voxel == traced.voxel && cached.worldIndex == traced.worldIndex
+			&& cached.entryAxis == traced.entryAxis && cached.entrySign == traced.entrySign))) continue;
+		if (mismatches++ < 10) {
+			printf("Pixel %d: FindNearest t %f voxel %08x world %d entry %d %d, cache t %f voxel %08x world %d entry %d %d\n", i,
+				traced.t, traced.voxel, traced.worldIndex, traced.entryAxis, traced.entrySign,
+				cached.t, cached.voxel, cached.worldIndex, cached.entryAxis, cached.entrySign);
+		}
+	}
+	printf("Restored primary hits: %d of %d rays differ from FindNearest\n", mismatches, SCRWIDTH * SCRHEIGHT);
+}
+
+void Benchmarks::Run(Scene& scene, const Camera& camera) {
+	MaterialShading();
+	BrickAllocation();
+	WorldGeneration();
+	CellularAutomata();
+	RayQueries(scene, camera);
+	Collisions(scene);
+	Explosions();
+	PrimaryHits(scene, camera);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+namespace Tmpl8 {
+	class Scene;
+	class Camera;
+
+	// timings of the fast paths against the code they replaced, printed to the console. not called in a normal run,
+	// enable the call at the end of Renderer::Init to run them on the scene that is loaded there
+	namespace Benchmarks {
+		// analytic reflectivity and transmission against the material LUTs
+		void MaterialShading();
+		// every thread writing every brick of a fresh world, checks that no voxel or brick is lost
+		void BrickAllocation();
+		// GenerateGrid per world size and thread count
+		void WorldGeneration();
+		// AutomataEngine generations per second per size and rule set
+		void CellularAutomata();
+		// a screen of camera rays one by one and with TraceBatch, and whether both give the same hits
+		void RayQueries(Scene& scene, const Camera& camera);
+		// a grid of rays per sphere against the VoxelCollision queries
+		void Collisions(Scene& scene);
+		// explosions carved per voxel with FillSphere and as CSG edits, and whether both carve the same voxels
+		void Explosions();
+		// a still frame of primary rays traced and restored from a PrimaryHitCache, and whether both give the same hits
+		void PrimaryHits(Scene& scene, const Camera& camera);
+
+		void Run(Scene& scene, const Camera& camera);
+	}
+}
@@ -0,0 +1,280 @@
+#include "precomp.h"
+
+namespace {
+	constexpr uint PageFileMagic = 0x47505856; // "VXPG"
+	constexpr uint PageFileVersion = 1;
+	constexpr uint64_t PageAlignment = 4096;
+	constexpr uint64_t BrickBytes = BRICKSIZE3 * sizeof(uint);
+}
+
+bool BrickPager::Write(VoxelWorld* world, const char* path, const bool generateMissing) {
+	FILE* f = fopen(path, "wb");
+	if (!f) return false;
+
+	const int3 grid = world->gridDimensions;
+	const int brickCount = VoxelWorld::GetGridSize(grid);
+	const int slabSize = grid.x * grid.y;
+
+	PageFileHeader header = {};
+	header.magic = PageFileMagic;
+	header.version = PageFileVersion;
+	header.gridX = grid.x, header.gridY = grid.y, header.gridZ = grid.z;
+	header.brickSize = BRICKSIZE;
+	header.payloadOffset = (sizeof(PageFileHeader) + brickCount * sizeof(PageFileEntry) + PageAlignment - 1) & ~(PageAlignment - 1);
+
+	std::vector<PageFileEntry> entries(brickCount, PageFileEntry{ EmptySlot, 0 });
+	_fseeki64(f, header.payloadOffset, SEEK_SET);
+
+	// one slab of bricks at a time, so loaded bricks only have to be in memory until they are written
+	BrickPager* pager = world->pager;
+	const std::vector<float> xCoords = world->GetNoiseXCoordinates();
+	std::vector<uint8_t> loaded(slabSize, 0);
+	for (int z = 0; z < grid.z; z++) {
+		const int first = z * slabSize;
+		if (pager || generateMissing) {
+#pragma omp parallel for schedule(dynamic)
+			for (int i = 0; i < slabSize; i++) {
+				loaded[i] = world->bricks[first + i].load() == nullptr;
+				if (!loaded[i]) continue;
+				// the bricks of a paged world that aren't resident are in its page file, not in the noise
+				if (pager) pager->Fault(first + i);
+				else world->GenerateBrick(first + i, xCoords.data());
+			}
+		}
+		for (int i = 0; i < slabSize; i++) {
+			Brick* b = world->bricks[first + i].load();
+			if (b && !b->IsEmpty()) {
+				entries[first + i] = PageFileEntry{ header.slotCount++, static_cast<uint>(b->voxelCount) };
+				fwrite(b->grid, 1, BrickBytes, f);
+			}
+			if (!loaded[i] || !b) continue;
+			if (pager) pager->Evict(first + i);
+			else delete world->bricks[first + i].exchange(nullptr);
+		}
+	}
+
+	_fseeki64(f, 0, SEEK_SET);
+	fwrite(&header, sizeof(PageFileHeader), 1, f);
+	fwrite(entries.data(), sizeof(PageFileEntry), brickCount, f);
+	const bool ok = ferror(f) == 0;
+	fclose(f);
+	return ok;
+}
+
+BrickPager* BrickPager::Open(const char* path) {
+	BrickPager* pager = new BrickPager();
+	pager->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+	LARGE_INTEGER size;
+	if (pager->file == INVALID_HANDLE_VALUE || !GetFileSizeEx(pager->file, &size) || static_cast<uint64_t>(size.QuadPart) < sizeof(PageFileHeader)) {
+		delete pager;
+		return nullptr;
+	}
+	pager->fileSize = size.QuadPart;
+
+	// map the whole file, the OS reads pages in on first touch and can drop clean ones under pressure
+	pager->mapping = CreateFileMappingA(pager->file, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+	if (pager->mapping) pager->view = static_cast<uint8_t*>(MapViewOfFile(pager->mapping, FILE_MAP_WRITE, 0, 0, 0));
+	if (!pager->view) {
+		delete pager;
+		return nullptr;
+	}
+
+	PageFileHeader* header = reinterpret_cast<PageFileHeader*>(pager->view);
+	const uint64_t brickCount = static_cast<uint64_t>(header->gridX) * header->gridY * header->gridZ;
+	if (header->magic != PageFileMagic || header->version != PageFileVersion || header->brickSize != BRICKSIZE || brickCount == 0
+		|| header->payloadOffset < sizeof(PageFileHeader) + brickCount * sizeof(PageFileEntry)
+		|| header->payloadOffset + header->slotCount * BrickBytes > pager->fileSize) {
+		delete pager;
+		return nullptr;
+	}
+	pager->header = header;
+	pager->brickCount = static_cast<int>(brickCount);
+	pager->entries = reinterpret_cast<PageFileEntry*>(pager->view + sizeof(PageFileHeader));
+	pager->payload = reinterpret_cast<uint*>(pager->view + header->payloadOffset);
+	return pager;
+}
+
+BrickPager::~BrickPager() {
+	// the mapped bricks can't outlive the mapping, new bricks go into the file first so they aren't lost
+	if (world) {
+		AdoptNewBricks();
+		for (int i = 0; i < brickCount; i++) {
+			Brick* b = world->bricks[i].load();
+			if (b && !b->ownsGrid) Evict(i, true);
+		}
+	}
+	delete[] lastUsed;
+
+	if (view) UnmapViewOfFile(view);
+	if (mapping) CloseHandle(mapping);
+	for (const auto& oldView : oldViews) {
+		UnmapViewOfFile(oldView.second);
+		CloseHandle(oldView.first);
+	}
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+}
+
+void BrickPager::Attach(VoxelWorld* _world) {
+	world = _world;
+	lastUsed = new std::atomic<uint>[brickCount];
+	for (int i = 0; i < brickCount; i++) {
+		lastUsed[i] = 0;
+	}
+}
+
+Brick* BrickPager::PageIn(const int brickIndex, std::atomic<int>& counter) {
+	const int3 grid = world->gridDimensions;
+	const int3 gridPosition = make_int3(brickIndex % grid.x, (brickIndex / grid.x) % grid.y, brickIndex / (grid.x * grid.y));
+	const PageFileEntry& entry = entries[brickIndex];
+	Brick* mapped = new Brick(gridPosition, payload + static_cast<uint64_t>(entry.slot) * BRICKSIZE3, entry.voxelCount);
+
+	// many rays can fault on the same brick, only the first one publishes it
+	Brick* b = nullptr;
+	if (!world->bricks[brickIndex].compare_exchange_strong(b, mapped, std::memory_order_acq_rel, std::memory_order_acquire)) {
+		delete mapped;
+		return b;
+	}
+	lastUsed[brickIndex].store(frame.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	residentCount++;
+	counter++;
+	return mapped;
+}
+
+void BrickPager::PrefetchAround(const float3& localPosition) {
+	const int3 grid = world->gridDimensions;
+	const int3 center = make_int3(static_cast<int>(floorf(localPosition.x)), static_cast<int>(floorf(localPosition.y)), static_cast<int>(floorf(localPosition.z)));
+	const int3 from = max(center - prefetchRadius, make_int3(0));
+	const int3 to = min(center + prefetchRadius + 1, grid);
+	for (int z = from.z; z < to.z; z++) {
+		for (int y = from.y; y < to.y; y++) {
+			for (int x = from.x; x < to.x; x++) {
+				const int index = VoxelWorld::GetBrickIndex(x, y, z, grid);
+				if (world->bricks[index].load()) {
+					MarkUsed(index);
+					continue;
+				}
+				if (entries[index].slot == EmptySlot) continue;
+				Brick* b = PageIn(index, prefetchCount);
+				prefetchRanges.push_back(WIN32_MEMORY_RANGE_ENTRY{ b->grid, BrickBytes });
+			}
+		}
+	}
+}
+
+void BrickPager::AdoptNewBricks() {
+	std::vector<int> indices;
+	{
+		std::lock_guard<std::mutex> lock(adoptMutex);
+		indices.swap(adopted);
+	}
+	if (indices.empty()) return;
+
+	// grow by half at a time, so a stream of edits doesn't remap the file every frame
+	const uint64_t needed = header->payloadOffset + (static_cast<uint64_t>(header->slotCount) + indices.size()) * BrickBytes;
+	if (needed > fileSize && !Grow(std::max(needed, (fileSize + fileSize / 2 + PageAlignment - 1) & ~(PageAlignment - 1)))) {
+		printf("Failed to grow the page file, %zu new bricks stay in memory\n", indices.size());
+		return;
+	}
+	for (const int index : indices) {
+		// the brick may have been removed since, or its slot adopted already
+		Brick* b = world->bricks[index].load();
+		if (!b || !b->ownsGrid) continue;
+		const uint slot = header->slotCount++;
+		uint* grid = payload + static_cast<uint64_t>(slot) * BRICKSIZE3;
+		memcpy(grid, b->grid, BrickBytes);
+		Brick* mapped = new Brick(b->gridPosition, grid, b->voxelCount);
+		mapped->flushedVoxelCount = b->flushedVoxelCount;
+		entries[index] = PageFileEntry{ slot, static_cast<uint>(mapped->voxelCount) };
+		world->bricks[index].store(mapped);
+		delete b;
+		lastUsed[index].store(frame.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		residentCount++;
+	}
+}
+
+bool BrickPager::Grow(const uint64_t size) {
+	// mapping more than the file holds extends it
+	HANDLE newMapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), nullptr);
+	if (!newMapping) return false;
+	uint8_t* newView = static_cast<uint8_t*>(MapViewOfFile(newMapping, FILE_MAP_WRITE, 0, 0, 0));
+	if (!newView) {
+		CloseHandle(newMapping);
+		return false;
+	}
+
+	// views of the same file are coherent, so resident bricks can keep pointing into the old one
+	oldViews.emplace_back(mapping, view);
+	mapping = newMapping;
+	view = newView;
+	fileSize = size;
+	header = reinterpret_cast<PageFileHeader*>(view);
+	entries = reinterpret_cast<PageFileEntry*>(view + sizeof(PageFileHeader));
+	payload = reinterpret_cast<uint*>(view + header->payloadOffset);
+	return true;
+}
+
+void BrickPager::Evict(const int brickIndex, const bool removed) {
+	Brick* b = removed ? world->TakeBrick(brickIndex) : world->bricks[brickIndex].exchange(nullptr);
+	// edits went straight into the mapped payload, only the count lives in the brick
+	entries[brickIndex].voxelCount = static_cast<uint>(b->voxelCount);
+	// unlocking pages that aren't locked takes them out of the working set, edited ones get written back by the OS
+	VirtualUnlock(b->grid, BrickBytes);
+	delete b;
+	residentCount--;
+}
+
+void BrickPager::Update(const float3& cameraPosition) {
+	frame++;
+	faultsLastFrame = faultCount.exchange(0);
+	prefetchesLastFrame = prefetchCount.exchange(0);
+	evictionsLastFrame = 0;
+	AdoptNewBricks();
+
+	// page in the bricks along the path the camera is moving, so rays don't have to fault on them first
+	const float3 localCamera = world->invTransform.TransformPoint(cameraPosition) * GRIDDIMENSIONS;
+	const float3 velocity = hasLastCamera ? localCamera - lastCamera : float3(0);
+	lastCamera = localCamera;
+	hasLastCamera = true;
+
+	prefetchRanges.clear();
+	const float3 ahead = velocity * static_cast<float>(prefetchFrames);
+	const int steps = std::min(static_cast<int>(ceilf(length(ahead))), 64);
+	for (int step = 0; step <= steps; step++) {
+		PrefetchAround(localCamera + ahead * (steps ? static_cast<float>(step) / steps : 0.0f));
+	}
+	// let the OS read them in the background instead of one page fault at a time
+	if (!prefetchRanges.empty()) PrefetchVirtualMemory(GetCurrentProcess(), prefetchRanges.size(), prefetchRanges.data(), 0);
+
+	// no rays are in flight here, so bricks can be evicted safely
+	const int resident = residentCount;
+	if (resident <= brickBudget) return;
+
+	std::vector<std::pair<uint, int>> candidates;
+	for (int i = 0; i < brickCount; i++) {
+		const Brick* b = world->bricks[i].load();
+		if (b && !b->ownsGrid) candidates.emplace_back(lastUsed[i].load(std::memory_order_relaxed), i);
+	}
+	// evict a bit more than needed so we don't end up doing this every frame
+	const int evictCount = std::min(static_cast<int>(candidates.size()), resident - brickBudget * 9 / 10);
+	std::nth_element(candidates.begin(), candidates.begin() + evictCount, candidates.end());
+	for (int i = 0; i < evictCount; i++) {
+		Evict(candidates[i].second);
+		evictionsLastFrame++;
+	}
+}
+
+bool BrickPager::DrawImGui(const int index) {
+	std::string budgetLabel = "Brick Budget##pager" + std::to_string(index);
+	std::string radiusLabel = "Prefetch Radius##" + std::to_string(index);
+	std::string framesLabel = "Prefetch Frames##" + std::to_string(index);
+	ImGui::SliderInt(budgetLabel.c_str(), &brickBudget, 256, 1 << 22);
+	ImGui::SliderInt(radiusLabel.c_str(), &prefetchRadius, 0, 8);
+	ImGui::SliderInt(framesLabel.c_str(), &prefetchFrames, 0, 60);
+
+	ImGui::Text("File Size: %.1f MB", static_cast<double>(fileSize) / (1024.0 * 1024.0));
+	ImGui::Text("Resident Bricks: %i / %u", residentCount.load(), header->slotCount);
+	ImGui::Text("Page Faults Last Frame: %i", faultsLastFrame);
+	ImGui::Text("Prefetched Last Frame: %i", prefetchesLastFrame);
+	ImGui::Text("Evictions Last Frame: %i", evictionsLastFrame);
+	return false;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+namespace Tmpl8 {
+	class VoxelWorld;
+	struct Brick;
+
+	// a page file is this header, one entry per brick and then the brick payloads, starting at payloadOffset
+	struct PageFileHeader {
+		uint magic;
+		uint version;
+		int gridX, gridY, gridZ;
+		uint brickSize;
+		uint slotCount;
+		uint padding;
+		uint64_t payloadOffset;
+	};
+
+	struct PageFileEntry {
+		uint slot;			// index of the payload, EmptySlot for bricks without voxels
+		uint voxelCount;
+	};
+
+	// backs a VoxelWorld with a memory mapped page file, so worlds bigger than memory can be rendered.
+	// bricks are paged in when a ray reaches them or when the camera heads their way, and the least
+	// recently used ones are evicted when over budget. edits go straight into the mapped file, bricks that
+	// edits create in empty slots are moved into new slots at the end of the file.
+	class BrickPager {
+	public:
+		static constexpr uint EmptySlot = 0xFFFFFFFF;
+
+		// writes a world to a page file one slab of bricks at a time, missing bricks can be generated from the noise settings
+		// without ever having the whole world in memory. a paged world pages its missing bricks in instead, so its page file
+		// can't be the one being written
+		static bool Write(VoxelWorld* world, const char* path, const bool generateMissing);
+		// maps a page file, nullptr if it can't be opened or isn't a valid page file
+		static BrickPager* Open(const char* path);
+		~BrickPager();
+
+		// the world has to match the grid of the page file and must not have bricks of its own yet
+		void Attach(VoxelWorld* world);
+		int3 GetGridDimensions() const { return make_int3(header->gridX, header->gridY, header->gridZ); }
+
+		// called by rays and edits that reach a brick that isn't resident, returns nullptr for empty bricks
+		inline Brick* Fault(const int brickIndex) {
+			if (entries[brickIndex].slot == EmptySlot) return nullptr;
+			return PageIn(brickIndex, faultCount);
+		}
+
+		// called when an edit publishes a new brick in a slot that is empty in the page file, the next Update or closing
+		// the pager moves it into the file
+		inline void Adopt(const int brickIndex) {
+			std::lock_guard<std::mutex> lock(adoptMutex);
+			adopted.push_back(brickIndex);
+		}
+
+		// called by rays that reach a resident brick, for the LRU
+		inline void MarkUsed(const int brickIndex) {
+			const uint currentFrame = frame.load(std::memory_order_relaxed);
+			if (lastUsed[brickIndex].load(std::memory_order_relaxed) != currentFrame) lastUsed[brickIndex].store(currentFrame, std::memory_order_relaxed);
+		}
+
+		// once per frame from the main thread, while no rays are being traced
+		void Update(const float3& cameraPosition);
+		bool DrawImGui(const int index);
+
+		int brickBudget = 65536;	// resident bricks before the least recently used ones get evicted
+		int prefetchRadius = 2;		// bricks around the camera path that get paged in ahead of rays
+		int prefetchFrames = 8;		// how many frames of camera motion to look ahead
+
+	private:
+		BrickPager() = default;
+		Brick* PageIn(const int brickIndex, std::atomic<int>& counter);
+		void PrefetchAround(const float3& localPosition);
+		void AdoptNewBricks();
+		bool Grow(const uint64_t size);
+		// removed when the voxels go away with the page file, plain evictions page back in unchanged and aren't reported
+		void Evict(const int brickIndex, const bool removed = false);
+
+		VoxelWorld* world = nullptr;
+		int brickCount = 0;
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = nullptr;
+		uint8_t* view = nullptr;
+		uint64_t fileSize = 0;
+		// views of the file before it grew, bricks that were mapped from them keep using them until the pager closes
+		std::vector<std::pair<HANDLE, uint8_t*>> oldViews;
+		PageFileHeader* header = nullptr;
+		PageFileEntry* entries = nullptr;
+		uint* payload = nullptr;
+
+		std::atomic<uint>* lastUsed = nullptr;
+		std::atomic<uint> frame = 1;
+		float3 lastCamera;
+		bool hasLastCamera = false;
+		std::vector<WIN32_MEMORY_RANGE_ENTRY> prefetchRanges;
+		std::vector<int> adopted;
+		std::mutex adoptMutex;
+
+		// statistics
+		std::atomic<int> residentCount = 0;
+		std::atomic<int> faultCount = 0;
+		std::atomic<int> prefetchCount = 0;
+		int faultsLastFrame = 0;
+		int prefetchesLastFrame = 0;
+		int evictionsLastFrame = 0;
+	};
+}
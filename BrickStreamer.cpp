@@ -0,0 +1,160 @@
+#include "precomp.h"
+
+BrickStreamer::BrickStreamer(VoxelWorld* _world, const int workerCount)
+	: world(_world), brickCount(VoxelWorld::GetGridSize(_world->gridDimensions)) {
+	states = new std::atomic<uint8_t>[brickCount];
+	placeholders = new std::atomic<uint>[brickCount];
+	lastUsed = new std::atomic<uint>[brickCount];
+	for (int i = 0; i < brickCount; i++) {
+		// bricks that already exist (generated or edited before streaming) count as resident, but are never evicted:
+		// the noise settings may have changed since they were generated
+		Brick* b = world->bricks[i].load();
+		const bool exists = b != nullptr;
+		if (b) b->generated = false;
+		states[i] = exists ? Resident : NotRequested;
+		placeholders[i] = 0;
+		lastUsed[i] = 0;
+		if (exists) residentCount++;
+	}
+	xCoords = world->GetNoiseXCoordinates();
+
+	for (int i = 0; i < workerCount; i++) {
+		workers.emplace_back(&BrickStreamer::WorkerLoop, this);
+	}
+}
+
+BrickStreamer::~BrickStreamer() {
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		running = false;
+	}
+	queueCondition.notify_all();
+	for (auto& worker : workers) {
+		worker.join();
+	}
+
+	delete[] states;
+	delete[] placeholders;
+	delete[] lastUsed;
+}
+
+void BrickStreamer::Request(const int brickIndex) {
+	// many rays can hit the same brick in a frame, only the first one queues it
+	uint8_t expected = NotRequested;
+	if (!states[brickIndex].compare_exchange_strong(expected, Queued)) return;
+
+	// a single noise sample in the middle of the brick as coarse occupancy until the real data arrives
+	const int3 worldSize = world->gridDimensions * BRICKSIZE;
+	const int3 center = make_int3(brickIndex % world->gridDimensions.x, (brickIndex / world->gridDimensions.x) % world->gridDimensions.y,
+		brickIndex / (world->gridDimensions.x * world->gridDimensions.y)) * BRICKSIZE + BRICKSIZE / 2;
+	const float n = noise3D(xCoords[center.x], (float)center.y / worldSize.y, (float)center.z / worldSize.z, world->NoiseFrequency, world->NoiseAmplitude);
+	if (n > 0.09f) {
+		const uint color = world->NoiseColor == 0 ? ComputeVoxelColor(center.x, center.y, center.z, worldSize) : world->NoiseColor;
+		placeholders[brickIndex].store(color, std::memory_order_relaxed);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		queue.push_back(brickIndex);
+	}
+	queueCondition.notify_one();
+}
+
+void BrickStreamer::WorkerLoop() {
+	while (true) {
+		int brickIndex;
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			queueCondition.wait(lock, [this] { return !running || !queue.empty(); });
+			if (!running) return;
+			brickIndex = queue.front();
+			queue.pop_front();
+		}
+
+		// an edit may have faulted the brick in since it was queued, that brick must not be generated over
+		if (states[brickIndex].load(std::memory_order_acquire) == Resident) continue;
+		world->GenerateBrick(brickIndex, xCoords.data(), false);
+		MakeResident(brickIndex);
+	}
+}
+
+Brick* BrickStreamer::Fault(const int brickIndex) {
+	if (states[brickIndex].load(std::memory_order_acquire) != Resident) {
+		world->GenerateBrick(brickIndex, xCoords.data(), false);
+		MakeResident(brickIndex);
+	}
+	return world->bricks[brickIndex].load(std::memory_order_acquire);
+}
+
+void BrickStreamer::MakeResident(const int brickIndex) {
+	placeholders[brickIndex].store(0, std::memory_order_relaxed);
+	lastUsed[brickIndex].store(frame.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	// a worker and an edit can both generate the same brick, only the first one counts it
+	if (states[brickIndex].exchange(Resident, std::memory_order_acq_rel) == Resident) return;
+	if (world->bricks[brickIndex].load()) residentCount++;
+	generatedCount++;
+}
+
+void BrickStreamer::Update(const float3& cameraPosition) {
+	frame++;
+	generatedLastFrame = generatedCount.exchange(0);
+	evictedLastFrame = 0;
+
+	// request the bricks around the camera before any ray gets to them, and keep them from being evicted
+	const int3 gridDimensions = world->gridDimensions;
+	const float3 localCamera = world->invTransform.TransformPoint(cameraPosition) * GRIDDIMENSIONS;
+	const int3 center = make_int3(static_cast<int>(floorf(localCamera.x)), static_cast<int>(floorf(localCamera.y)), static_cast<int>(floorf(localCamera.z)));
+	const int3 from = max(center - radius, make_int3(0));
+	const int3 to = min(center + radius + 1, gridDimensions);
+	for (int z = from.z; z < to.z; z++) {
+		for (int y = from.y; y < to.y; y++) {
+			for (int x = from.x; x < to.x; x++) {
+				const int index = VoxelWorld::GetBrickIndex(x, y, z, gridDimensions);
+				if (states[index].load(std::memory_order_relaxed) == NotRequested) Request(index);
+				else MarkUsed(index);
+			}
+		}
+	}
+
+	// no rays are in flight here, so bricks can be deleted safely
+	const int resident = residentCount;
+	if (resident <= brickBudget) return;
+
+	std::vector<std::pair<uint, int>> candidates;
+	for (int i = 0; i < brickCount; i++) {
+		// edited bricks can't be generated again, they stay
+		const Brick* b = world->bricks[i].load();
+		if (states[i].load(std::memory_order_acquire) == Resident && b && b->generated.load(std::memory_order_relaxed)) {
+			candidates.emplace_back(lastUsed[i].load(std::memory_order_relaxed), i);
+		}
+	}
+	// evict a bit more than needed so we don't end up doing this every frame
+	const int evictCount = std::min(static_cast<int>(candidates.size()), resident - brickBudget * 9 / 10);
+	std::nth_element(candidates.begin(), candidates.begin() + evictCount, candidates.end());
+	for (int i = 0; i < evictCount; i++) {
+		const int index = candidates[i].second;
+		delete world->TakeBrick(index);
+		states[index].store(NotRequested, std::memory_order_relaxed);
+		residentCount--;
+		evictedLastFrame++;
+	}
+}
+
+bool BrickStreamer::DrawImGui(const int index) {
+	bool changed = false;
+	std::string radiusLabel = "Camera Radius##" + std::to_string(index);
+	std::string budgetLabel = "Brick Budget##" + std::to_string(index);
+	changed |= ImGui::SliderInt(radiusLabel.c_str(), &radius, 0, 32);
+	ImGui::SliderInt(budgetLabel.c_str(), &brickBudget, 256, 1 << 20);
+
+	size_t queued;
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		queued = queue.size();
+	}
+	ImGui::Text("Resident Bricks: %i / %i", residentCount.load(), brickCount);
+	ImGui::Text("Queued Bricks: %zu", queued);
+	ImGui::Text("Generated Last Frame: %i", generatedLastFrame);
+	ImGui::Text("Evicted Last Frame: %i", evictedLastFrame);
+	return changed;
+}
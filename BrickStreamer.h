@@ -0,0 +1,68 @@
+#pragma once
+
+namespace Tmpl8 {
+	class VoxelWorld;
+
+	// generates the bricks of a procedural VoxelWorld on demand (first ray access or near the camera) on worker threads
+	// and evicts the least recently used ones that weren't edited when over budget. until a brick is generated rays see
+	// a coarse placeholder. edits generate the bricks they touch right away, so they never land in an ungenerated slot.
+	class BrickStreamer {
+	public:
+		enum BrickState : uint8_t {
+			NotRequested,
+			Queued,
+			Resident // generated, the brick pointer may still be null if it turned out empty
+		};
+
+		BrickStreamer(VoxelWorld* world, const int workerCount = 2);
+		~BrickStreamer();
+
+		// called by rays that reach a brick without data, returns the placeholder voxel for it (0 = empty)
+		inline uint Touch(const int brickIndex) {
+			if (states[brickIndex].load(std::memory_order_relaxed) == NotRequested) Request(brickIndex);
+			return placeholders[brickIndex].load(std::memory_order_relaxed);
+		}
+
+		// generates the brick right away unless it is resident already, for edits that must not land in an ungenerated slot.
+		// returns the brick, null if it turned out empty
+		Brick* Fault(const int brickIndex);
+
+		// called by rays that reach a resident brick, for the LRU
+		inline void MarkUsed(const int brickIndex) {
+			const uint currentFrame = frame.load(std::memory_order_relaxed);
+			if (lastUsed[brickIndex].load(std::memory_order_relaxed) != currentFrame) lastUsed[brickIndex].store(currentFrame, std::memory_order_relaxed);
+		}
+
+		// once per frame from the main thread, while no rays are being traced
+		void Update(const float3& cameraPosition);
+		bool DrawImGui(const int index);
+
+		int radius = 4;				// bricks around the camera that get requested ahead of rays
+		int brickBudget = 8192;		// resident bricks before the least recently used ones get evicted
+
+	private:
+		void Request(const int brickIndex);
+		void WorkerLoop();
+		void MakeResident(const int brickIndex);
+
+		VoxelWorld* world;
+		const int brickCount;
+		std::atomic<uint8_t>* states;
+		std::atomic<uint>* placeholders;
+		std::atomic<uint>* lastUsed;
+		std::atomic<uint> frame = 1;
+		std::vector<float> xCoords;
+
+		std::deque<int> queue;
+		std::mutex queueMutex;
+		std::condition_variable queueCondition;
+		std::vector<std::thread> workers;
+		std::atomic<bool> running = true;
+
+		// statistics
+		std::atomic<int> residentCount = 0;
+		std::atomic<int> generatedCount = 0;
+		int generatedLastFrame = 0;
+		int evictedLastFrame = 0;
+	};
+}
@@ -16,6 +16,16 @@ float3 Ray::GetNormal() const {
 	//return the normal of the sphere at the nearest intersection
 	return N;
 #else
+	// the traversal recorded which face we entered through, only fall back to reconstruction when it couldn't
+	if (entryAxis < 0) return ReconstructNormal();
+
+	float3 normal = float3(0);
+	normal[entryAxis] = static_cast<float>(entrySign);
+	return normalize(worldTransform.TransformVector(normal));
+#endif
+}
+
+float3 Ray::ReconstructNormal() const {
 	float3 intersectionPoint = O + t * D;
 	// Transform the intersection point into object space
 	intersectionPoint = invWorldTransform.TransformPoint(intersectionPoint);
@@ -33,16 +43,18 @@ float3 Ray::GetNormal() const {
 
 	// Normalize the transformed normal to address potential scaling/shearing issues
 	return normalize(normal);
-#endif
 }
 
-
 float3 Ray::GetAlbedo() const {
+	const Material& m = GetMaterial();
+	return ComputeAlbedo(m, m.hasTexture ? GetUV() : float2(0));
+}
+
+float3 Ray::ComputeAlbedo(const Material& m, const float2& uv) const {
 	float3 textureColor = float3(1, 1, 1);
-	Material m = GetMaterial();
 	if (m.hasTexture) {
 		textureColor =
-			m.GetTextureColor(GetUV());
+			m.GetTextureColor(uv);
 	}
 
 	float3 voxelColor;
@@ -63,9 +75,11 @@ float3 Ray::GetAlbedo() const {
 
 float2 Ray::GetUV() const {
 	// Calculate the normal at the intersection point
-	float3 N = GetNormal();
-	float3 hitPos = O + t * D;
-	hitPos = hitPos * WORLDSIZE;
+	return ComputeUV(GetNormal(), O + t * D);
+}
+
+float2 Ray::ComputeUV(const float3& N, const float3& hitPoint) {
+	const float3 hitPos = hitPoint * WORLDSIZE;
 
 	// Calculate UV coordinates based on the face normal
 	float u, v;
@@ -94,7 +108,17 @@ float2 Ray::GetUV() const {
 	return float2(u, v);
 }
 
-Material Tmpl8::Ray::GetMaterial() const {
+// normal, uv, albedo and material in one pass, so shading doesn't redo the normal and material lookups per attribute
+SurfaceInfo Ray::ComputeSurface() const {
+	SurfaceInfo surface;
+	surface.material = &GetMaterial();
+	surface.normal = GetNormal();
+	surface.uv = ComputeUV(surface.normal, O + t * D);
+	surface.albedo = ComputeAlbedo(*surface.material, surface.uv);
+	return surface;
+}
+
+const Material& Tmpl8::Ray::GetMaterial() const {
 	//get material index form the first 8 bits of the voxel
 	int newIndex = voxel >> 24;
 	return MaterialList[newIndex];
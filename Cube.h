@@ -3,7 +3,15 @@
 #pragma warning(disable: 4201)
 
 namespace Tmpl8 {
-	// 196 bytes
+	// everything needed to shade a hit, computed in one go by Ray::ComputeSurface
+	struct SurfaceInfo {
+		float3 normal;				// world space face normal
+		float2 uv;					// texture coordinates on the hit face
+		float3 albedo;				// voxel color combined with the material texture
+		const Material* material;	// material of the hit voxel
+	};
+
+	// 220 bytes
 	class Ray {
 	public:
 		Ray() = default;
@@ -27,8 +35,9 @@ namespace Tmpl8 {
 		float3 GetNormal() const;
 		float3 GetAlbedo() const;
 		float2 GetUV() const;
-		Material GetMaterial() const;
+		const Material& GetMaterial() const;
 		int GetMaterialIndex() const;
+		SurfaceInfo ComputeSurface() const;
 		// ray data
 
 		//union { struct { float3 O; float dummy1; }; __m128 O4; }; // ray origin,
@@ -46,12 +55,19 @@ namespace Tmpl8 {
 		int steps = 0;				// number of steps taken in the ray, 4 bytes
 		int index = -1;				// index of the voxel, 4 bytes
 		int worldIndex = -1;			// index of the world, 4 bytes
+		int entryAxis = -1;			// axis the ray entered the hit voxel through (0 = x, 1 = y, 2 = z, -1 = unknown), 4 bytes
+		int entrySign = 0;			// sign of the (local) face normal on entryAxis, 4 bytes
+		int3 localVoxel;			// coordinate of the hit voxel inside its world, 16 bytes
 		mat4 worldTransform;		// transform of the world, 64 bytes
 		mat4 invWorldTransform;		// inverse transform of the world, 64 bytes
 #if SPHERES
 		float3 N;					// normal at intersection point, 12 bytes
 #endif
 	private:
+		float3 ReconstructNormal() const;
+		static float2 ComputeUV(const float3& N, const float3& hitPos);
+		float3 ComputeAlbedo(const Material& m, const float2& uv) const;
+
 		// min3 is used in normal reconstruction.
 		__inline static float3 min3(const float3& a, const float3& b) {
 			return float3(min(a.x, b.x), min(a.y, b.y), min(a.z, b.z));
@@ -80,7 +96,7 @@ namespace Tmpl8 {
 		uint posX, posY, posZ;			// 12 bytes
 		float travelDistance;				// 4 bytes
 		float3 deltaDistance; 			// 12 bytes
-		float dummy1 = 0;		// 4 bytes
+		int entryAxis = -1;		// axis of the last step (0 = x, 1 = y, 2 = z, -1 = none yet), 4 bytes
 		float3 nextIntersection;		// 12 bytes
 		float dummy2 = 0;		// 4 bytes, 64 bytes total
 	};
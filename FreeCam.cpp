@@ -44,7 +44,7 @@ void FreeCam::Init() {
 	explosionMaterial.roughness = 1.0f;
 	explosionMaterial.emissionIntensity = 100.0f;
 	explosionMaterial.emissionColor = float3(0.3f, 0.0f, 0.0f);
-	MaterialList.push_back(explosionMaterial);
+	MaterialList.push_back(explosionMaterial.BakeLUT());
 	explosionMaterialIndex = static_cast<int>(MaterialList.size()) - 1;
 }
 
@@ -128,15 +128,18 @@ void FreeCam::HanldeInput() {
 		renderer->scene.FindNearest(ray);
 		int worldIndex = ray.worldIndex;
 		if (worldIndex == -1 || worldIndex >= 2 || ray.GetMaterialIndex() == explosionMaterialIndex) return;
+		WorldHandle target = renderer->scene.worlds.GetHandle(worldIndex);
 
-		VoxelWorld* bullet = new VoxelWorld(*bulletPrefab);
+		// bullets come from the scene's pool and share the prefab's bricks, so spawning one allocates nothing.
+		// the handle removes the bullet again without looking it up
+		const WorldHandle bulletHandle = renderer->scene.SpawnInstance(*bulletPrefab);
+		VoxelWorld* bullet = renderer->scene.worlds.Get(bulletHandle);
+		if (!bullet) return;
 		bullet->SetActive(true);
 		bullet->position = renderer->camera.camPos + renderer->camera.GetForward() * 0.1f;
 		bullet->rotation = renderer->camera.GetRotation();
 		bullet->scale = float3(0.5f);
 		bullet->UpdateTransform();
-		renderer->scene.worlds.push_back(bullet);
-		VoxelWorld* owner = bullet;
 
 		float3 endPos = ray.IntersectionPoint();
 		float3 localEndPos = ray.LocalIntersectionPoint();
@@ -149,12 +152,11 @@ void FreeCam::HanldeInput() {
 			bullet->position = pos;
 			bullet->UpdateTransformCentered();
 			});
-		tween->OnFinish([this, bullet, worldIndex, localEndPos, owner](float3) {
+		tween->OnFinish([this, bullet, bulletHandle, worldIndex, localEndPos, target](float3) {
 			bullet->SetActive(false);
 			//remove bullet from scene
-			explosions.push_back({ make_int3(localEndPos * WORLDSIZE), worldIndex, owner });
-			renderer->scene.worlds.erase(std::remove(renderer->scene.worlds.begin(), renderer->scene.worlds.end(), bullet), renderer->scene.worlds.end());
-			delete bullet;
+			explosions.push_back({ make_int3(localEndPos * WORLDSIZE), worldIndex, target });
+			renderer->scene.RemoveWorld(bulletHandle);
 			});
 		TweenManager::GetInstance().AddTween(std::move(tween));
 	}
@@ -163,17 +165,26 @@ void FreeCam::HanldeInput() {
 void FreeCam::HandleExplosions(const float deltaTime) {
 	for (int i = 0; i < explosions.size(); i++) {
 		ExplosionLocation& explosion = explosions[i];
+		if (!renderer->scene.worlds.Get(explosion.world)) {
+			explosion.duration = wave3 + 1.0f;
+			continue;
+		}
 		//lerp size from 0 to explosionMaxSize over wave3 seconds
 		float size = lerp(0.0f, explosionMaxSize, explosion.duration / wave3);
 
 		explosion.duration += deltaTime;
-		DrawSphere(renderer->scene, explosion.position, size, 0xffffff, 0, explosion.worldIndex, explosionProbabilty);
+		const float3 center = make_float3(explosion.position);
 		if (explosion.duration > wave1 && explosion.duration < wave2) {
-			DrawSphere(renderer->scene, explosion.position, size, 0xffff00, explosionMaterialIndex, explosion.worldIndex, 1.0f);
-		} else if (explosion.duration > wave2 && explosion.duration < wave3) {
-			DrawSphere(renderer->scene, explosion.position, size, 0xff0000, explosionMaterialIndex, explosion.worldIndex, explosionProbabilty);
+			// a solid ball of fire
+			renderer->scene.CsgSphere(CsgOp::Union, center, size, 0xffff00, explosionMaterialIndex, explosion.worldIndex);
 		} else if (explosion.duration > wave3) {
-			DrawSphere(renderer->scene, explosion.position, size, 0, explosionMaterialIndex, explosion.worldIndex, explosionProbabilty);
+			// the crater that is left
+			renderer->scene.CsgSphere(CsgOp::Subtract, center, size, 0, 0, explosion.worldIndex);
+		} else {
+			// sparks in the carved out sphere, white at first and red once the fire dies down
+			const bool dying = explosion.duration > wave2;
+			renderer->scene.CsgSphere(CsgOp::Subtract, center, size, 0, 0, explosion.worldIndex);
+			renderer->scene.CsgSphere(CsgOp::Union, center, size, dying ? 0xff0000 : 0xffffff, dying ? explosionMaterialIndex : 0, explosion.worldIndex, explosionProbabilty, explosion.seed);
 		}
 	}
 
@@ -8,9 +8,10 @@ struct ExplosionLocation {
 	int3 position;
 	float duration;
 	int worldIndex;
-	VoxelWorld* world;
+	WorldHandle world;	// the world that was hit, the explosion stops if it gets removed
 	float size;
-	ExplosionLocation(int3 position, int worldIndex, VoxelWorld* newOwner) : position(position), duration(0.0f), worldIndex(worldIndex), size(0.0f), world(newOwner) {}
+	uint seed;			// the pattern of its sparks
+	ExplosionLocation(int3 position, int worldIndex, WorldHandle world) : position(position), duration(0.0f), worldIndex(worldIndex), world(world), size(0.0f), seed(RandomUInt()) {}
 };
 
 class FreeCam : public GameScene {
@@ -27,28 +27,19 @@ static inline bool DirectionProperties(float3& direction, int index) {
 }
 
 static inline bool SurfaceDropDown(Surface* surface, int) {
-	//Read all the .png files in the assets folder and store them in a vector
-	std::vector<std::string> hdrFiles;
-	for (const auto& entry : std::filesystem::directory_iterator("assets")) {
-		if (entry.path().extension() == ".png") {
-			hdrFiles.push_back(entry.path().filename().string());
-		}
-	}
+	// the .png files in the assets folder
+	std::shared_ptr<const AssetList> hdrFiles = AssetCatalog::GetInstance().GetList("assets", ".png");
 
 	// Dropdown for selecting .png file
 	static int selectedItem = -1; // Index of the selected item in the combo box
-	if (!hdrFiles.empty()) {
-		std::vector<const char*> cStrHdrFiles; // ImGui needs const char* array
-		for (const auto& file : hdrFiles) {
-			cStrHdrFiles.push_back(file.c_str());
-		}
-
-		ImGui::Combo("HDR Files", &selectedItem, &cStrHdrFiles[0], static_cast<int>((cStrHdrFiles.size())));
+	if (selectedItem >= static_cast<int>(hdrFiles->names.size())) selectedItem = -1;
+	if (!hdrFiles->IsEmpty()) {
+		ImGui::Combo("HDR Files", &selectedItem, hdrFiles->items.data(), static_cast<int>(hdrFiles->items.size()));
 	}
 
 	if (ImGui::Button("Load HDR File") && selectedItem >= 0) {
 		// Load the selected .png file
-		std::string path = "assets/" + hdrFiles[selectedItem];
+		std::string path = hdrFiles->GetPath(selectedItem);
 		if (surface->ownBuffer) FREE64(surface->pixels);
 		surface->LoadFromFile(path.c_str());
 		return true;
@@ -57,30 +48,21 @@ static inline bool SurfaceDropDown(Surface* surface, int) {
 }
 
 static inline bool SurfaceDropDown(FLoatSurface* surface, int index) {
-	//Read all the .png files in the assets folder and store them in a vector
-	std::vector<std::string> hdrFiles;
-	for (const auto& entry : std::filesystem::directory_iterator("assets")) {
-		if (entry.path().extension() == ".png" || entry.path().extension() == ".hdr") {
-			hdrFiles.push_back(entry.path().filename().string());
-		}
-	}
+	// the .png and .hdr files in the assets folder
+	std::shared_ptr<const AssetList> hdrFiles = AssetCatalog::GetInstance().GetList("assets", ".png;.hdr");
 
 	// Dropdown for selecting .png file
 	static int selectedItem = -1; // Index of the selected item in the combo box
+	if (selectedItem >= static_cast<int>(hdrFiles->names.size())) selectedItem = -1;
 	std::string label = "Files##" + std::to_string(index);
-	if (!hdrFiles.empty()) {
-		std::vector<const char*> cStrHdrFiles; // ImGui needs const char* array
-		for (const auto& file : hdrFiles) {
-			cStrHdrFiles.push_back(file.c_str());
-		}
-
-		ImGui::Combo(label.c_str(), &selectedItem, &cStrHdrFiles[0], static_cast<int>(cStrHdrFiles.size()));
+	if (!hdrFiles->IsEmpty()) {
+		ImGui::Combo(label.c_str(), &selectedItem, hdrFiles->items.data(), static_cast<int>(hdrFiles->items.size()));
 	}
 
 	std::string loadLabel = "Load File##" + std::to_string(index);
 	if (ImGui::Button(loadLabel.c_str()) && selectedItem >= 0) {
 		// Load the selected .png file
-		std::string path = "assets/" + hdrFiles[selectedItem];
+		std::string path = hdrFiles->GetPath(selectedItem);
 		if (surface == nullptr) {
 			surface = new FLoatSurface();
 		} else {
@@ -0,0 +1,38 @@
+#include "precomp.h"
+
+InstancePool::InstancePool(const int blockSize) : blockSize(blockSize) {
+}
+
+InstancePool::~InstancePool() {
+	for (uint8_t* block : blocks) {
+		FREE64(block);
+	}
+}
+
+VoxelWorld* InstancePool::Acquire(const VoxelWorld& prefab) {
+	if (freeSlots.empty()) Grow();
+	void* slot = freeSlots.back();
+	freeSlots.pop_back();
+
+	VoxelWorld* instance = new (slot) VoxelWorld(prefab);
+	instance->pool = this;
+	activeCount++;
+	return instance;
+}
+
+void InstancePool::Release(VoxelWorld* instance) {
+	instance->~VoxelWorld();
+	freeSlots.push_back(instance);
+	activeCount--;
+}
+
+void InstancePool::Grow() {
+	// worlds hold aligned matrices, so every slot starts on a cache line
+	const size_t stride = (sizeof(VoxelWorld) + 63) & ~static_cast<size_t>(63);
+	uint8_t* block = static_cast<uint8_t*>(MALLOC64(stride * blockSize));
+	blocks.push_back(block);
+	// reversed, so slots are handed out front to back
+	for (int i = blockSize - 1; i >= 0; i--) {
+		freeSlots.push_back(block + i * stride);
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+namespace Tmpl8 {
+	class VoxelWorld;
+
+	// hands out VoxelWorld instances from fixed size blocks, so short lived objects (bullets, debris, particles) don't hit
+	// the heap every time one spawns. instances show the bricks of their prefab and only own a transform and settings
+	// until something edits them.
+	// instances that are still out when the pool goes away are not destroyed
+	class InstancePool {
+	public:
+		InstancePool(const int blockSize = 256);
+		~InstancePool();
+		InstancePool(const InstancePool&) = delete;
+		InstancePool& operator=(const InstancePool&) = delete;
+
+		VoxelWorld* Acquire(const VoxelWorld& prefab);
+		void Release(VoxelWorld* instance);
+
+		int GetActiveCount() const { return activeCount; }
+		int GetCapacity() const { return static_cast<int>(blocks.size()) * blockSize; }
+
+	private:
+		void Grow();
+
+		const int blockSize;
+		std::vector<uint8_t*> blocks;
+		std::vector<void*> freeSlots;
+		int activeCount = 0;
+	};
+}
@@ -0,0 +1,95 @@
+#include "precomp.h"
+
+LevelCache::LevelCache() {
+	worker = std::thread(&LevelCache::WorkerLoop, this);
+}
+
+LevelCache::~LevelCache() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+	condition.notify_all();
+	if (worker.joinable()) worker.join();
+
+	for (Entry& entry : entries) {
+		delete entry.world;
+	}
+}
+
+LevelCache::Entry* LevelCache::Find(const std::shared_ptr<PuzzleLevel>& level) {
+	for (Entry& entry : entries) {
+		if (entry.level == level) return &entry;
+	}
+	return nullptr;
+}
+
+void LevelCache::Preload(const std::shared_ptr<PuzzleLevel>& level) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!level || Find(level)) return;
+		entries.push_back(Entry{ level, nullptr });
+		queue.push_back(level);
+	}
+	condition.notify_one();
+}
+
+bool LevelCache::IsPending(const std::shared_ptr<PuzzleLevel>& level) {
+	std::lock_guard<std::mutex> lock(mutex);
+	const Entry* entry = Find(level);
+	return entry && !entry->world;
+}
+
+VoxelWorld* LevelCache::Take(const std::shared_ptr<PuzzleLevel>& level) {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto it = entries.begin(); it != entries.end(); ++it) {
+		if (it->level != level || !it->world) continue;
+		VoxelWorld* world = it->world;
+		entries.erase(it);
+		return world;
+	}
+	return nullptr;
+}
+
+void LevelCache::Trim(const std::vector<std::shared_ptr<PuzzleLevel>>& keep) {
+	std::lock_guard<std::mutex> lock(mutex);
+	const auto isKept = [&](const std::shared_ptr<PuzzleLevel>& level) {
+		return std::find(keep.begin(), keep.end(), level) != keep.end();
+	};
+	// a level that is being built right now is deleted by the worker when it finds its entry gone
+	for (auto it = entries.begin(); it != entries.end();) {
+		if (isKept(it->level)) {
+			++it;
+			continue;
+		}
+		delete it->world;
+		it = entries.erase(it);
+	}
+	queue.erase(std::remove_if(queue.begin(), queue.end(), [&](const std::shared_ptr<PuzzleLevel>& level) { return !isKept(level); }), queue.end());
+}
+
+int LevelCache::GetReadyCount() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return static_cast<int>(std::count_if(entries.begin(), entries.end(), [](const Entry& entry) { return entry.world != nullptr; }));
+}
+
+void LevelCache::WorkerLoop() {
+	while (true) {
+		std::shared_ptr<PuzzleLevel> level;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this] { return !running || !queue.empty(); });
+			if (!running) return;
+			level = queue.front();
+			queue.pop_front();
+		}
+
+		VoxelWorld* world = level->BuildWorld();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		// a level that was queued again while it was building already has its world
+		Entry* entry = Find(level);
+		if (entry && !entry->world) entry->world = world;
+		else delete world;
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+class PuzzleLevel;
+namespace Tmpl8 {
+	class VoxelWorld;
+}
+
+// builds puzzle levels into worlds on a worker thread, so switching to a level only has to swap a finished world
+// into the scene instead of writing every voxel on the main thread
+class LevelCache {
+public:
+	LevelCache();
+	~LevelCache();
+	LevelCache(const LevelCache&) = delete;
+	LevelCache& operator=(const LevelCache&) = delete;
+
+	// queues a level, nothing happens if it is already queued or built
+	void Preload(const std::shared_ptr<PuzzleLevel>& level);
+	// true while the level is queued or being built
+	bool IsPending(const std::shared_ptr<PuzzleLevel>& level);
+	// the built world, which the caller owns from here on. nullptr if the level wasn't preloaded or isn't done yet
+	VoxelWorld* Take(const std::shared_ptr<PuzzleLevel>& level);
+	// forgets every level that isn't in keep
+	void Trim(const std::vector<std::shared_ptr<PuzzleLevel>>& keep);
+	int GetReadyCount();
+
+private:
+	struct Entry {
+		std::shared_ptr<PuzzleLevel> level;
+		VoxelWorld* world = nullptr;	// null until built
+	};
+
+	void WorkerLoop();
+	Entry* Find(const std::shared_ptr<PuzzleLevel>& level);
+
+	std::vector<Entry> entries;
+	std::deque<std::shared_ptr<PuzzleLevel>> queue;
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::thread worker;
+	bool running = true;
+};
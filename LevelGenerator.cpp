@@ -0,0 +1,100 @@
+#include "precomp.h"
+
+LevelGenerator::LevelGenerator() {
+	worker = std::thread(&LevelGenerator::WorkerLoop, this);
+}
+
+LevelGenerator::~LevelGenerator() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+	condition.notify_all();
+	if (worker.joinable()) worker.join();
+
+	for (Result& result : ready) {
+		delete result.world;
+	}
+}
+
+void LevelGenerator::Start(const std::shared_ptr<const PuzzleLevel>& _base, const uint firstSeed, const int count, const float _lightHeight) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		base = _base;
+		nextSeed = firstSeed;
+		wanted = max(count, 0);
+		lightHeight = _lightHeight;
+		search++;
+		stats.seedsTried = 0;
+		stats.seedsSolvable = 0;
+		stats.seedsPerSecond = 0.0f;
+		stats.solveTime = 0.0f;
+		totalSolveTime = 0.0f;
+		searchStart = std::chrono::steady_clock::now();
+	}
+	condition.notify_one();
+}
+
+void LevelGenerator::Stop() {
+	std::lock_guard<std::mutex> lock(mutex);
+	wanted = 0;
+	search++;
+}
+
+bool LevelGenerator::Take(Result& result) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (ready.empty()) return false;
+	result = ready.front();
+	ready.pop_front();
+	return true;
+}
+
+LevelGenerator::Stats LevelGenerator::GetStats() {
+	std::lock_guard<std::mutex> lock(mutex);
+	stats.ready = static_cast<int>(ready.size());
+	stats.wanted = wanted;
+	return stats;
+}
+
+void LevelGenerator::WorkerLoop() {
+	while (true) {
+		std::shared_ptr<const PuzzleLevel> level;
+		uint seed, searchId;
+		float height;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this] { return !running || (wanted > 0 && base); });
+			if (!running) return;
+			level = base;
+			seed = nextSeed++;
+			searchId = search;
+			height = lightHeight;
+		}
+
+		Result result;
+		result.seed = seed;
+		result.level = PuzzleLevel::Generate(*level, seed);
+		result.world = result.level->BuildWorld();
+		result.solution = LevelSolver::Solve(*result.level, *result.world, height);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		// Start or Stop came in while this seed was being solved
+		if (searchId != search || wanted <= 0) {
+			delete result.world;
+			continue;
+		}
+		stats.seedsTried++;
+		totalSolveTime += result.solution.solveTime;
+		stats.solveTime = totalSolveTime / static_cast<float>(stats.seedsTried);
+		const float elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - searchStart).count();
+		if (elapsed > 0.0f) stats.seedsPerSecond = static_cast<float>(stats.seedsTried) / elapsed;
+
+		if (!result.solution.IsSolvable()) {
+			delete result.world;
+			continue;
+		}
+		stats.seedsSolvable++;
+		wanted--;
+		ready.push_back(result);
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+class PuzzleLevel;
+namespace Tmpl8 {
+	class VoxelWorld;
+}
+
+// searches seeds for solvable random levels on a worker thread. every seed is generated, built into a world and
+// solved, the solvable ones are kept with their world so loading one only has to swap it into the scene
+class LevelGenerator {
+public:
+	struct Result {
+		std::shared_ptr<PuzzleLevel> level;
+		VoxelWorld* world = nullptr;
+		LevelSolution solution;
+		uint seed = 0;
+	};
+	struct Stats {
+		long long seedsTried = 0;
+		long long seedsSolvable = 0;
+		float seedsPerSecond = 0.0f;	// measured over the current search
+		float solveTime = 0.0f;			// average seconds per seed, solvable or not
+		int ready = 0;
+		int wanted = 0;					// solvable levels the search still has to find
+	};
+
+	LevelGenerator();
+	~LevelGenerator();
+	LevelGenerator(const LevelGenerator&) = delete;
+	LevelGenerator& operator=(const LevelGenerator&) = delete;
+
+	// looks for count solvable levels from firstSeed on, replacing any search that is still going. levels found by
+	// an earlier search stay ready
+	void Start(const std::shared_ptr<const PuzzleLevel>& base, const uint firstSeed, const int count, const float lightHeight);
+	void Stop();
+	// the oldest solvable level found, the caller owns its world from here on. false if there is none yet
+	bool Take(Result& result);
+	Stats GetStats();
+
+private:
+	void WorkerLoop();
+
+	std::shared_ptr<const PuzzleLevel> base;
+	uint nextSeed = 0;
+	int wanted = 0;
+	float lightHeight = 0.0f;
+	uint search = 0;	// bumped by Start, results of an older search are dropped
+
+	std::deque<Result> ready;
+	Stats stats;
+	std::chrono::steady_clock::time_point searchStart;
+	float totalSolveTime = 0.0f;
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::thread worker;
+	bool running = true;
+};
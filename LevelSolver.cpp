@@ -0,0 +1,91 @@
+#include "precomp.h"
+
+float3 LevelSolver::GetLampRayOrigin(const float3& lampPosition, const int i) {
+	// the top corners of the lamp voxel
+	const float halfVoxelSize = VOXELSIZE / 2.0f;
+	static const float2 corners[LampRays] = { float2(1, 1), float2(-1, 1), float2(-1, -1), float2(1, -1) };
+	return lampPosition + float3(corners[i].x * halfVoxelSize, halfVoxelSize, corners[i].y * halfVoxelSize) + float3(0, EPSILON, 0);
+}
+
+float3 LevelSolver::GetLampPosition(const VoxelWorld& world, const int3& voxel) {
+	return world.transform.TransformPoint((float3(voxel) + float3(0.5f)) / WORLDSIZE);
+}
+
+LevelSolution LevelSolver::Solve(const PuzzleLevel& level, const VoxelWorld& world, const float lightHeight, const int samplesPerVoxel) {
+	Timer timer;
+	LevelSolution solution;
+	// the light can go anywhere inside the border, levels are built unscaled so a voxel is VOXELSIZE wide
+	const int samples = max(samplesPerVoxel, 1);
+	solution.gridSize = int2(max(level.Size.x - 2, 0) * samples, max(level.Size.z - 2, 0) * samples);
+	solution.spacing = VOXELSIZE / samples;
+	solution.gridOrigin = world.transform.TransformPoint(float3(1.0f + 0.5f / samples, 0, 1.0f + 0.5f / samples) / WORLDSIZE);
+	solution.gridOrigin.y = lightHeight;
+	const int candidateCount = solution.gridSize.x * solution.gridSize.y;
+	solution.feasible.assign(candidateCount, 0);
+
+	std::vector<int> candidates(candidateCount);
+	for (int i = 0; i < candidateCount; i++) candidates[i] = i;
+
+	// lamps need all their rays and anti lamps none, a lamp usually rules out more so those go first
+	std::vector<const Lamp*> lamps;
+	for (const Lamp& lamp : level.Lamps) lamps.push_back(&lamp);
+	std::stable_sort(lamps.begin(), lamps.end(), [](const Lamp* a, const Lamp* b) { return a->requiredRays > b->requiredRays; });
+
+	std::vector<uint8_t> keep;
+	for (const Lamp* lamp : lamps) {
+		if (candidates.empty()) break;
+		const float3 lampPosition = GetLampPosition(world, lamp->voxel.position);
+		float3 origins[LampRays];
+		for (int i = 0; i < LampRays; i++) origins[i] = GetLampRayOrigin(lampPosition, i);
+
+		// the batch of queries for this lamp, every remaining candidate against every corner
+		const int count = static_cast<int>(candidates.size());
+		keep.assign(count, 0);
+		long long rays = 0;
+#pragma omp parallel for schedule(dynamic, 64) reduction(+ : rays)
+		for (int c = 0; c < count; c++) {
+			const int candidate = candidates[c];
+			const float3 lightPosition = solution.GetCandidate(candidate % solution.gridSize.x, candidate / solution.gridSize.x);
+			int visible = 0;
+			for (int i = 0; i < LampRays; i++) {
+				// built exactly like the rays in PuzzleScene, rays that graze a voxel edge have to come out the same
+				const float3 rayDirection = normalize(lightPosition - origins[i]);
+				const float distance = length(lightPosition - origins[i]);
+				rays++;
+				if (!world.IsOccluded(Ray(origins[i], rayDirection, distance))) visible++;
+				// the count can't end up right anymore
+				if (visible > lamp->requiredRays || visible + LampRays - 1 - i < lamp->requiredRays) break;
+			}
+			keep[c] = visible == lamp->requiredRays;
+		}
+		solution.rayCount += rays;
+
+		int kept = 0;
+		for (int c = 0; c < count; c++) {
+			if (keep[c]) candidates[kept++] = candidates[c];
+		}
+		candidates.resize(kept);
+	}
+
+	// the representative solution is in the middle of the feasible region, so it isn't on the edge of a shadow
+	float3 center = float3(0);
+	for (const int candidate : candidates) {
+		solution.feasible[candidate] = 1;
+		center += solution.GetCandidate(candidate % solution.gridSize.x, candidate / solution.gridSize.x);
+	}
+	solution.feasibleCount = static_cast<int>(candidates.size());
+	if (solution.feasibleCount > 0) {
+		center /= static_cast<float>(solution.feasibleCount);
+		float nearest = 1e34f;
+		for (const int candidate : candidates) {
+			const float3 position = solution.GetCandidate(candidate % solution.gridSize.x, candidate / solution.gridSize.x);
+			const float distance = sqrLength(position - center);
+			if (distance < nearest) {
+				nearest = distance;
+				solution.lightPosition = position;
+			}
+		}
+	}
+	solution.solveTime = timer.elapsed();
+	return solution;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+class PuzzleLevel;
+namespace Tmpl8 {
+	class VoxelWorld;
+}
+
+// the light positions that solve a level: every lamp sees the light from all of its ray corners, and every anti lamp
+// from none. candidates are a grid over the inside of the level at the height the player moves the light at
+struct LevelSolution {
+	int2 gridSize = int2(0);				// candidates along x and z
+	float3 gridOrigin = float3(0);			// world position of the first candidate
+	float spacing = 0.0f;					// world distance between candidates
+	std::vector<uint8_t> feasible;			// per candidate, x + z * gridSize.x
+	int feasibleCount = 0;
+	float3 lightPosition = float3(0);		// the feasible candidate closest to the middle of the feasible region
+	long long rayCount = 0;
+	float solveTime = 0.0f;					// seconds
+
+	bool IsSolvable() const { return feasibleCount > 0; }
+	float3 GetCandidate(const int x, const int z) const { return gridOrigin + float3(x * spacing, 0, z * spacing); }
+};
+
+class LevelSolver {
+public:
+	static constexpr int LampRays = 4;
+
+	// the origin of ray i from a lamp to the light, the same rays PuzzleScene uses to decide if a lamp is found
+	static float3 GetLampRayOrigin(const float3& lampPosition, const int i);
+	// world position of a lamp in the world it was built into
+	static float3 GetLampPosition(const VoxelWorld& world, const int3& voxel);
+
+	// tests every candidate against every lamp, one lamp at a time over all candidates in parallel. candidates a lamp
+	// rules out aren't traced for the lamps after it, so most unsolvable levels are rejected after a lamp or two.
+	// the world is only read, it has to be built from the level
+	static LevelSolution Solve(const PuzzleLevel& level, const VoxelWorld& world, const float lightHeight, const int samplesPerVoxel = 2);
+};
@@ -1,5 +1,10 @@
 #pragma once
 
+// resolution of the per-material lookup tables
+#define REFLECTANCE_LUT_SIZE 256		// cos(theta) in [-1, 1]
+#define TRANSMISSION_LUT_SIZE 128		// distance in [0, TRANSMISSION_LUT_RANGE]
+#define TRANSMISSION_LUT_RANGE 4.0f
+
 class Material {
 public:
 	Material() = default;
@@ -22,6 +27,13 @@ public:
 	bool hasTexture = false;          // True if the material has a texture
 	bool combineTexture = false;      // True if the texture should be combined with the base color
 	std::shared_ptr<FLoatSurface> texture = nullptr; // Texture data
+	std::string texturePath;          // File the texture was loaded from, empty without a texture
+
+	// Precomputed tables so the shading stage does not need transcendental math per hit.
+	// Rebuild them with BakeLUT() whenever one of the properties above changes.
+	bool lutBaked = false;
+	float reflectanceLUT[REFLECTANCE_LUT_SIZE];
+	float3 transmissionLUT[TRANSMISSION_LUT_SIZE];
 
 	//GetEmission: Returns the emission color and intensity of the material
 	float3 GetEmission() const {
@@ -41,7 +53,8 @@ public:
 	}
 
 	// Returns an estimated reflectivity value based on roughness and metallic properties.
-	float GetReflectivity(const float3& viewDir, const float3& normal) const {
+	// This is the reference implementation the LUT is baked from, use GetReflectivity when shading.
+	float ComputeReflectivity(const float3& viewDir, const float3& normal) const {
 		// Calculate half-way vector and normalize
 		float3 halfDir = normalize(viewDir + reflect(viewDir, normal));
 
@@ -70,6 +83,57 @@ public:
 		return clamp(result, 0.0f, 1.0f);
 	}
 
+	// Reflectivity only depends on the angle between the view direction and the normal,
+	// so we look it up by cos(theta) instead of evaluating the GGX terms per hit.
+	float GetReflectivity(const float3& viewDir, const float3& normal) const {
+		if (!lutBaked) return ComputeReflectivity(viewDir, normal);
+		return GetReflectivity(dot(viewDir, normal));
+	}
+
+	float GetReflectivity(const float cosTheta) const {
+		const int index = static_cast<int>((cosTheta * 0.5f + 0.5f) * (REFLECTANCE_LUT_SIZE - 1) + 0.5f);
+		return reflectanceLUT[clamp(index, 0, REFLECTANCE_LUT_SIZE - 1)];
+	}
+
+	// Looks up the reflectivity for 8 hits with the same material at once
+	__m256 GetReflectivity8(const __m256 cosTheta) const {
+		const __m256 half = _mm256_set1_ps(0.5f);
+		const __m256 scale = _mm256_set1_ps(static_cast<float>(REFLECTANCE_LUT_SIZE - 1));
+		__m256 position = _mm256_fmadd_ps(_mm256_fmadd_ps(cosTheta, half, half), scale, half);
+		position = _mm256_min_ps(_mm256_max_ps(position, _mm256_setzero_ps()), scale);
+		const __m256i index = _mm256_cvttps_epi32(position);
+		return _mm256_i32gather_ps(reflectanceLUT, index, 4);
+	}
+
+	// Looks up the reflectivity for 8 hits with (possibly) different materials
+	static __m256 GetReflectivity8(const Material* const materials[8], const __m256 cosTheta) {
+		ALIGN(32) float cosines[8];
+		ALIGN(32) float result[8];
+		_mm256_store_ps(cosines, cosTheta);
+		for (int i = 0; i < 8; i++) {
+			result[i] = materials[i]->GetReflectivity(cosines[i]);
+		}
+		return _mm256_load_ps(result);
+	}
+
+	// Fills the lookup tables from the current material properties
+	Material& BakeLUT() {
+		const float3 normal = float3(0, 1, 0);
+		for (int i = 0; i < REFLECTANCE_LUT_SIZE; i++) {
+			const float cosTheta = (static_cast<float>(i) / (REFLECTANCE_LUT_SIZE - 1)) * 2.0f - 1.0f;
+			const float sinTheta = sqrtf(max(0.0f, 1.0f - cosTheta * cosTheta));
+			const float reflectivity = ComputeReflectivity(float3(sinTheta, cosTheta, 0), normal);
+			reflectanceLUT[i] = isfinite(reflectivity) ? reflectivity : 0.0f;
+		}
+
+		for (int i = 0; i < TRANSMISSION_LUT_SIZE; i++) {
+			const float distance = (static_cast<float>(i) / (TRANSMISSION_LUT_SIZE - 1)) * TRANSMISSION_LUT_RANGE;
+			transmissionLUT[i] = expf(-absorptionCoefficient * distance);
+		}
+		lutBaked = true;
+		return *this;
+	}
+
 	// Returns an estimated refractivity value based on the index of refraction and transparency.
 	float GetRefractivity() const {
 		float refactivity = ior;
@@ -85,8 +149,15 @@ public:
 			return float3(0.0f); // Opaque material, no transmission
 		}
 
-		// Beer-Lambert Law for light attenuation through the material (expf is expensive)
-		float3 attenuation = expf(-absorptionCoefficient * distance);
+		// Beer-Lambert Law for light attenuation through the material (expf is expensive, so use the LUT when we can)
+		float3 attenuation;
+		if (lutBaked && distance >= 0.0f && distance < TRANSMISSION_LUT_RANGE) {
+			const float position = distance * ((TRANSMISSION_LUT_SIZE - 1) / TRANSMISSION_LUT_RANGE);
+			const int index = min(static_cast<int>(position), TRANSMISSION_LUT_SIZE - 2);
+			attenuation = lerp(transmissionLUT[index], transmissionLUT[index + 1], position - index);
+		} else {
+			attenuation = expf(-absorptionCoefficient * distance);
+		}
 
 		// Apply transparency and attenuation to the incident light
 		float3 transmittedColor = incidentColor * attenuation * transparency;
@@ -118,41 +189,34 @@ public:
 		if (hasTexture) {
 			modified |= ImGui::Checkbox(combineTextureLabel.c_str(), &combineTexture);
 
-			//Read all the .png files in the assets folder and store them in a vector
-			std::vector<std::string> hdrFiles;
-			for (const auto& entry : std::filesystem::directory_iterator("assets")) {
-				if (entry.path().extension() == ".png") {
-					hdrFiles.push_back(entry.path().filename().string());
-				}
-			}
+			// the .png files in the assets folder
+			std::shared_ptr<const AssetList> hdrFiles = AssetCatalog::GetInstance().GetList("assets", ".png");
 
 			// Dropdown for selecting .png file
 			static int selectedItem = -1; // Index of the selected item in the combo box
+			if (selectedItem >= static_cast<int>(hdrFiles->names.size())) selectedItem = -1;
 			std::string label = "Files##" + std::to_string(ImGuiIndex);
-			if (!hdrFiles.empty()) {
-				std::vector<const char*> cStrHdrFiles; // ImGui needs const char* array
-				for (const auto& file : hdrFiles) {
-					cStrHdrFiles.push_back(file.c_str());
-				}
-
-				ImGui::Combo(label.c_str(), &selectedItem, &cStrHdrFiles[0], static_cast<int>(cStrHdrFiles.size()));
+			if (!hdrFiles->IsEmpty()) {
+				ImGui::Combo(label.c_str(), &selectedItem, hdrFiles->items.data(), static_cast<int>(hdrFiles->items.size()));
 			}
 
 			std::string loadLabel = "Load File##" + std::to_string(ImGuiIndex);
 			if (ImGui::Button(loadLabel.c_str()) && selectedItem >= 0) {
 				// Load the selected .png file
-				std::string path = "assets/" + hdrFiles[selectedItem];
+				std::string path = hdrFiles->GetPath(selectedItem);
 				if (texture == nullptr) {
 					texture = std::make_unique<FLoatSurface>();
 				} else {
 					if (texture->ownBuffer) FREE64(texture->pixels);
 				}
 				texture->LoadFromFile(path.c_str());
+				texturePath = path;
 				//print the size of the pixels buffer
 				std::cout << "Size of the pixels buffer: " << texture->width << "x" << texture->height << std::endl;
 				modified = true;
 			}
 		}
+		if (modified) BakeLUT();
 		return modified;
 	}
 
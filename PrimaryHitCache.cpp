@@ -0,0 +1,170 @@
+#include "precomp.h"
+
+bool PrimaryHitCache::BeginFrame(const Camera& camera, const Scene& scene) {
+	const std::vector<VoxelWorld*>& active = scene.worlds.GetActive();
+	const std::vector<int>& slots = scene.worlds.GetActiveSlots();
+	for (const VoxelWorld* world : active) {
+		if (world->streamer || world->pager) {
+			Invalidate();
+			return false;
+		}
+	}
+
+	if (hits.empty()) {
+		hits.resize(SCRWIDTH * SCRHEIGHT);
+		valid.assign(SCRWIDTH * SCRHEIGHT, 0);
+	}
+	bool all = !enabled || !SameView(camera);
+	StoreView(camera);
+	enabled = true;
+
+	// worlds that moved, resized, swapped their bricks, appeared or went away cover their old and their new bounds.
+	// a disabled world isn't traversed, so it keeps the invalid handle of an empty slot and toggling it counts as
+	// going away or appearing
+	std::vector<WorldState> states(worldStates.size());
+	for (size_t i = 0; i < active.size(); i++) {
+		const int slot = slots[i];
+		if (slot >= static_cast<int>(states.size())) states.resize(slot + 1);
+		if (active[i]->IsActive()) states[slot] = GetWorldState(scene, slot);
+	}
+	worldStates.resize(states.size());
+	for (size_t slot = 0; slot < states.size() && !all; slot++) {
+		const WorldState& before = worldStates[slot];
+		const WorldState& now = states[slot];
+		if (SameWorld(before, now)) continue;
+		if (before.handle.slot >= 0) all |= !InvalidateBounds(before.boundsMin, before.boundsMax);
+		if (now.handle.slot >= 0) all |= !InvalidateBounds(now.boundsMin, now.boundsMax);
+	}
+	worldStates.swap(states);
+
+	// edited and removed bricks, with thousands of them (a cellular automaton step) it's cheaper to start over
+	const std::vector<BrickChange>& changes = scene.GetChanges();
+	if (changes.size() > 4096) all = true;
+	for (size_t i = 0; i < changes.size() && !all; i++) {
+		const BrickChange& change = changes[i];
+		// instances that share the brick each report it with their own bounds
+		all |= !InvalidateBounds(change.boundsMin, change.boundsMax);
+	}
+	if (all) memset(valid.data(), 0, valid.size());
+
+	int reused = 0;
+	for (const uint8_t v : valid) reused += v;
+	hitRate = static_cast<float>(reused) / static_cast<float>(SCRWIDTH * SCRHEIGHT);
+	return true;
+}
+
+void PrimaryHitCache::Invalidate() {
+	if (!enabled) return;
+	enabled = false;
+	hitRate = 0.0f;
+	memset(valid.data(), 0, valid.size());
+	worldStates.clear();
+}
+
+void PrimaryHitCache::FindNearest(const Scene& scene, Ray& ray, const int pixel) {
+	Hit& hit = hits[pixel];
+	if (valid[pixel]) {
+		ray.t = hit.t;
+		ray.steps = hit.steps;
+		ray.worldIndex = hit.worldIndex;
+		// a miss leaves the rest of the ray alone, like VoxelWorld::FindNearest does
+		if (hit.voxel == 0) return;
+		ray.voxel = hit.voxel;
+		ray.index = hit.index;
+		ray.localVoxel = make_int3(hit.localVoxel[0], hit.localVoxel[1], hit.localVoxel[2]);
+		ray.Dsign = hit.Dsign;
+		ray.entryAxis = hit.entryAxis;
+		ray.entrySign = hit.entrySign;
+		const VoxelWorld* world = scene.worlds[ray.worldIndex];
+		ray.worldTransform = world->transform;
+		ray.invWorldTransform = world->invTransform;
+		return;
+	}
+
+	scene.FindNearest(ray);
+	hit.t = ray.t;
+	hit.voxel = ray.voxel;
+	hit.index = ray.index;
+	hit.steps = ray.steps;
+	hit.worldIndex = ray.worldIndex;
+	hit.localVoxel[0] = ray.localVoxel.x, hit.localVoxel[1] = ray.localVoxel.y, hit.localVoxel[2] = ray.localVoxel.z;
+	hit.Dsign = ray.Dsign;
+	hit.entryAxis = static_cast<int8_t>(ray.entryAxis);
+	hit.entrySign = static_cast<int8_t>(ray.entrySign);
+	valid[pixel] = 1;
+}
+
+bool PrimaryHitCache::SameView(const Camera& camera) const {
+	return camera.camPos == camPos && camera.topLeft == topLeft && camera.topRight == topRight && camera.bottomLeft == bottomLeft
+		&& camera.paniniEffect == paniniEffect && camera.paniniDistance == paniniDistance && camera.paniniSqueeze == paniniSqueeze;
+}
+
+void PrimaryHitCache::StoreView(const Camera& camera) {
+	camPos = camera.camPos;
+	topLeft = camera.topLeft;
+	topRight = camera.topRight;
+	bottomLeft = camera.bottomLeft;
+	paniniEffect = camera.paniniEffect;
+	paniniDistance = camera.paniniDistance;
+	paniniSqueeze = camera.paniniSqueeze;
+}
+
+PrimaryHitCache::WorldState PrimaryHitCache::GetWorldState(const Scene& scene, const int slot) const {
+	const VoxelWorld* world = scene.worlds[slot];
+	WorldState state;
+	state.handle = scene.worlds.GetHandle(slot);
+	state.store = world->store;
+	state.transform = world->transform;
+	state.gridDimensions = world->gridDimensions;
+
+	// the same corners as the bricks in VoxelWorld::CollectChanges
+	const float3 size = float3(world->gridDimensions * BRICKSIZE) * VOXELSIZE;
+	state.boundsMin = float3(1e34f);
+	state.boundsMax = float3(-1e34f);
+	for (int corner = 0; corner < 8; corner++) {
+		const float3 p = world->transform.TransformPoint(float3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1) * size);
+		state.boundsMin = fminf(state.boundsMin, p);
+		state.boundsMax = fmaxf(state.boundsMax, p);
+	}
+	return state;
+}
+
+bool PrimaryHitCache::SameWorld(const WorldState& a, const WorldState& b) const {
+	// an expired weak_ptr keeps its control block, so a store allocated since can't share it
+	const bool sameStore = !a.store.owner_before(b.store) && !b.store.owner_before(a.store);
+	return a.handle == b.handle && sameStore && a.gridDimensions == b.gridDimensions
+		&& memcmp(a.transform.cell, b.transform.cell, sizeof(a.transform.cell)) == 0;
+}
+
+bool PrimaryHitCache::InvalidateBounds(const float3& boundsMin, const float3& boundsMax) {
+	// the screen rectangle is for the pinhole camera of Camera::GetNoEffectPrimaryRay
+	if (paniniEffect) return false;
+	const float3 right = topRight - topLeft;
+	const float3 down = bottomLeft - topLeft;
+	float3 ahead = cross(right, down);
+	if (dot(topLeft - camPos, ahead) < 0) ahead = -ahead;
+	const float planeDistance = dot(topLeft - camPos, ahead);
+
+	float2 screenMin = float2(1e34f), screenMax = float2(-1e34f);
+	for (int corner = 0; corner < 8; corner++) {
+		const float3 p = float3(corner & 1 ? boundsMax.x : boundsMin.x, corner & 2 ? boundsMax.y : boundsMin.y, corner & 4 ? boundsMax.z : boundsMin.z);
+		const float3 toCorner = p - camPos;
+		const float distance = dot(toCorner, ahead);
+		// a corner behind or beside the camera doesn't project, the box could cover any part of the screen
+		if (distance < planeDistance * 1e-3f) return false;
+		const float3 onPlane = camPos + toCorner * (planeDistance / distance) - topLeft;
+		const float2 pixel = float2(dot(onPlane, right) / dot(right, right) * SCRWIDTH, dot(onPlane, down) / dot(down, down) * SCRHEIGHT);
+		screenMin = fminf(screenMin, pixel);
+		screenMax = fmaxf(screenMax, pixel);
+	}
+
+	// a pixel more on every side for rays that graze the edge of the box
+	const int x0 = max(static_cast<int>(floorf(clamp(screenMin.x, -2.0f, static_cast<float>(SCRWIDTH)))) - 1, 0);
+	const int y0 = max(static_cast<int>(floorf(clamp(screenMin.y, -2.0f, static_cast<float>(SCRHEIGHT)))) - 1, 0);
+	const int x1 = min(static_cast<int>(ceilf(clamp(screenMax.x, -2.0f, static_cast<float>(SCRWIDTH)))) + 1, SCRWIDTH - 1);
+	const int y1 = min(static_cast<int>(ceilf(clamp(screenMax.y, -2.0f, static_cast<float>(SCRHEIGHT)))) + 1, SCRHEIGHT - 1);
+	for (int y = y0; y <= y1; y++) {
+		if (x0 <= x1) memset(&valid[x0 + y * SCRWIDTH], 0, x1 - x0 + 1);
+	}
+	return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+namespace Tmpl8 {
+	class Scene;
+	class VoxelWorld;
+
+	// keeps the primary hit of every pixel across frames. while the camera stands still a pixel keeps its hit until
+	// an edited brick or a world that moved, appeared or went away covers it on screen, so accumulation frames only
+	// trace their secondary rays. only for primary rays that come out the same every frame, so no jitter, anti
+	// aliasing or depth of field
+	class PrimaryHitCache {
+	public:
+		// call once per frame after Scene::FlushChanges and before tracing, drops the hits the changes made stale.
+		// false when the cache can't be used this frame, streamed and paged worlds need the traversal of every
+		// primary ray to keep the bricks in view loaded
+		bool BeginFrame(const Camera& camera, const Scene& scene);
+		void Invalidate();
+		// the nearest hit of the primary ray of pixel, restored from the cache or traced with the scene and stored.
+		// pixels are only ever touched by their own thread, so this can be called from the parallel render loop
+		void FindNearest(const Scene& scene, Ray& ray, const int pixel);
+
+		// share of the pixels whose hit was reused this frame, 0 while the cache isn't used
+		float GetHitRate() const { return hitRate; }
+		bool IsEnabled() const { return enabled; }
+
+	private:
+		// the part of a ray that Scene::FindNearest fills in, the transforms come from the world on restore
+		struct Hit {
+			float t;
+			uint voxel;
+			int index;
+			int steps;
+			int worldIndex;
+			int localVoxel[3];
+			float3 Dsign;
+			int8_t entryAxis;
+			int8_t entrySign;
+		};
+
+		// what the cached hits of a world depend on besides its bricks. worlds and stores are told apart by handle and
+		// control block, not by address, so a new one that lands where an old one was still counts as a change
+		struct WorldState {
+			WorldHandle handle;
+			std::weak_ptr<const BrickStore> store;
+			mat4 transform;
+			int3 gridDimensions = int3(0);
+			float3 boundsMin = float3(0), boundsMax = float3(0);
+		};
+
+		bool SameView(const Camera& camera) const;
+		void StoreView(const Camera& camera);
+		WorldState GetWorldState(const Scene& scene, const int slot) const;
+		bool SameWorld(const WorldState& a, const WorldState& b) const;
+		// drops the pixels the world space box can cover, false if that can't be bounded and everything has to go
+		bool InvalidateBounds(const float3& boundsMin, const float3& boundsMax);
+
+		std::vector<Hit> hits;
+		std::vector<uint8_t> valid;
+		std::vector<WorldState> worldStates;	// by slot, the handle is invalid for empty and inactive slots
+
+		// the camera the hits were traced with
+		float3 camPos = float3(0), topLeft = float3(0), topRight = float3(0), bottomLeft = float3(0);
+		bool paniniEffect = false;
+		float paniniDistance = 0.0f, paniniSqueeze = 0.0f;
+
+		bool enabled = false;
+		float hitRate = 0.0f;
+	};
+}
@@ -13,61 +13,99 @@ PuzzleLevel::PuzzleLevel(const std::string levelPath) {
 PuzzleLevel::~PuzzleLevel() {
 }
 
-void PuzzleLevel::DrawLevel(Scene scene, const int3) {
-	for (int i = 0; i < Voxels.size(); i++) {
-		Voxel voxel = Voxels[i];
-		scene.Set(voxel.position.x, voxel.position.y, voxel.position.z, voxel.color, voxel.materialIndex, 0);
+static std::vector<VoxelEdit> GetEdits(const std::vector<Voxel>& voxels) {
+	std::vector<VoxelEdit> edits;
+	edits.reserve(voxels.size());
+	for (int i = 0; i < voxels.size(); i++) {
+		const Voxel& voxel = voxels[i];
+		edits.push_back({ uint(voxel.position.x), uint(voxel.position.y), uint(voxel.position.z), (voxel.materialIndex << 24) | voxel.color });
 	}
+	return edits;
 }
-void PuzzleLevel::LoadLevel(const std::string levelPath) {
-	// Open file
-	FILE* file = fopen(levelPath.c_str(), "rb");
-	if (!file) {
-		printf("Failed to open file with name: %s\n", levelPath.c_str());
-		return; // Failed to open file
-	}
 
-	// Determine file size
-	fseek(file, 0, SEEK_END);
-	long fileSize = ftell(file);
-	if (fileSize <= 0) {
-		fclose(file);
-		printf("File is empty or error in ftell\n");
-		return; // File is empty or error in ftell
+void PuzzleLevel::DrawLevel(Scene& scene, const int3) {
+	std::vector<VoxelEdit> edits = GetEdits(Voxels);
+	scene.SetVoxels(edits, 0);
+}
+
+VoxelWorld* PuzzleLevel::BuildWorld() const {
+	int3 gridSize;
+	gridSize.x = (Size.x + BRICKSIZE - 1) / BRICKSIZE;
+	gridSize.y = (Size.y + BRICKSIZE - 1) / BRICKSIZE;
+	gridSize.z = (Size.z + BRICKSIZE - 1) / BRICKSIZE;
+
+	VoxelWorld* world = new VoxelWorld(gridSize);
+	std::vector<VoxelEdit> edits = GetEdits(Voxels);
+	world->SetVoxels(edits);
+	return world;
+}
+std::shared_ptr<PuzzleLevel> PuzzleLevel::Generate(const PuzzleLevel& base, const uint seed) {
+	std::shared_ptr<PuzzleLevel> level = std::make_shared<PuzzleLevel>();
+	level->Size = base.Size;
+	level->Voxels = base.Voxels;
+	level->Lamps = base.Lamps;
+
+	uint state = InitSeed(seed);
+	//level size without the border
+	const int3 size = base.Size - int3(2);
+	if (size.x <= 0 || size.y <= 0 || size.z <= 0) return level;
+
+	const int lampCount = 5;
+	const int antiLampCount = 5;
+	for (int i = 0; i < lampCount + antiLampCount; i++) {
+		const bool anti = i >= lampCount;
+		const int3 position = int3(RandomUInt(state) % size.x, 0, RandomUInt(state) % size.z) + int3(1);
+		Voxel voxel{ position, anti ? 1u : 0xffffffu, 0, anti ? ANTI_LAMP_INDEX : LAMP_INDEX };
+		Lamp lamp;
+		lamp.voxel = voxel;
+		lamp.requiredRays = anti ? 0 : 4;
+		level->Lamps.push_back(lamp);
+		level->Voxels.push_back(voxel);
 	}
-	fseek(file, 0, SEEK_SET);
-
-	// Allocate buffer based on file size
-	uint8_t* buffer = (uint8_t*)MALLOC64(fileSize);
-	if (!buffer) {
-		fclose(file);
-		printf("Memory allocation failed\n");
-		return; // Memory allocation failed
+
+	//random walls, a wall that would cover a lamp is left out
+	const int wallCount = 30;
+	const int wallSize = 2;
+	for (int i = 0; i < wallCount; i++) {
+		const int3 position = int3(RandomUInt(state) % size.x, 0, RandomUInt(state) % size.z) + int3(1);
+		const int3 end = min(position + int3(wallSize, 0, wallSize), int3(size.x + 1, 0, size.z + 1));
+		const bool coversLamp = std::any_of(level->Lamps.begin(), level->Lamps.end(), [&](const Lamp& lamp) {
+			const int3& p = lamp.voxel.position;
+			return p.x >= position.x && p.x < end.x && p.z >= position.z && p.z < end.z;
+		});
+		if (coversLamp) continue;
+
+		for (int x = position.x; x < end.x; x++) {
+			for (int z = position.z; z < end.z; z++) {
+				for (int y = 1; y <= size.y; y++) {
+					level->Voxels.push_back(Voxel{ int3(x, y, z), 255, 0, 0 });
+				}
+			}
+		}
 	}
+	return level;
+}
 
-	// Read file into buffer
-	size_t bytesRead = fread(buffer, 1, fileSize, file);
-	if (bytesRead != fileSize) {
-		// Error reading file or file read partially
-		FREE64(buffer);
-		fclose(file);
-		printf("Error reading file or file read partially\n");
+void PuzzleLevel::LoadLevel(const std::string levelPath) {
+	Path = levelPath;
+	// preloaded levels come from memory, the others are read now
+	std::vector<uint8_t> buffer;
+	if (!AssetCatalog::GetInstance().ReadFile(levelPath, buffer)) {
+		printf("Failed to read file with name: %s\n", levelPath.c_str());
 		return;
 	}
 
-	// Close the file as it's no longer needed
-	fclose(file);
-
 	// Read VOX scene from buffer
-	const ogt_vox_scene* voxelScene = ogt_vox_read_scene(buffer, fileSize);
-	const ogt_vox_matl_array* palette = &voxelScene->materials;
-	FREE64(buffer); // Free buffer immediately after use
+	const ogt_vox_scene* voxelScene = ogt_vox_read_scene(buffer.data(), static_cast<uint32_t>(buffer.size()));
 
 	if (!voxelScene) {
 		printf("Failed to read VOX scene\n");
 		return; // Failed to read VOX scene
 	}
 
+	uint palette[256];
+	BuildVoxPalette(voxelScene, palette);
+
 	for (uint32_t i = 0; i < voxelScene->num_models; i++) {
 		const ogt_vox_model* model = voxelScene->models[i];
 		const ogt_vox_instance instance = voxelScene->instances[i];
@@ -87,30 +125,9 @@ void PuzzleLevel::LoadLevel(const std::string levelPath) {
 					uint8_t colorIndex = model->voxel_data[x + y * sizeX + z * sizeX * sizeY];
 					if (colorIndex != 0) {
 
-						//get the material of the voxel from the voxel scene
-						ogt_vox_rgba voxColor = voxelScene->palette.color[colorIndex];
-						//convert the color to a RGB uint format
-						uint color = (voxColor.r << 16) | (voxColor.g << 8) | voxColor.b;
-
-						ogt_vox_matl matl = palette->matl[colorIndex];
-
-						int materialIndex = static_cast<int>(MaterialList.size());
-						Material newMaterial = Material(materialIndex, matl.rough, matl.metal, matl.trans, matl.ior);
-
-						//check if the material already exists
-						for (int m = 0;m < MaterialList.size(); m++) {
-							if (newMaterial == MaterialList[m]) {
-								materialIndex = m;
-								break;
-							}
-						}
-						//if the material does not exist, add it to the list
-						if (materialIndex == MaterialList.size()) {
-							MaterialList.push_back(newMaterial);
-						}
-
-						//store the material index in the first 8 bits of the color
-						color |= (materialIndex << 24);
+						//color and material index come from the palette table, with the material index in the first 8 bits
+						uint color = palette[colorIndex];
+						int materialIndex = static_cast<int>(color >> 24);
 
 						// Adjusted positions for different coordinate system
 						int adjustedX = x + newOffset.x;
@@ -5,6 +5,7 @@
 //forward declaration
 namespace Tmpl8 {
 	class Scene;
+	class VoxelWorld;
 }
 
 struct Voxel {
@@ -26,11 +27,17 @@ public:
 	PuzzleLevel(const std::string levelPath);
 	~PuzzleLevel();
 
-	void DrawLevel(Scene scene, const int3 position);
+	void DrawLevel(Scene& scene, const int3 position);
+	// a world the size of the level with its voxels set. it isn't part of a scene yet, so this can run on any thread
+	VoxelWorld* BuildWorld() const;
+	// base with random lamps, anti lamps and walls inside its border. the same seed gives the same level, and nothing
+	// global is touched, so levels can be generated on any thread
+	static std::shared_ptr<PuzzleLevel> Generate(const PuzzleLevel& base, const uint seed);
 	void LoadLevel(const std::string levelPath);
 
 	std::vector<Lamp> Lamps;
 	std::vector<Voxel> Voxels;
 	int3 Size;
+	std::string Path; // empty for generated levels
 };
 
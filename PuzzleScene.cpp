@@ -35,14 +35,17 @@ void PuzzleScene::Update(float deltaTime) {
 	HandleMouse(deltaTime);
 	HandleLamps(deltaTime);
 
+	// the generator searches on its own thread, a level is loaded as soon as it found one
 	if (findRandomLevel) {
-		for (int i = 0; i < 100; i++) {
-			if (GenerateRandomLevel()) {
-				findRandomLevel = false;
-				break;
-			}
+		LevelGenerator::Result result;
+		if (levelGenerator.Take(result)) {
+			LoadRandomLevel(result);
+			findRandomLevel = false;
+		} else if (levelGenerator.GetStats().wanted == 0) {
+			levelGenerator.Start(GetEmptyLevel(), seed, 1, GetLightHeight());
 		}
 	}
+	if (showLightRegion && isRandomLevel) DrawLightRegion();
 
 	if (playAnimation) {
 		if (isRandomLevel) return;
@@ -106,36 +109,39 @@ void PuzzleScene::HandleMouse(const float deltaTime) {
 void PuzzleScene::HandleLamps(const float deltaTime) {
 	if (currentLevel == nullptr || playAnimation || !animationFinished) return;
 	const float3 lightPos = renderer->pointLight->position;
-	const float halfVoxelSize = VOXELSIZE / 2.0f;
-	std::vector<float3> rayOffsets = {
-		float3(halfVoxelSize, halfVoxelSize, halfVoxelSize),
-		float3(-halfVoxelSize, halfVoxelSize, halfVoxelSize),
-		float3(-halfVoxelSize, halfVoxelSize, -halfVoxelSize),
-		float3(halfVoxelSize, halfVoxelSize, -halfVoxelSize)
-	};
 
+	// the rays of all lamps go in one batch, the same rays the level solver traces
+	lampRays.Clear();
+	for (const auto& lamp : currentLevel->Lamps) {
+		const float3 lampPosition = LevelSolver::GetLampPosition(*renderer->scene.worlds[0], lamp.voxel.position);
+		for (int i = 0; i < LevelSolver::LampRays; i++) {
+			float3 rayOrigin = LevelSolver::GetLampRayOrigin(lampPosition, i);
+			lampRays.Add(rayOrigin, normalize(lightPos - rayOrigin), length(lightPos - rayOrigin));
+		}
+	}
+	renderer->scene.TraceBatch(lampRays, RayQueryAnyHit);
+
+	// where the blocked rays are blocked is only needed for the debug lines
+	blockedLampRays.Clear();
+	if (renderer->settings.DebugLines) {
+		for (int i = 0; i < lampRays.Size(); i++) {
+			if (lampRays.hit[i]) blockedLampRays.Add(lampRays.GetOrigin(i), lampRays.GetDirection(i), lampRays.tMax[i]);
+		}
+		renderer->scene.TraceBatch(blockedLampRays, RayQueryClosest);
+	}
+
+	int rayIndex = 0, blockedIndex = 0;
 	for (auto& lamp : currentLevel->Lamps) {
-		float3 lampPosition = (lamp.voxel.position + float3(0.5f)) / WORLDSIZE;
-		lampPosition = renderer->scene.worlds[0]->transform.TransformPoint(lampPosition);
+		const float3 lampPosition = LevelSolver::GetLampPosition(*renderer->scene.worlds[0], lamp.voxel.position);
 		int count = 0;
-		for (const auto& offset : rayOffsets) {
-			float3 rayOrigin = lampPosition + offset + float3(0, EPSILON, 0);
-			float3 rayDirection = normalize(lightPos - rayOrigin);
-			float distance = length(lightPos - rayOrigin);
-			Ray ray(rayOrigin, rayDirection, distance);
-
-			bool result = !renderer->scene.IsOccluded(ray);
-			if (result) {
+		for (int i = 0; i < LevelSolver::LampRays; i++, rayIndex++) {
+			const float3 rayOrigin = lampRays.GetOrigin(rayIndex);
+			if (!lampRays.hit[rayIndex]) {
 				count++;
-			}
-
-			if (result) {
 				//draw a line from the lamp into the ray direction
-				renderer->DrawLine(rayOrigin, rayOrigin + rayDirection * distance, float3(0, 1, 0));
-			} else {
-				renderer->scene.FindNearest(ray);
-				float3 hitPos = ray.IntersectionPoint();
-				renderer->DrawLine(rayOrigin, hitPos, float3(1, 0, 0));
+				renderer->DrawLine(rayOrigin, rayOrigin + lampRays.GetDirection(rayIndex) * lampRays.tMax[rayIndex], float3(0, 1, 0));
+			} else if (blockedIndex < blockedLampRays.Size()) {
+				renderer->DrawLine(rayOrigin, blockedLampRays.GetHitPoint(blockedIndex++), float3(1, 0, 0));
 			}
 		}
 
@@ -222,23 +228,23 @@ void PuzzleScene::SetAdvancedRenderer() {
 	renderer->camera.UpdateProjection();
 }
 
-void PuzzleScene::LoadLevel(std::shared_ptr<PuzzleLevel> level) {
+void PuzzleScene::LoadLevel(std::shared_ptr<PuzzleLevel> level, VoxelWorld* prebuilt) {
+	// a preloaded level was built on the level cache's worker, all that is left is swapping it in
+	if (!prebuilt) prebuilt = levelCache.Take(level);
 	renderer->scene.CLearWorlds();
 	currentLevel = level;
-	VoxelWorld* world = new VoxelWorld();
-	renderer->scene.worlds.push_back(world);
-
-	
-
+	isRandomLevel = false;
 	float3 levelSize = currentLevel->Size;
-	int3 worldSIze;
-	worldSIze.x = static_cast<int>(ceil(levelSize.x / BRICKSIZE));
-	worldSIze.y = static_cast<int>(ceil(levelSize.y / BRICKSIZE));
-	worldSIze.z = static_cast<int>(ceil(levelSize.z / BRICKSIZE));
-
-	world->Resize(worldSIze);
 
-	currentLevel->DrawLevel(renderer->scene, int3(0));
+	// levels from disk get a scene file the first time they are built, after that switching to them only maps it
+	const std::string cachePath = currentLevel->Path.empty() ? "" : currentLevel->Path + ".vxs";
+	if (prebuilt) {
+		renderer->scene.worlds.Add(prebuilt);
+	} else if (cachePath.empty() || !SceneFile::IsUpToDate(cachePath, currentLevel->Path) || SceneFile::Load(renderer->scene, cachePath.c_str()) != 1) {
+		renderer->scene.CLearWorlds();
+		renderer->scene.worlds.Add(currentLevel->BuildWorld());
+		if (!cachePath.empty()) SceneFile::Save(renderer->scene, cachePath.c_str());
+	}
 
 	float3 camPos = levelSize / WORLDSIZE / 2.0f;
 	camPos.y = 1.0f;
@@ -249,6 +255,28 @@ void PuzzleScene::LoadLevel(std::shared_ptr<PuzzleLevel> level) {
 	renderer->camera.UpdateProjection();
 
 	renderer->pointLight->position = levelSize / WORLDSIZE / 2.0f;
+
+	PreloadAdjacentLevels();
+}
+
+std::shared_ptr<PuzzleLevel> PuzzleScene::GetNextLevel() const {
+	const auto current = std::find(levels.begin(), levels.end(), currentLevel);
+	if (current == levels.end() || current + 1 == levels.end()) return nullptr;
+	return *(current + 1);
+}
+
+void PuzzleScene::PreloadAdjacentLevels() {
+	// the next level is the one that gets played after this one, the previous one is for going back
+	std::vector<std::shared_ptr<PuzzleLevel>> adjacent;
+	const auto current = std::find(levels.begin(), levels.end(), currentLevel);
+	if (current != levels.end()) {
+		if (current + 1 != levels.end()) adjacent.push_back(*(current + 1));
+		if (current != levels.begin()) adjacent.push_back(*(current - 1));
+	}
+	levelCache.Trim(adjacent);
+	for (const auto& level : adjacent) {
+		levelCache.Preload(level);
+	}
 }
 
 void PuzzleScene::DrawImGUI() {
@@ -262,34 +290,28 @@ void PuzzleScene::DrawImGUI() {
 	}
 
 	if (ImGui::CollapsingHeader("Level Settings")) {
-		// Read all the .vox files in the assets folder and store them in a vector
-		std::vector<std::string> voxFiles;
-		std::string locationPath = "assets/levels/";
-		for (const auto& entry : std::filesystem::directory_iterator(locationPath)) {
-			if (entry.path().extension() == ".vox") {
-				voxFiles.push_back(entry.path().filename().string());
-			}
-		}
+		// the levels, kept up to date by the catalog
+		std::shared_ptr<const AssetList> voxFiles = AssetCatalog::GetInstance().GetList("assets/levels", ".vox");
 
 		// Dropdown for selecting .vox file
 		static int selectedItem = -1; // Index of the selected item in the combo box
-		if (!voxFiles.empty()) {
-			std::vector<const char*> cStrVoxFiles; // ImGui needs const char* array
-			for (const auto& file : voxFiles) {
-				cStrVoxFiles.push_back(file.c_str());
+		if (selectedItem >= static_cast<int>(voxFiles->names.size())) selectedItem = -1;
+		if (!voxFiles->IsEmpty()) {
+			if (ImGui::Combo("Vox Files", &selectedItem, voxFiles->items.data(), static_cast<int>(voxFiles->items.size())) && selectedItem >= 0) {
+				AssetCatalog::GetInstance().Preload(voxFiles->GetPath(selectedItem));
 			}
-
-			ImGui::Combo("Vox Files", &selectedItem, &cStrVoxFiles[0], static_cast<int>(cStrVoxFiles.size()));
 		}
 
 		if (ImGui::Button("Load Vox File") && selectedItem >= 0) {
 			// Load the selected .vox file
-			std::string path = locationPath + voxFiles[selectedItem];
+			std::string path = voxFiles->GetPath(selectedItem);
 			std::shared_ptr<PuzzleLevel> level = std::make_shared<PuzzleLevel>(path);
 			levels.push_back(level);
 			LoadLevel(level);
 		}
 
+		ImGui::Text("Preloaded Levels: %i", levelCache.GetReadyCount());
+
 		//checkbox
 		ImGui::Checkbox("Play Animation", &playAnimation);
 		//animation settings
@@ -304,6 +326,32 @@ void PuzzleScene::DrawImGUI() {
 			GenerateRandomLevel();
 		}
 		ImGui::Checkbox("Find Random Level", &findRandomLevel);
+
+		// solvable levels are searched in the background, from the seed on
+		ImGui::DragInt("Batch Size", &randomLevelBatchSize, 1, 1, 1000);
+		if (ImGui::Button("Generate Solvable Batch")) {
+			levelGenerator.Start(GetEmptyLevel(), seed, randomLevelBatchSize, GetLightHeight());
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Stop")) {
+			levelGenerator.Stop();
+		}
+		const LevelGenerator::Stats stats = levelGenerator.GetStats();
+		if (ImGui::Button("Next Solvable Level")) {
+			LevelGenerator::Result result;
+			if (levelGenerator.Take(result)) LoadRandomLevel(result);
+		}
+		ImGui::Text("Ready Levels: %i (%i to go)", stats.ready, stats.wanted);
+		ImGui::Text("Seeds Tried: %lld (%lld solvable)", stats.seedsTried, stats.seedsSolvable);
+		ImGui::Text("Seeds/s: %.1f", stats.seedsPerSecond);
+		ImGui::Text("Solve Time: %.2f ms", stats.solveTime * 1000.0f);
+
+		if (isRandomLevel) {
+			const LevelSolution& solution = randomLevelSolution;
+			ImGui::Text("Light Region: %i / %i positions", solution.feasibleCount, solution.gridSize.x * solution.gridSize.y);
+			ImGui::Text("Solved In: %.2f ms (%lld rays)", solution.solveTime * 1000.0f, solution.rayCount);
+			ImGui::Checkbox("Show Light Region", &showLightRegion);
+		}
 	}
 
 	if (ImGui::Button("Simple Renderer")) {
@@ -341,6 +389,8 @@ void PuzzleScene::FinishLevelAnimation(const float deltaTime) {
 	float t = animationRadius / maxDistance * 2.0f;
 	t = ApplyEase(t, EASE_OUT_CUBIC);
 	float radius = lerp(0.0f, maxDistance, t);
+	// hold the end of the animation while the next level is still being built, instead of building it here
+	if (radius > maxDistance && levelCache.IsPending(GetNextLevel())) return;
 	animationRadius += radiusSpeed * deltaTime;
 	animationFinished = false;
 	DrawSphere(renderer->scene, make_int3(sphereCenter), radius, 0, 0);
@@ -351,21 +401,14 @@ void PuzzleScene::FinishLevelAnimation(const float deltaTime) {
 		animationRadius = 0.0f;
 
 		//load the next level
-		int currentLevelIndex = -1;
-		for (int i = 0; i < levels.size(); i++) {
-			if (levels[i] == currentLevel) {
-				currentLevelIndex = i;
-				break;
-			}
-		}
-		currentLevelIndex++;
-		if (currentLevelIndex >= levels.size()) {
+		std::shared_ptr<PuzzleLevel> nextLevel = GetNextLevel();
+		if (!nextLevel) {
 			MenuScene* menu = new MenuScene();
 			menu->renderer = renderer;
 			renderer->sceneManager.LoadScene(menu);
 			return;
 		}
-		LoadLevel(levels[currentLevelIndex]);
+		LoadLevel(nextLevel);
 		renderer->scene.worlds[0]->position.z = 0.5f;
 		renderer->scene.worlds[0]->UpdateTransform();
 		/*Tween* tween = new Tween(renderer->scene.worlds[0]->position.x, 0.0f, 1.0f);*/
@@ -399,171 +442,48 @@ void PuzzleScene::FinishLevelAnimation(const float deltaTime) {
 }
 
 bool PuzzleScene::GenerateRandomLevel() {
+	// the level is solved before it is shown, so the light region is known up front
+	LevelGenerator::Result result;
+	result.seed = seed;
+	result.level = PuzzleLevel::Generate(*GetEmptyLevel(), seed);
+	result.world = result.level->BuildWorld();
+	result.solution = LevelSolver::Solve(*result.level, *result.world, GetLightHeight());
+	LoadRandomLevel(result);
+
+	if (result.solution.IsSolvable()) printf("All lamps are visible\n");
+	printf("Seed: %u, %i light positions, solved in %.2f ms\n", result.seed, result.solution.feasibleCount, result.solution.solveTime * 1000.0f);
+	return result.solution.IsSolvable();
+}
 
-	uint startSeed = seed;
-	//set a seed for the random number generator
-	srand(seed);
-
-	std::shared_ptr<PuzzleLevel> emptyLevel = std::make_shared<PuzzleLevel>("Assets/levels/EmptyLevel.vox");
-	LoadLevel(emptyLevel);
+void PuzzleScene::LoadRandomLevel(const LevelGenerator::Result& result) {
+	LoadLevel(result.level, result.world);
 	isRandomLevel = true;
-	//level size without the border
-	int3 size = emptyLevel->Size - int3(2);
-
-	std::vector<Lamp> lamps;
-
-	int lampCount = 5;
-	int antiLampCount = 5;
-
-	for (int i = 0; i < lampCount; i++) {
-		int3 position = int3(rand() % size.x, 0, rand() % size.z);
-		Voxel voxel;
-		voxel.position = position;
-		voxel.color = 0xffffff;
-		voxel.materialIndex = 0;
-		voxel.colorIndex = 0;
-		Lamp lamp;
-		lamp.voxel = voxel;
-		lamp.requiredRays = 4;
-		lamp.isFound = false;
-		lamps.push_back(lamp);
-	}
-
-	for (int i = 0; i < antiLampCount; i++) {
-		int3 position = int3(rand() % size.x, 0, rand() % size.z);
-		Voxel voxel;
-		voxel.position = position;
-		voxel.color = 1;
-		voxel.materialIndex = 0;
-		voxel.colorIndex = 0;
-		Lamp lamp;
-		lamp.voxel = voxel;
-		lamp.requiredRays = 0;
-		lamp.isFound = false;
-		lamps.push_back(lamp);
-	}
-
-	//pick a random lamp position
-	uint seedExtra = seed + 1;
-	float2 pointLightSolutionPosition = float2(RandomFloat(seed) * size.x, RandomFloat(seedExtra) * size.z) / WORLDSIZE;
-	renderer->pointLight->position.x = pointLightSolutionPosition.x;
-	renderer->pointLight->position.z = pointLightSolutionPosition.y;
-
-	//place the lamps and anti lamps
-	for (const auto& lamp : lamps) {
-		uint color = lamp.voxel.color;
-		renderer->scene.worlds[0]->Set(lamp.voxel.position.x + 1, lamp.voxel.position.y + 1, lamp.voxel.position.z + 1, color);
-	}
-
-
-	//generate random walls
-	int wallCount = 30;
-	int wallSize = 2;
-
-	std::vector<int3> wallPositions;
-
-	std::vector<int> wallIndexesToRemove;
-	for (int i = 0; i < wallCount; i++) {
-		int3 position = int3(rand() % size.x, 0, rand() % size.z);
-		for (int x = 0; x < wallSize; x++) {
-			for (int z = 0; z < wallSize; z++) {
-				int3 voxelPosition = position + int3(x, 0, z);
-				//check if the wall is overlapping with a lamp or anti lamp
-				for (const auto& lamp : lamps) {
-					if (lamp.voxel.position == voxelPosition) {
-						wallIndexesToRemove.push_back(i);
-						break;
-					}
-				}
-
-				if (std::find(wallIndexesToRemove.begin(), wallIndexesToRemove.end(), i) != wallIndexesToRemove.end()) {
-					break;
-				}
-
-				wallPositions.push_back(position);
-			}
-		}
-	}
-
-	//place valid walls
-
-	for (const auto& position : wallPositions) {
-		for (int x = 0; x < wallSize; x++) {
-			for (int z = 0; z < wallSize; z++) {
-				for (int y = 0; y < size.y; y++) {
-					int3 voxelPosition = position + int3(x, y, z);
-					renderer->scene.worlds[0]->Set(voxelPosition.x + 1, voxelPosition.y + 1, voxelPosition.z + 1, 255);
-				}
-			}
-		}
-	}
-
-	const float halfVoxelSize = VOXELSIZE / 2.0f;
-	std::vector<float3> rayOffsets = {
-	float3(halfVoxelSize, halfVoxelSize, halfVoxelSize),
-	float3(-halfVoxelSize, halfVoxelSize, halfVoxelSize),
-	float3(-halfVoxelSize, halfVoxelSize, -halfVoxelSize),
-	float3(halfVoxelSize, halfVoxelSize, -halfVoxelSize)
-	};
-	//shoot rays from the lamps and anti lamps to the point light and check if they hit the point light
-	//if they do, remove the lamp or anti lamp
-	int successCount = 0;
-	for (const auto& lamp : lamps) {
-		int3 position = lamp.voxel.position + int3(1);
-		float3 lampPosition = (float3(position) + float3(0.5f)) / WORLDSIZE;
-		lampPosition = renderer->scene.worlds[0]->transform.TransformPoint(lampPosition);
-		int count = 0;
-		for (const auto& offset : rayOffsets) {
-			float3 rayOrigin = lampPosition + offset + float3(0, EPSILON, 0);
-
-			float3 rayDirection = normalize(renderer->pointLight->position - rayOrigin);
-			float distance = length(renderer->pointLight->position - rayOrigin);
-			Ray ray(rayOrigin, rayDirection, distance);
-
-			bool result = !renderer->scene.IsOccluded(ray);
-
-			if (result) {
-				count++;
-				renderer->DrawLine(rayOrigin, rayOrigin + rayDirection * distance, float3(0, 1, 0), true);
-			} else {
-				renderer->scene.FindNearest(ray);
-				float3 hitPos = ray.IntersectionPoint();
-				renderer->DrawLine(rayOrigin, hitPos, float3(1, 0, 0), true);
-			}
-
-			//draw a line from the lamp into the ray direction
-		}
-
-
-		if (count == lamp.requiredRays) {
-			successCount++;
-
-
-		}
+	// the next level is searched from the seed after this one, not this one again
+	seed = result.seed + 1;
+	randomLevelSolution = result.solution;
+}
 
-		std::vector<Line> lines = VisualizeCube(lampPosition, VOXELSIZE, float3(1, 1, 1));
-		if (count == lamp.requiredRays) {
-			for (const auto& line : lines) {
-				renderer->DrawLine(line.start, line.end, float3(0, 1, 0), true);
-			}
-		} else {
-			for (const auto& line : lines) {
-				renderer->DrawLine(line.start, line.end, float3(1, 0, 0), true);
-			}
+void PuzzleScene::DrawLightRegion() {
+	// a cross on every light position that solves the level
+	const LevelSolution& solution = randomLevelSolution;
+	const float size = solution.spacing * 0.4f;
+	const float4 color = float4(0, 1, 0, 1);
+	for (int z = 0; z < solution.gridSize.y; z++) {
+		for (int x = 0; x < solution.gridSize.x; x++) {
+			if (!solution.feasible[x + z * solution.gridSize.x]) continue;
+			const float3 position = solution.GetCandidate(x, z);
+			renderer->DrawLine(position - float3(size, 0, 0), position + float3(size, 0, 0), color, true);
+			renderer->DrawLine(position - float3(0, 0, size), position + float3(0, 0, size), color, true);
 		}
 	}
-
-	if (successCount == lamps.size()) {
-		printf("All lamps are visible\n");
-		printf("Seed: %d\n", startSeed);
-		return true;
-	} else {
-		printf("Seed: %d\n", startSeed);
-		return false;
-	}
 }
 
+std::shared_ptr<const PuzzleLevel> PuzzleScene::GetEmptyLevel() {
+	if (!emptyLevel) emptyLevel = std::make_shared<PuzzleLevel>("Assets/levels/EmptyLevel.vox");
+	return emptyLevel;
+}
 
-//1459420682
-//620932373
-//-2001685688
\ No newline at end of file
+float PuzzleScene::GetLightHeight() const {
+	// HandleMouse only follows clicks on the floor, and lifts the target 6.75 voxels and half a voxel along the normal
+	return VOXELSIZE * (1.0f + 6.75f + 0.5f);
+}
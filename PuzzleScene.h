@@ -21,6 +21,12 @@ private:
 	float fadeSpeed = 3.5f;
 	std::vector <std::shared_ptr<PuzzleLevel>> levels;
 	std::shared_ptr<PuzzleLevel> currentLevel;
+	LevelCache levelCache;
+	LevelGenerator levelGenerator;
+	std::shared_ptr<const PuzzleLevel> emptyLevel;	// random levels are generated inside it
+	LevelSolution randomLevelSolution;
+	RayBatch lampRays;
+	RayBatch blockedLampRays;
 
 	float allLampsFoundTime = 0;
 	float allLampsFoundTimeMax = 1.0f;
@@ -29,6 +35,8 @@ private:
 	bool animationFinished = true;
 	bool isRandomLevel = false;
 	bool findRandomLevel = false;
+	bool showLightRegion = false;
+	int randomLevelBatchSize = 10;
 	float animationRadius = 0.0f;
 	float radiusSpeed = 5.0f;
 	float totalTime;
@@ -42,12 +50,20 @@ private:
 	void SetSimpleRenderer();
 	void SetAdvancedRenderer();
 
-	void LoadLevel(std::shared_ptr<PuzzleLevel> level);
+	// a prebuilt world is used instead of building the level, the scene owns it from here on
+	void LoadLevel(std::shared_ptr<PuzzleLevel> level, VoxelWorld* prebuilt = nullptr);
+	std::shared_ptr<PuzzleLevel> GetNextLevel() const;
+	void PreloadAdjacentLevels();
 
 	void DrawImGUI();
 
 	void FinishLevelAnimation(const float deltaTime);
 
 	bool GenerateRandomLevel();
+	void LoadRandomLevel(const LevelGenerator::Result& result);
+	void DrawLightRegion();
+	std::shared_ptr<const PuzzleLevel> GetEmptyLevel();
+	// the height HandleMouse moves the light to, where the solver looks for light positions
+	float GetLightHeight() const;
 };
 
@@ -0,0 +1,48 @@
+#pragma once
+
+namespace Tmpl8 {
+	enum RayQueryFlags {
+		RayQueryClosest = 0,		// nearest hit with its t, voxel and world
+		RayQueryAnyHit = 1,			// only whether something is hit before tMax, which can stop at the first world that blocks
+		RayQueryAttributes = 2		// closest hits also get their normal and voxel coordinate
+	};
+
+	// rays and their results as structure of arrays, traced together with Scene::TraceBatch. the batch can be kept
+	// and refilled every frame, so the arrays only grow once
+	struct RayBatch {
+		// adds a ray, returns its index in the results
+		int Add(const float3& origin, const float3& direction, const float maxT = 1e34f) {
+			originX.push_back(origin.x), originY.push_back(origin.y), originZ.push_back(origin.z);
+			directionX.push_back(direction.x), directionY.push_back(direction.y), directionZ.push_back(direction.z);
+			tMax.push_back(maxT);
+			return Size() - 1;
+		}
+		void Clear() {
+			originX.clear(), originY.clear(), originZ.clear();
+			directionX.clear(), directionY.clear(), directionZ.clear();
+			tMax.clear();
+		}
+		int Size() const { return static_cast<int>(originX.size()); }
+
+		float3 GetOrigin(const int i) const { return float3(originX[i], originY[i], originZ[i]); }
+		float3 GetDirection(const int i) const { return float3(directionX[i], directionY[i], directionZ[i]); }
+		// only for closest hits
+		float3 GetHitPoint(const int i) const { return GetOrigin(i) + GetDirection(i) * t[i]; }
+		float3 GetNormal(const int i) const { return float3(normalX[i], normalY[i], normalZ[i]); }
+		int3 GetVoxel(const int i) const { return int3(voxelX[i], voxelY[i], voxelZ[i]); }
+
+		// rays
+		std::vector<float> originX, originY, originZ;
+		std::vector<float> directionX, directionY, directionZ;
+		std::vector<float> tMax;
+
+		// results, hit is set for every query, the rest only for closest hits. t is tMax for misses
+		std::vector<uint8_t> hit;
+		std::vector<float> t;
+		std::vector<uint> voxel;
+		std::vector<int> worldIndex;
+		// with RayQueryAttributes
+		std::vector<float> normalX, normalY, normalZ;
+		std::vector<int> voxelX, voxelY, voxelZ;
+	};
+}
@@ -0,0 +1,295 @@
+#include "precomp.h"
+
+namespace {
+	constexpr uint SceneFileMagic = 0x43535856; // "VXSC"
+	constexpr uint SceneFileVersion = 3;
+	constexpr uint64_t PayloadAlignment = 64;
+	constexpr uint64_t BrickBytes = BRICKSIZE3 * sizeof(uint);
+
+	// zero fill up to the next multiple of alignment, so payloads can be used in place
+	bool Pad(FILE* f, uint64_t& offset, const uint64_t alignment) {
+		static const uint8_t zeros[PayloadAlignment] = {};
+		const uint64_t padding = (alignment - offset % alignment) % alignment;
+		offset += padding;
+		return fwrite(zeros, 1, padding, f) == padding;
+	}
+
+	SceneFileMaterial ToFileMaterial(const Material& material, const uint index) {
+		SceneFileMaterial fileMaterial = {};
+		fileMaterial.index = index;
+		fileMaterial.roughness = material.roughness;
+		fileMaterial.metallic = material.metallic;
+		fileMaterial.transparency = material.transparency;
+		fileMaterial.ior = material.ior;
+		fileMaterial.emissionIntensity = material.emissionIntensity;
+		fileMaterial.emissionColor = material.emissionColor;
+		fileMaterial.absorptionCoefficient = material.absorptionCoefficient;
+		memcpy(fileMaterial.reflectanceLUT, material.reflectanceLUT, sizeof(fileMaterial.reflectanceLUT));
+		memcpy(fileMaterial.transmissionLUT, material.transmissionLUT, sizeof(fileMaterial.transmissionLUT));
+		fileMaterial.hasTexture = material.hasTexture;
+		fileMaterial.combineTexture = material.combineTexture;
+		strncpy(fileMaterial.texturePath, material.texturePath.c_str(), sizeof(fileMaterial.texturePath) - 1);
+		return fileMaterial;
+	}
+
+	bool Matches(const Material& material, const SceneFileMaterial& fileMaterial) {
+		return material.roughness == fileMaterial.roughness && material.metallic == fileMaterial.metallic
+			&& material.transparency == fileMaterial.transparency && material.ior == fileMaterial.ior
+			&& material.emissionIntensity == fileMaterial.emissionIntensity && material.emissionColor == fileMaterial.emissionColor
+			&& material.absorptionCoefficient == fileMaterial.absorptionCoefficient && material.hasTexture == (fileMaterial.hasTexture != 0)
+			&& material.combineTexture == (fileMaterial.combineTexture != 0) && material.texturePath == fileMaterial.texturePath;
+	}
+
+	// the tables are stored baked, so they are copied instead of baked again
+	Material FromFileMaterial(const SceneFileMaterial& fileMaterial, const int index) {
+		Material material(index, fileMaterial.roughness, fileMaterial.metallic, fileMaterial.transparency, fileMaterial.ior);
+		material.emissionIntensity = fileMaterial.emissionIntensity;
+		material.emissionColor = fileMaterial.emissionColor;
+		material.absorptionCoefficient = fileMaterial.absorptionCoefficient;
+		memcpy(material.reflectanceLUT, fileMaterial.reflectanceLUT, sizeof(material.reflectanceLUT));
+		memcpy(material.transmissionLUT, fileMaterial.transmissionLUT, sizeof(material.transmissionLUT));
+		material.lutBaked = true;
+		material.hasTexture = fileMaterial.hasTexture != 0;
+		material.combineTexture = fileMaterial.combineTexture != 0;
+		material.texturePath = fileMaterial.texturePath;
+		if (!material.texturePath.empty()) material.texture = std::make_shared<FLoatSurface>(material.texturePath.c_str());
+		return material;
+	}
+}
+
+std::shared_ptr<MappedFile> MappedFile::Open(const char* path) {
+	std::shared_ptr<MappedFile> mapped(new MappedFile());
+	mapped->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	LARGE_INTEGER size;
+	if (mapped->file == INVALID_HANDLE_VALUE || !GetFileSizeEx(mapped->file, &size) || size.QuadPart == 0) return nullptr;
+	mapped->size = size.QuadPart;
+
+	mapped->mapping = CreateFileMappingA(mapped->file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	if (mapped->mapping) mapped->data = static_cast<uint8_t*>(MapViewOfFile(mapped->mapping, FILE_MAP_COPY, 0, 0, 0));
+	if (!mapped->data) return nullptr;
+	return mapped;
+}
+
+MappedFile::~MappedFile() {
+	if (data) UnmapViewOfFile(data);
+	if (mapping) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+}
+
+bool SceneFile::Save(const Scene& scene, const char* path) {
+	// in slot order, so the worlds come back in the same slots when loaded into an empty scene
+	std::vector<const VoxelWorld*> worlds;
+	for (int i = 0; i < scene.worlds.GetSlotCount(); i++) {
+		if (scene.worlds[i]) worlds.push_back(scene.worlds[i]);
+	}
+	return Save(worlds, path);
+}
+
+bool SceneFile::Save(const std::vector<const VoxelWorld*>& worlds, const char* path) {
+	// only the resident bricks of streamed and paged worlds are in memory, saving them would silently drop the rest
+	for (const VoxelWorld* world : worlds) {
+		if (world->streamer || world->pager) return false;
+	}
+
+	// instances are stored as a reference to the first world with the same bricks
+	std::vector<int> sourceWorlds(worlds.size(), -1);
+	for (size_t w = 0; w < worlds.size(); w++) {
+		for (size_t source = 0; source < w; source++) {
+			if (sourceWorlds[source] == -1 && worlds[source]->store == worlds[w]->store) {
+				sourceWorlds[w] = static_cast<int>(source);
+				break;
+			}
+		}
+	}
+
+	// only the materials the voxels actually use go into the file
+	bool used[256] = {};
+	for (size_t w = 0; w < worlds.size(); w++) {
+		if (sourceWorlds[w] != -1) continue;
+		const VoxelWorld* world = worlds[w];
+		const int gridSize = VoxelWorld::GetGridSize(world->gridDimensions);
+		for (int i = 0; i < gridSize; i++) {
+			const Brick* b = world->bricks[i].load();
+			if (!b || b->IsEmpty()) continue;
+			for (int v = 0; v < BRICKSIZE3; v++) {
+				if (b->grid[v] & 0x00FFFFFF) used[b->grid[v] >> 24] = true;
+			}
+		}
+	}
+	std::vector<SceneFileMaterial> materials;
+	for (uint m = 0; m < 256 && m < MaterialList.size(); m++) {
+		if (used[m]) materials.push_back(ToFileMaterial(MaterialList[m], m));
+	}
+
+	FILE* f = fopen(path, "wb");
+	if (!f) return false;
+
+	SceneFileHeader header = {};
+	header.magic = SceneFileMagic;
+	header.version = SceneFileVersion;
+	header.worldCount = static_cast<uint>(worlds.size());
+	header.materialCount = static_cast<uint>(materials.size());
+	header.brickSize = BRICKSIZE;
+	header.materialOffset = sizeof(SceneFileHeader);
+	header.worldOffset = header.materialOffset + materials.size() * sizeof(SceneFileMaterial);
+	std::vector<SceneFileWorld> worldTable(worlds.size());
+
+	// the world table gets written again at the end, once the offsets are known
+	uint64_t offset = header.worldOffset + worldTable.size() * sizeof(SceneFileWorld);
+	bool ok = fwrite(&header, sizeof(SceneFileHeader), 1, f) == 1;
+	ok &= fwrite(materials.data(), sizeof(SceneFileMaterial), materials.size(), f) == materials.size();
+	ok &= fwrite(worldTable.data(), sizeof(SceneFileWorld), worldTable.size(), f) == worldTable.size();
+
+	for (size_t w = 0; w < worlds.size(); w++) {
+		const VoxelWorld* world = worlds[w];
+		const int gridSize = VoxelWorld::GetGridSize(world->gridDimensions);
+		SceneFileWorld& entry = worldTable[w];
+		entry.position = world->position;
+		entry.rotation = world->rotation;
+		entry.scale = world->scale;
+		entry.gridX = world->gridDimensions.x, entry.gridY = world->gridDimensions.y, entry.gridZ = world->gridDimensions.z;
+		entry.noiseColor = world->NoiseColor;
+		entry.noiseFrequency = world->NoiseFrequency;
+		entry.noiseAmplitude = world->NoiseAmplitude;
+		entry.sourceWorld = sourceWorlds[w];
+		if (entry.sourceWorld != -1) continue;
+
+		std::vector<PageFileEntry> table(gridSize, PageFileEntry{ BrickPager::EmptySlot, 0 });
+		std::vector<const Brick*> occupied;
+		for (int i = 0; i < gridSize; i++) {
+			const Brick* b = world->bricks[i].load();
+			if (!b || b->IsEmpty()) continue;
+			table[i] = PageFileEntry{ static_cast<uint>(occupied.size()), static_cast<uint>(b->voxelCount) };
+			occupied.push_back(b);
+		}
+
+		ok &= Pad(f, offset, PayloadAlignment);
+		entry.tableOffset = offset;
+		ok &= fwrite(table.data(), sizeof(PageFileEntry), table.size(), f) == table.size();
+		offset += table.size() * sizeof(PageFileEntry);
+
+		ok &= Pad(f, offset, PayloadAlignment);
+		entry.payloadOffset = offset;
+		for (const Brick* b : occupied) {
+			ok &= fwrite(b->grid, 1, BrickBytes, f) == BrickBytes;
+		}
+		offset += occupied.size() * BrickBytes;
+		if (!ok) break;
+	}
+
+	ok &= _fseeki64(f, header.worldOffset, SEEK_SET) == 0;
+	ok &= fwrite(worldTable.data(), sizeof(SceneFileWorld), worldTable.size(), f) == worldTable.size();
+	ok &= fclose(f) == 0;
+	// a partial file could still pass as a cache that is newer than its source
+	if (!ok) remove(path);
+	return ok;
+}
+
+int SceneFile::Load(Scene& scene, const char* path) {
+	std::shared_ptr<MappedFile> file = MappedFile::Open(path);
+	if (!file || file->size < sizeof(SceneFileHeader)) return -1;
+
+	const SceneFileHeader* header = reinterpret_cast<const SceneFileHeader*>(file->data);
+	if (header->magic != SceneFileMagic || header->version != SceneFileVersion || header->brickSize != BRICKSIZE
+		|| header->materialOffset + static_cast<uint64_t>(header->materialCount) * sizeof(SceneFileMaterial) > file->size
+		|| header->worldOffset + static_cast<uint64_t>(header->worldCount) * sizeof(SceneFileWorld) > file->size) {
+		return -1;
+	}
+	const SceneFileMaterial* materials = reinterpret_cast<const SceneFileMaterial*>(file->data + header->materialOffset);
+	const SceneFileWorld* worldTable = reinterpret_cast<const SceneFileWorld*>(file->data + header->worldOffset);
+	for (uint w = 0; w < header->worldCount; w++) {
+		const SceneFileWorld& entry = worldTable[w];
+		const uint64_t gridSize = static_cast<uint64_t>(std::max(entry.gridX, 0)) * std::max(entry.gridY, 0) * std::max(entry.gridZ, 0);
+		if (gridSize == 0) return -1;
+		if (entry.sourceWorld != -1) {
+			// instances need an earlier world with its own bricks of the same size
+			if (entry.sourceWorld < 0 || entry.sourceWorld >= static_cast<int>(w) || worldTable[entry.sourceWorld].sourceWorld != -1) return -1;
+			const SceneFileWorld& source = worldTable[entry.sourceWorld];
+			if (source.gridX != entry.gridX || source.gridY != entry.gridY || source.gridZ != entry.gridZ) return -1;
+		} else if (entry.tableOffset + gridSize * sizeof(PageFileEntry) > file->size || entry.payloadOffset > file->size) {
+			return -1;
+		}
+	}
+
+	// the voxels refer to the MaterialList the file was saved with, find where those materials are now
+	uint remap[256];
+	for (uint m = 0; m < 256; m++) {
+		remap[m] = m;
+	}
+	bool identity = true;
+	for (uint m = 0; m < header->materialCount; m++) {
+		const SceneFileMaterial& fileMaterial = materials[m];
+		int index = -1;
+		if (fileMaterial.index < MaterialList.size() && Matches(MaterialList[fileMaterial.index], fileMaterial)) {
+			index = fileMaterial.index;
+		} else {
+			for (int i = 0; i < MaterialList.size(); i++) {
+				if (Matches(MaterialList[i], fileMaterial)) {
+					index = i;
+					break;
+				}
+			}
+		}
+		if (index == -1) {
+			index = static_cast<int>(MaterialList.size());
+			MaterialList.push_back(FromFileMaterial(fileMaterial, index));
+		}
+		remap[fileMaterial.index & 255] = index;
+		identity &= static_cast<uint>(index) == fileMaterial.index;
+	}
+
+	std::vector<VoxelWorld*> loaded(header->worldCount);
+	for (uint w = 0; w < header->worldCount; w++) {
+		const SceneFileWorld& entry = worldTable[w];
+		const int3 grid = make_int3(entry.gridX, entry.gridY, entry.gridZ);
+		VoxelWorld* world = entry.sourceWorld != -1 ? new VoxelWorld(*loaded[entry.sourceWorld]) : new VoxelWorld(grid);
+		loaded[w] = world;
+		world->position = entry.position;
+		world->rotation = entry.rotation;
+		world->scale = entry.scale;
+		world->NoiseColor = entry.noiseColor;
+		world->NoiseFrequency = entry.noiseFrequency;
+		world->NoiseAmplitude = entry.noiseAmplitude;
+		world->UpdateTransform();
+		if (entry.sourceWorld != -1) {
+			scene.worlds.Add(world);
+			continue;
+		}
+		world->store->mappedFile = file;
+
+		const PageFileEntry* table = reinterpret_cast<const PageFileEntry*>(file->data + entry.tableOffset);
+		uint* payload = reinterpret_cast<uint*>(file->data + entry.payloadOffset);
+		const uint64_t slotLimit = (file->size - entry.payloadOffset) / BrickBytes;
+		const int gridSize = VoxelWorld::GetGridSize(grid);
+		for (int i = 0; i < gridSize; i++) {
+			const PageFileEntry& brickEntry = table[i];
+			if (brickEntry.slot == BrickPager::EmptySlot || brickEntry.slot >= slotLimit) continue;
+			const int3 gridPosition = make_int3(i % grid.x, (i / grid.x) % grid.y, i / (grid.x * grid.y));
+			uint* voxels = payload + static_cast<uint64_t>(brickEntry.slot) * BRICKSIZE3;
+			if (identity) {
+				world->bricks[i] = new Brick(gridPosition, voxels, brickEntry.voxelCount);
+				continue;
+			}
+
+			// some materials moved, so this brick gets its own copy with the material bits rewritten
+			Brick* b = new Brick(gridPosition);
+			for (int v = 0; v < BRICKSIZE3; v++) {
+				const uint voxel = voxels[v];
+				b->grid[v] = (voxel & 0x00FFFFFF) ? (remap[voxel >> 24] << 24) | (voxel & 0x00FFFFFF) : voxel;
+			}
+			b->voxelCount = brickEntry.voxelCount;
+			b->flushedVoxelCount = brickEntry.voxelCount;
+			world->bricks[i] = b;
+		}
+		scene.worlds.Add(world);
+	}
+	return static_cast<int>(header->worldCount);
+}
+
+bool SceneFile::IsUpToDate(const std::string& path, const std::string& source) {
+	std::error_code error;
+	const auto time = std::filesystem::last_write_time(path, error);
+	if (error) return false;
+	const auto sourceTime = std::filesystem::last_write_time(source, error);
+	return !error && time >= sourceTime;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+namespace Tmpl8 {
+	class Scene;
+	class VoxelWorld;
+
+	// a file mapped copy-on-write, edits to bricks that point into it never reach the disk.
+	// every world with bricks in the file holds a reference, so the mapping lives as long as they do
+	class MappedFile {
+	public:
+		static std::shared_ptr<MappedFile> Open(const char* path);
+		~MappedFile();
+
+		uint8_t* data = nullptr;
+		uint64_t size = 0;
+
+	private:
+		MappedFile() = default;
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = nullptr;
+	};
+
+	// a scene file is this header, the material table, the world table and then per world its brick table and payloads
+	struct SceneFileHeader {
+		uint magic;
+		uint version;
+		uint worldCount;
+		uint materialCount;
+		uint brickSize;
+		uint padding;
+		uint64_t materialOffset;
+		uint64_t worldOffset;
+	};
+
+	struct SceneFileMaterial {
+		uint index;				// index in the MaterialList the scene was saved with, which is what the voxels refer to
+		float roughness, metallic, transparency, ior;
+		float emissionIntensity;
+		float3 emissionColor;
+		float3 absorptionCoefficient;
+		float reflectanceLUT[REFLECTANCE_LUT_SIZE];
+		float3 transmissionLUT[TRANSMISSION_LUT_SIZE];
+		uint hasTexture, combineTexture;
+		char texturePath[260];	// the texture is loaded again from here, empty without one
+	};
+
+	struct SceneFileWorld {
+		float3 position, rotation, scale;
+		int gridX, gridY, gridZ;
+		int noiseColor;
+		float noiseFrequency, noiseAmplitude;
+		int sourceWorld;		// instances share the bricks of an earlier world in the file, -1 for worlds with their own
+		uint64_t tableOffset;	// one PageFileEntry per brick
+		uint64_t payloadOffset;	// slot * BRICKSIZE3 voxels from here
+	};
+
+	// native scene format: loading maps the file and points the bricks straight at their payloads,
+	// voxels are only copied when the materials they use ended up at a different index in the MaterialList
+	namespace SceneFile {
+		// writes all worlds in the scene. false if a write fails or a world is streamed or paged, those only hold part of
+		// their bricks in memory
+		bool Save(const Scene& scene, const char* path);
+		bool Save(const std::vector<const VoxelWorld*>& worlds, const char* path);
+		// appends the worlds in the file to the scene, returns the number of worlds or -1 if the file can't be used
+		int Load(Scene& scene, const char* path);
+		// whether path exists and is at least as new as source
+		bool IsUpToDate(const std::string& path, const std::string& source);
+	}
+}
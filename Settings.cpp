@@ -34,6 +34,7 @@ bool Settings::HandleRenderOptions() {
 		if (UV) StepThrough = false;
 		changed = true;
 	}
+	ImGui::Checkbox("Cache Primary Hits", &CachePrimaryHits);
 
 
 	ImGui::Dummy(ImVec2(0.0f, 10.0f));
@@ -19,7 +19,8 @@ struct Plane {
 
 enum NeighbourHood {
 	Moore,
-	VonNeumann
+	VonNeumann,
+	Custom
 };
 
 class Settings {
@@ -33,6 +34,7 @@ public:
 
 	bool Accumulate = false;
 	bool Reprojection = true;
+	bool CachePrimaryHits = true;	// reuse the primary hits while the camera and the view stay the same
 
 	bool AntiAliasing = false;
 	bool Jitter = false;
@@ -86,6 +88,9 @@ public:
 	bool Spawn[26] = { 0, 0, 0, 1};
 	int StartState = 6;
 	int NeighbourHood = NeighbourHood::Moore;
+	// the neighbours of the custom neighbourhood, indexed (x + 1) + (y + 1) * 3 + (z + 1) * 9
+	bool CustomKernel[27] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 };
+	int3 AutomataGridSize = int3(WORLDSIZE / BRICKSIZE);	// in bricks
 	float probablity = 0.5f;
 	float fps = 20;
 	int radius = 15;
@@ -1,165 +1,159 @@
 #include "precomp.h"
 
 
-void DrawSphere(Scene& scene, const int3& center, float radius, const uint color, const int materialIndex, const int worldIndex, float probability) {
+// voxel range [start, end) along one axis where |x / WORLDSIZE - center| - size < 0, the same test the shapes used per voxel
+static void BoxRange(const float center, const float size, int& start, int& end) {
+	start = max(0, static_cast<int>(floorf((center - size) * WORLDSIZE)) - 1);
+	while (start < WORLDSIZE && fabsf(static_cast<float>(start) / static_cast<float>(WORLDSIZE) - center) - size >= 0) start++;
+	end = start;
+	while (end < WORLDSIZE && fabsf(static_cast<float>(end) / static_cast<float>(WORLDSIZE) - center) - size < 0) end++;
+}
 
-	const int3 min = center - make_int3(static_cast<int>(radius));
-	const int3 max = center + make_int3(static_cast<int>(radius));
-
-	for (int z = min.z; z < max.z; z++) {
-		for (int y = min.y; y < max.y; y++) {
-			for (int x = min.x; x < max.x; x++) {
-				float3 pos = float3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z));
-				float3 delta = pos - center;
-				float distance = length(delta) - radius;
-				if (distance < 0) {
-					scene.Set(x, y, z, RandomFloat() < probability ? color : 0, materialIndex, worldIndex);
-				}
-			}
-		}
-	}
+void DrawSphere(Scene& scene, const int3& center, float radius, const uint color, const int materialIndex, const int worldIndex, float probability) {
+	scene.FillSphere(center, radius, color, materialIndex, worldIndex, probability);
 }
 
 void DrawHollowSphere(Scene& scene, const float3& center, const float radius, const uint color, const int materialIndex, const int worldIndex) {
 	const int3 min = make_int3(center - float3(radius));
 	const int3 max = make_int3(center + float3(radius));
 
-	for (int z = min.z; z < max.z; z++) {
-		for (int y = min.y; y < max.y; y++) {
-			for (int x = min.x; x < max.x; x++) {
-				float3 pos = float3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z));
-				float3 delta = pos - center;
-				float distance = length(delta) - radius;
-				if (distance < 1.0f && distance > -1.0f) {
-					scene.Set(x, y, z, color, materialIndex, worldIndex);
-				}
-			}
-		}
-	}
+	scene.GetWorld(worldIndex)->FillShape(min, max, (materialIndex << 24) | color, true, [&](const int x, const int y, const int z, uint&) {
+		float3 pos = float3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z));
+		float3 delta = pos - center;
+		float distance = length(delta) - radius;
+		return distance < 1.0f && distance > -1.0f;
+	});
 }
 
 void DrawCube(Scene& scene, const float3& center, float size, const uint color, const int materialIndex, const int worldIndex) {
-
-	for (int z = 0; z < WORLDSIZE; z++) {
-		for (int y = 0; y < WORLDSIZE; y++) {
-			for (int x = 0; x < WORLDSIZE; x++) {
-				float3 pos = float3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)) / static_cast<float>(WORLDSIZE);
-				float3 delta = pos - center;
-				float distance = max(abs(delta.x), max(abs(delta.y), abs(delta.z))) - size;
-				if (distance < 0) {
-					scene.Set(x, y, z, color, materialIndex, worldIndex);
-				}
-			}
-		}
-	}
+	int3 min, max;
+	BoxRange(center.x, size, min.x, max.x);
+	BoxRange(center.y, size, min.y, max.y);
+	BoxRange(center.z, size, min.z, max.z);
+	scene.FillBox(min, max, color, materialIndex, worldIndex);
 }
 
 void DrawHollowCube(Scene& scene, const float3& center, float size, const uint color, const int materialIndex, const int worldIndex) {
-
-	for (int z = 0; z < WORLDSIZE; z++) {
-		for (int y = 0; y < WORLDSIZE; y++) {
-			for (int x = 0; x < WORLDSIZE; x++) {
-				float3 pos = float3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)) / static_cast<float>(WORLDSIZE);
-				float3 delta = pos - center;
-				float distance = max(abs(delta.x), max(abs(delta.y), abs(delta.z))) - size;
-				if (distance < 0.1f && distance > -0.1f) {
-					scene.Set(x, y, z, color, materialIndex, worldIndex);
-				}
-			}
-		}
-	}
+	scene.GetWorld(worldIndex)->FillShape(make_int3(0), make_int3(WORLDSIZE), (materialIndex << 24) | color, true, [&](const int x, const int y, const int z, uint&) {
+		float3 pos = float3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)) / static_cast<float>(WORLDSIZE);
+		float3 delta = pos - center;
+		float distance = max(abs(delta.x), max(abs(delta.y), abs(delta.z))) - size;
+		return distance < 0.1f && distance > -0.1f;
+	});
 }
 
 void DrawBox(Scene& scene, const float3& center, const float3& size, const uint color, const int materialIndex, const int worldIndex) {
-
-	for (int z = 0; z < WORLDSIZE; z++) {
-		for (int y = 0; y < WORLDSIZE; y++) {
-			for (int x = 0; x < WORLDSIZE; x++) {
-				float3 pos = float3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)) / static_cast<float>(WORLDSIZE);
-				float3 delta = pos - center;
-				float3 distance = fabs(delta) - size;
-				if (distance.x < 0 && distance.y < 0 && distance.z < 0) {
-					scene.Set(x, y, z, color, materialIndex, worldIndex);
-				}
-			}
-		}
-	}
+	int3 min, max;
+	BoxRange(center.x, size.x, min.x, max.x);
+	BoxRange(center.y, size.y, min.y, max.y);
+	BoxRange(center.z, size.z, min.z, max.z);
+	scene.FillBox(min, max, color, materialIndex, worldIndex);
 }
 
 void DrawHollowBox(Scene& scene, const float3& center, const float3& size, const uint color, const int materialIndex, const int worldIndex) {
-
-	for (int z = 0; z < WORLDSIZE; z++) {
-		for (int y = 0; y < WORLDSIZE; y++) {
-			for (int x = 0; x < WORLDSIZE; x++) {
-				float3 pos = float3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)) / static_cast<float>(WORLDSIZE);
-				float3 delta = pos - center;
-				float3 distance = fabs(delta) - size;
-				if (distance.x < 0.1f && distance.y < 0.1f && distance.z < 0.1f) {
-					scene.Set(x, y, z, color, materialIndex, worldIndex);
-				}
-			}
-		}
-	}
+	scene.GetWorld(worldIndex)->FillShape(make_int3(0), make_int3(WORLDSIZE), (materialIndex << 24) | color, true, [&](const int x, const int y, const int z, uint&) {
+		float3 pos = float3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)) / static_cast<float>(WORLDSIZE);
+		float3 delta = pos - center;
+		float3 distance = fabs(delta) - size;
+		return distance.x < 0.1f && distance.y < 0.1f && distance.z < 0.1f;
+	});
 }
 
 void DrawLine(Scene& scene, const float3& start, const float3& end, const uint color, const int materialIndex, const int) {
 	float3 delta = end - start;
 	float length = max(abs(delta.x), max(abs(delta.y), abs(delta.z)));
+	std::vector<VoxelEdit> edits;
 	for (int i = 0; i < length * WORLDSIZE; i++) {
 		float t = i / (length * WORLDSIZE);
 		float3 pos = lerp(start, end, t);
-		scene.Set(int(pos.x * WORLDSIZE), int(pos.y * WORLDSIZE), int(pos.z * WORLDSIZE), color, materialIndex);
+		edits.push_back({ uint(int(pos.x * WORLDSIZE)), uint(int(pos.y * WORLDSIZE)), uint(int(pos.z * WORLDSIZE)), (materialIndex << 24) | color });
 	}
+	scene.SetVoxels(edits);
 }
 
-void DrawVoxFile(Scene& scene, const char* filename, float3 position, const int worldIndex) {
-	// Open file
-	FILE* file = fopen(filename, "rb");
-	if (!file) {
-		printf("Failed to open file with name: %s\n", filename);
-		return; // Failed to open file
+// reads and parses a .vox file, nullptr if that fails
+static const ogt_vox_scene* ReadVoxScene(const char* filename) {
+	// preloaded files come from memory, the others are read now
+	std::vector<uint8_t> buffer;
+	if (!AssetCatalog::GetInstance().ReadFile(filename, buffer)) {
+		printf("Failed to read file with name: %s\n", filename);
+		return nullptr;
 	}
 
-	// Determine file size
-	fseek(file, 0, SEEK_END);
-	long fileSize = ftell(file);
-	if (fileSize <= 0) {
-		fclose(file);
-		printf("File is empty or error in ftell\n");
-		return; // File is empty or error in ftell
-	}
-	fseek(file, 0, SEEK_SET);
-
-	// Allocate buffer based on file size
-	uint8_t* buffer = (uint8_t*)MALLOC64(fileSize);
-	if (!buffer) {
-		fclose(file);
-		printf("Memory allocation failed\n");
-		return; // Memory allocation failed
+	// Read VOX scene from buffer
+	// keep the groups, so instances can be resolved against the hierarchy including its hidden flags
+	const ogt_vox_scene* voxelScene = ogt_vox_read_scene_with_flags(buffer.data(), static_cast<uint32_t>(buffer.size()), k_read_scene_flags_groups);
+
+	if (!voxelScene) {
+		printf("Failed to read VOX scene\n");
 	}
+	return voxelScene;
+}
 
-	// Read file into buffer
-	size_t bytesRead = fread(buffer, 1, fileSize, file);
-	if (bytesRead != fileSize) {
-		// Error reading file or file read partially
-		FREE64(buffer);
-		fclose(file);
-		printf("Error reading file or file read partially\n");
-		return;
+void BuildVoxPalette(const ogt_vox_scene* voxelScene, uint* palette) {
+	bool used[256] = {};
+	for (uint32_t i = 0; i < voxelScene->num_models; i++) {
+		const ogt_vox_model* model = voxelScene->models[i];
+		const size_t count = static_cast<size_t>(model->size_x) * model->size_y * model->size_z;
+		for (size_t v = 0; v < count; v++) {
+			used[model->voxel_data[v]] = true;
+		}
 	}
 
-	// Close the file as it's no longer needed
-	fclose(file);
+	palette[0] = 0;
+	for (int colorIndex = 1; colorIndex < 256; colorIndex++) {
+		palette[colorIndex] = 0;
+		if (!used[colorIndex]) continue;
 
-	// Read VOX scene from buffer
-	const ogt_vox_scene* voxelScene = ogt_vox_read_scene(buffer, fileSize);
-	const ogt_vox_matl_array* palette = &voxelScene->materials;
-	FREE64(buffer); // Free buffer immediately after use
+		//get the material of the voxel from the voxel scene
+		const ogt_vox_rgba voxColor = voxelScene->palette.color[colorIndex];
+		const ogt_vox_matl matl = voxelScene->materials.matl[colorIndex];
 
-	if (!voxelScene) {
-		printf("Failed to read VOX scene\n");
-		return; // Failed to read VOX scene
+		int materialIndex = static_cast<int>(MaterialList.size());
+		Material newMaterial = Material(materialIndex, matl.rough, matl.metal, matl.trans, matl.ior);
+
+		//check if the material already exists
+		for (int m = 0; m < MaterialList.size(); m++) {
+			if (newMaterial == MaterialList[m]) {
+				materialIndex = m;
+				break;
+			}
+		}
+		//if the material does not exist, add it to the list
+		if (materialIndex == MaterialList.size()) {
+			MaterialList.push_back(newMaterial.BakeLUT());
+		}
+
+		//store the material index in the first 8 bits of the color
+		palette[colorIndex] = (materialIndex << 24) | (voxColor.r << 16) | (voxColor.g << 8) | voxColor.b;
+	}
+}
+
+// MagicaVoxel is z-up, so world x, y, z come from model x, z, y
+static size_t ImportVoxModel(VoxelWorld* world, const ogt_vox_model* model, const int3& offset, const uint* palette) {
+	const int3 size = make_int3(model->size_x, model->size_z, model->size_y);
+	const int3 stride = make_int3(1, model->size_x * model->size_y, model->size_x);
+	return world->SetDense(model->voxel_data, size, stride, offset, palette);
+}
+
+// an instance shows up when it, its layer and every group above it are visible
+static bool IsVoxInstanceVisible(const ogt_vox_scene* voxelScene, const ogt_vox_instance& instance) {
+	if (instance.hidden || instance.model_index >= voxelScene->num_models) return false;
+	if (instance.layer_index < voxelScene->num_layers && voxelScene->layers[instance.layer_index].hidden) return false;
+	for (uint32_t group = instance.group_index; group < voxelScene->num_groups; group = voxelScene->groups[group].parent_group_index) {
+		if (voxelScene->groups[group].hidden) return false;
 	}
+	return true;
+}
+
+static void PrintImportStats(const char* filename, const size_t voxelCount, const float seconds) {
+	printf("Imported %s: %zu voxels in %.2f ms (%.1f M voxels/s)\n", filename, voxelCount, seconds * 1000.0f,
+		seconds > 0.0f ? static_cast<float>(voxelCount) / seconds / 1000000.0f : 0.0f);
+}
+
+void DrawVoxFile(Scene& scene, const char* filename, float3 position, const int worldIndex) {
+	const ogt_vox_scene* voxelScene = ReadVoxScene(filename);
+	if (!voxelScene) return;
 
 	position *= WORLDSIZE;
 
@@ -168,213 +162,95 @@ void DrawVoxFile(Scene& scene, const char* filename, float3 position, const int
 	printf("# of models: %u\n", voxelScene->num_models);
 	printf("# of groups: %u\n", voxelScene->num_groups);
 
-	for (uint32_t i = 0; i < voxelScene->num_models; i++) {
-		const ogt_vox_model* model = voxelScene->models[i];
-		const ogt_vox_instance instance = voxelScene->instances[i];
-		int sizeX = model->size_x;
-		int sizeY = model->size_y;
-		int sizeZ = model->size_z;
+	Timer timer;
+	uint palette[256];
+	BuildVoxPalette(voxelScene, palette);
+
+	VoxelWorld* world = scene.GetWorld(worldIndex);
+	size_t voxelCount = 0;
+	for (uint32_t i = 0; i < voxelScene->num_instances; i++) {
+		const ogt_vox_instance& instance = voxelScene->instances[i];
+		if (!IsVoxInstanceVisible(voxelScene, instance)) continue;
+		const ogt_vox_model* model = voxelScene->models[instance.model_index];
 
-		int3 offset = transformToInt3(instance.transform);
+		int3 offset = transformToInt3(ogt_vox_sample_instance_transform_global(&instance, 0, voxelScene));
 		//convert from right handed to left handed coordinate system
 		int3 newOffset = int3(offset.x, offset.z, offset.y);
+		newOffset += make_int3(static_cast<int>(position.x), static_cast<int>(position.y), static_cast<int>(position.z));
 
-		for (int x = 0; x < sizeX; x++) {
-			for (int y = 0; y < sizeY; y++) {
-				for (int z = 0; z < sizeZ; z++) {
-					uint8_t colorIndex = model->voxel_data[x + y * sizeX + z * sizeX * sizeY];
-					if (colorIndex != 0) {
-
-						//get the material of the voxel from the voxel scene
-						ogt_vox_rgba voxColor = voxelScene->palette.color[colorIndex];
-						//convert the color to a RGB uint format
-						uint color = (voxColor.r << 16) | (voxColor.g << 8) | voxColor.b;
-
-						ogt_vox_matl matl = palette->matl[colorIndex];
-
-						int materialIndex = static_cast<int>(MaterialList.size());
-						Material newMaterial = Material(materialIndex, matl.rough, matl.metal, matl.trans, matl.ior);
-
-						//check if the material already exists
-						for (int m = 0; m < MaterialList.size(); m++) {
-							if (newMaterial == MaterialList[m]) {
-								materialIndex = m;
-								break;
-							}
-						}
-						//if the material does not exist, add it to the list
-						if (materialIndex == MaterialList.size()) {
-							MaterialList.push_back(newMaterial);
-						}
-
-						//store the material index in the first 8 bits of the color
-						color |= (materialIndex << 24);
-
-						// Adjusted positions for different coordinate system
-						int adjustedX = x + newOffset.x;
-						int adjustedY = z + newOffset.y;
-						int adjustedZ = y + newOffset.z;
-
-						adjustedX += static_cast<int>(position.x);
-						adjustedY += static_cast<int>(position.y);
-						adjustedZ += static_cast<int>(position.z);
-
-						//print position
-						//printf("x: %d, y: %d, z: %d\n", adjustedX, adjustedY, adjustedZ);
-
-						//check if the position is within the scene
-						scene.Set(adjustedX, adjustedY, adjustedZ, color, materialIndex, worldIndex);
-						if (adjustedX >= 0 && adjustedX < WORLDSIZE && adjustedY >= 0 && adjustedY < WORLDSIZE && adjustedZ >= 0 && adjustedZ < WORLDSIZE) {
-						}
-
-						//scene.Set(adjustedX + position.x, adjustedY + position.y, adjustedZ + position.z , color, materialIndex);
-					}
-				}
-			}
-		}
+		voxelCount += ImportVoxModel(world, model, newOffset, palette);
 	}
+	PrintImportStats(filename, voxelCount, timer.elapsed());
 
-	printf("VOX scene processed\n");
 	// Free VOX scene after processing
 	ogt_vox_destroy_scene(voxelScene);
 }
 
 void LoadVoxFile(Scene& scene, const char* filename) {
-	// Open file
-	FILE* file = fopen(filename, "rb");
-	if (!file) {
-		printf("Failed to open file with name: %s\n", filename);
-		return; // Failed to open file
-	}
-
-	// Determine file size
-	fseek(file, 0, SEEK_END);
-	long fileSize = ftell(file);
-	if (fileSize <= 0) {
-		fclose(file);
-		printf("File is empty or error in ftell\n");
-		return; // File is empty or error in ftell
-	}
-	fseek(file, 0, SEEK_SET);
-
-	// Allocate buffer based on file size
-	uint8_t* buffer = (uint8_t*)MALLOC64(fileSize);
-	if (!buffer) {
-		fclose(file);
-		printf("Memory allocation failed\n");
-		return; // Memory allocation failed
-	}
-
-	// Read file into buffer
-	size_t bytesRead = fread(buffer, 1, fileSize, file);
-	if (bytesRead != fileSize) {
-		// Error reading file or file read partially
-		FREE64(buffer);
-		fclose(file);
-		printf("Error reading file or file read partially\n");
-		return;
-	}
-
-	// Close the file as it's no longer needed
-	fclose(file);
-
-	// Read VOX scene from buffer
-	const ogt_vox_scene* voxelScene = ogt_vox_read_scene(buffer, fileSize);
-	const ogt_vox_matl_array* palette = &voxelScene->materials;
-	FREE64(buffer); // Free buffer immediately after use
+	// the native scene file next to the .vox loads without parsing or rebuilding any bricks
+	const std::string cachePath = std::string(filename) + ".vxs";
+	if (SceneFile::IsUpToDate(cachePath, filename) && SceneFile::Load(scene, cachePath.c_str()) >= 0) return;
 
-	if (!voxelScene) {
-		printf("Failed to read VOX scene\n");
-		return; // Failed to read VOX scene
-	}
+	const ogt_vox_scene* voxelScene = ReadVoxScene(filename);
+	if (!voxelScene) return;
 
 	// Process VOX scene
 	printf("# of layers: %u\n", voxelScene->num_layers);
 	printf("# of models: %u\n", voxelScene->num_models);
 	printf("# of groups: %u\n", voxelScene->num_groups);
 
-	for (uint32_t i = 0; i < voxelScene->num_models; i++) {
-		const ogt_vox_model* model = voxelScene->models[i];
-		const ogt_vox_instance instance = voxelScene->instances[i];
-		int sizeX = model->size_x;
-		int sizeY = model->size_y;
-		int sizeZ = model->size_z;
-
-
-
-		float3 offset = transformToFloat3(instance.transform);
+	Timer timer;
+	uint palette[256];
+	BuildVoxPalette(voxelScene, palette);
+
+	// one world per instance, the first instance of a model owns the bricks and the others share them.
+	// they are created up front so the models can be converted in parallel
+	const int modelCount = static_cast<int>(voxelScene->num_models);
+	std::vector<VoxelWorld*> modelWorlds(modelCount, nullptr);
+	std::vector<const VoxelWorld*> newWorlds;
+	int instanceCount = 0;
+	for (uint32_t i = 0; i < voxelScene->num_instances; i++) {
+		const ogt_vox_instance& instance = voxelScene->instances[i];
+		if (!IsVoxInstanceVisible(voxelScene, instance)) continue;
+		const ogt_vox_model* model = voxelScene->models[instance.model_index];
+
+		float3 offset = transformToFloat3(ogt_vox_sample_instance_transform_global(&instance, 0, voxelScene));
 		//convert from right handed to left handed coordinate system
 		float offsetX = offset.x / static_cast<float>(WORLDSIZE);
 		float offsetY = offset.y / static_cast<float>(WORLDSIZE);
 		float offsetZ = offset.z / static_cast<float>(WORLDSIZE);
 		offset = float3(offsetX, offsetZ, offsetY);
 
-		int gridX = static_cast<int>(ceilf(static_cast<float>(sizeX) / static_cast<float>(BRICKSIZE)));
-		int gridY = static_cast<int>(ceilf(static_cast<float>(sizeZ) / static_cast<float>(BRICKSIZE)));
-		int gridZ = static_cast<int>(ceilf(static_cast<float>(sizeY) / static_cast<float>(BRICKSIZE)));
+		int gridX = static_cast<int>(ceilf(static_cast<float>(model->size_x) / static_cast<float>(BRICKSIZE)));
+		int gridY = static_cast<int>(ceilf(static_cast<float>(model->size_z) / static_cast<float>(BRICKSIZE)));
+		int gridZ = static_cast<int>(ceilf(static_cast<float>(model->size_y) / static_cast<float>(BRICKSIZE)));
 		int3 gridSize = make_int3(gridX, gridY, gridZ);
 
-		VoxelWorld* newWorld = new VoxelWorld(gridSize);
+		VoxelWorld*& modelWorld = modelWorlds[instance.model_index];
+		VoxelWorld* newWorld = modelWorld ? new VoxelWorld(*modelWorld) : new VoxelWorld(gridSize);
+		if (!modelWorld) modelWorld = newWorld;
 		newWorld->position = offset;
 		newWorld->UpdateTransform();
-		scene.worlds.push_back(newWorld);
-		newWorld->Resize(gridSize);
-
-
-		for (int x = 0; x < sizeX; x++) {
-			for (int y = 0; y < sizeY; y++) {
-				for (int z = 0; z < sizeZ; z++) {
-					uint8_t colorIndex = model->voxel_data[x + y * sizeX + z * sizeX * sizeY];
-					if (colorIndex != 0) {
-
-						//get the material of the voxel from the voxel scene
-						ogt_vox_rgba voxColor = voxelScene->palette.color[colorIndex];
-						//convert the color to a RGB uint format
-						uint color = (voxColor.r << 16) | (voxColor.g << 8) | voxColor.b;
-
-						ogt_vox_matl matl = palette->matl[colorIndex];
-
-						int materialIndex = static_cast<int>(MaterialList.size());
-						Material newMaterial = Material(materialIndex, matl.rough, matl.metal, matl.trans, matl.ior);
-
-						//check if the material already exists
-						for (int m = 0; m < MaterialList.size(); m++) {
-							if (newMaterial == MaterialList[m]) {
-								materialIndex = m;
-								break;
-							}
-						}
-						//if the material does not exist, add it to the list
-						if (materialIndex == MaterialList.size()) {
-							MaterialList.push_back(newMaterial);
-						}
-
-						//store the material index in the first 8 bits of the color
-						color |= (materialIndex << 24);
-
-						// Adjusted positions for different coordinate system
-						int adjustedX = x ;
-						int adjustedY = z ;
-						int adjustedZ = y ;
-
-						//print position
-						//printf("x: %d, y: %d, z: %d\n", adjustedX, adjustedY, adjustedZ);
-
-						//check if the position is within the scene
-						newWorld->Set(adjustedX, adjustedY, adjustedZ, color, materialIndex);
-						if (adjustedX >= 0 && adjustedX < WORLDSIZE && adjustedY >= 0 && adjustedY < WORLDSIZE && adjustedZ >= 0 && adjustedZ < WORLDSIZE) {
-						}
-
-						//scene.Set(adjustedX + position.x, adjustedY + position.y, adjustedZ + position.z , color, materialIndex);
-					}
-				}
-			}
-		}
+		scene.worlds.Add(newWorld);
+		newWorlds.push_back(newWorld);
+		instanceCount++;
+	}
+
+	// scenes with many models get a task per model, otherwise each model is split over its bricks
+	long long voxelCount = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+ : voxelCount) if (modelCount >= 8)
+	for (int i = 0; i < modelCount; i++) {
+		if (modelWorlds[i]) voxelCount += ImportVoxModel(modelWorlds[i], voxelScene->models[i], make_int3(0), palette);
 	}
+	printf("%d instances sharing the bricks of %d models\n", instanceCount, static_cast<int>(std::count_if(modelWorlds.begin(), modelWorlds.end(), [](VoxelWorld* w) { return w != nullptr; })));
+	PrintImportStats(filename, static_cast<size_t>(voxelCount), timer.elapsed());
 
-	printf("VOX scene processed\n");
 	// Free VOX scene after processing
 	ogt_vox_destroy_scene(voxelScene);
+
+	if (!SceneFile::Save(newWorlds, cachePath.c_str())) {
+		printf("Failed to write scene file %s\n", cachePath.c_str());
+	}
 }
 
 std::vector<Line> VisualizeSphere(const float radius, const float3 center, const float3, const int latitudeLines, const int longitudeLines) {
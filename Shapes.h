@@ -22,5 +22,8 @@ void DrawVoxFile(Scene& scene, const char* filename, float3 position, const int
 
 void LoadVoxFile(Scene& scene, const char* filename);
 
+// palette index -> voxel with the material index in the top 8 bits, materials are looked up once per used palette entry
+void BuildVoxPalette(const ogt_vox_scene* voxelScene, uint* palette);
+
 std::vector<Line> VisualizeSphere(const float radius, const float3 center, const float3 color, const int latitudeLines, const int longitudeLines);
 std::vector<Line> VisualizeCube(const float3& center, const float3& size, const float3 color);
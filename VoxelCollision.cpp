@@ -0,0 +1,375 @@
+#include "precomp.h"
+
+namespace {
+	// the voxel grid of a world, where a voxel is the unit box at its coordinate
+	struct GridSpace {
+		GridSpace(const VoxelWorld& _world) : world(_world) {
+			// the scale of the world is the length of its axes
+			const float scale = min(min(length(world.transform.TransformVector(float3(1, 0, 0))),
+				length(world.transform.TransformVector(float3(0, 1, 0)))), length(world.transform.TransformVector(float3(0, 0, 1))));
+			voxelSize = scale / WORLDSIZE;
+		}
+		float3 ToGrid(const float3& p) const { return world.invTransform.TransformPoint(p) * WORLDSIZE; }
+		float3 ToGridVector(const float3& v) const { return world.invTransform.TransformVector(v) * WORLDSIZE; }
+		float3 ToWorld(const float3& p) const { return world.transform.TransformPoint(p / WORLDSIZE); }
+		float3 ToWorldNormal(const float3& n) const { return normalize(world.transform.TransformVector(n)); }
+
+		const VoxelWorld& world;
+		float voxelSize;	// in world space
+	};
+
+	// calls visit(x, y, z) for every solid voxel in [start, end) of the grid, but only in bricks that pass
+	// brickTest(brickMin, brickMax). returns true as soon as visit does
+	template <typename BrickTest, typename Visit>
+	bool VisitSolidVoxels(const VoxelWorld& world, int3 start, int3 end, const BrickTest& brickTest, const Visit& visit) {
+		start = max(start, make_int3(0));
+		end = min(end, world.gridDimensions * BRICKSIZE);
+		if (start.x >= end.x || start.y >= end.y || start.z >= end.z) return false;
+		const int3 brickMin = make_int3(start.x / BRICKSIZE, start.y / BRICKSIZE, start.z / BRICKSIZE);
+		const int3 brickMax = make_int3((end.x - 1) / BRICKSIZE, (end.y - 1) / BRICKSIZE, (end.z - 1) / BRICKSIZE) + 1;
+
+		for (int bz = brickMin.z; bz < brickMax.z; bz++) {
+			for (int by = brickMin.y; by < brickMax.y; by++) {
+				for (int bx = brickMin.x; bx < brickMax.x; bx++) {
+					const int index = VoxelWorld::GetBrickIndex(bx, by, bz, world.gridDimensions);
+					const Brick* b = world.bricks[index];
+					if (!b && world.pager) b = world.pager->Fault(index);
+					if (!b || b->IsEmpty()) continue;
+					if (world.pager) world.pager->MarkUsed(index);
+
+					const int3 origin = make_int3(bx, by, bz) * BRICKSIZE;
+					if (!brickTest(make_float3(origin), make_float3(origin + BRICKSIZE))) continue;
+					const int3 from = max(start, origin);
+					const int3 to = min(end, origin + BRICKSIZE);
+					for (int z = from.z; z < to.z; z++) {
+						for (int y = from.y; y < to.y; y++) {
+							for (int x = from.x; x < to.x; x++) {
+								if ((b->Get(x - origin.x, y - origin.y, z - origin.z) & 0x00FFFFFF) && visit(x, y, z)) return true;
+							}
+						}
+					}
+				}
+			}
+		}
+		return false;
+	}
+
+	// contact of a sphere with a box, false if they don't touch
+	bool SphereBoxContact(const float3& center, const float radius, const float3& boxMin, const float3& boxMax, float3& point, float3& normal, float& depth) {
+		const float3 closest = clamp(center, boxMin, boxMax);
+		const float3 offset = center - closest;
+		const float distance2 = dot(offset, offset);
+		if (distance2 >= radius * radius) return false;
+		if (distance2 > 0.0f) {
+			const float distance = sqrtf(distance2);
+			point = closest;
+			normal = offset / distance;
+			depth = radius - distance;
+			return true;
+		}
+		// the centre is inside the box, out through the nearest face
+		int axis = 0;
+		float side = -1.0f, nearest = 1e34f;
+		for (int i = 0; i < 3; i++) {
+			const float below = center.cell[i] - boxMin.cell[i], above = boxMax.cell[i] - center.cell[i];
+			if (below < nearest) nearest = below, axis = i, side = -1.0f;
+			if (above < nearest) nearest = above, axis = i, side = 1.0f;
+		}
+		point = center;
+		point[axis] = side > 0.0f ? boxMax.cell[axis] : boxMin.cell[axis];
+		normal = float3(0);
+		normal[axis] = side;
+		depth = radius + nearest;
+		return true;
+	}
+
+	// contact of two boxes, the normal is the shortest way to move box a out of box b
+	bool BoxBoxContact(const float3& aMin, const float3& aMax, const float3& bMin, const float3& bMax, float3& point, float3& normal, float& depth) {
+		int axis = 0;
+		float side = 1.0f;
+		depth = 1e34f;
+		for (int i = 0; i < 3; i++) {
+			const float up = bMax.cell[i] - aMin.cell[i], down = aMax.cell[i] - bMin.cell[i];
+			if (up <= 0.0f || down <= 0.0f) return false;
+			if (up < depth) depth = up, axis = i, side = 1.0f;
+			if (down < depth) depth = down, axis = i, side = -1.0f;
+		}
+		point = (fmaxf(aMin, bMin) + fminf(aMax, bMax)) * 0.5f;
+		normal = float3(0);
+		normal[axis] = side;
+		return true;
+	}
+
+	// the point of segment a b closest to a box. the squared distance to the box is a quadratic in t between the points
+	// where the segment crosses a face plane, so the exact minimum is the best of the minima of those pieces
+	float3 ClosestOnSegment(const float3& a, const float3& b, const float3& boxMin, const float3& boxMax) {
+		const float3 ab = b - a;
+		float crossings[8];
+		int crossingCount = 0;
+		crossings[crossingCount++] = 0.0f;
+		crossings[crossingCount++] = 1.0f;
+		for (int i = 0; i < 3; i++) {
+			if (fabsf(ab.cell[i]) < 1e-12f) continue;
+			const float tMin = (boxMin.cell[i] - a.cell[i]) / ab.cell[i], tMax = (boxMax.cell[i] - a.cell[i]) / ab.cell[i];
+			if (tMin > 0.0f && tMin < 1.0f) crossings[crossingCount++] = tMin;
+			if (tMax > 0.0f && tMax < 1.0f) crossings[crossingCount++] = tMax;
+		}
+		std::sort(crossings, crossings + crossingCount);
+
+		const auto distance2 = [&](const float3& p) {
+			const float3 offset = p - clamp(p, boxMin, boxMax);
+			return dot(offset, offset);
+		};
+		float3 closest = a;
+		float nearest = distance2(a);
+		for (int piece = 0; piece + 1 < crossingCount; piece++) {
+			const float t0 = crossings[piece], t1 = crossings[piece + 1];
+			// which face each axis is outside of doesn't change within a piece, the midpoint tells
+			const float3 middle = a + ab * ((t0 + t1) * 0.5f);
+			float slope = 0.0f, curvature = 0.0f;
+			for (int i = 0; i < 3; i++) {
+				float face;
+				if (middle.cell[i] < boxMin.cell[i]) face = boxMin.cell[i];
+				else if (middle.cell[i] > boxMax.cell[i]) face = boxMax.cell[i];
+				else continue;
+				slope += ab.cell[i] * (a.cell[i] - face);
+				curvature += ab.cell[i] * ab.cell[i];
+			}
+			const float t = curvature > 0.0f ? clamp(-slope / curvature, t0, t1) : t0;
+			const float3 p = a + ab * t;
+			const float d2 = distance2(p);
+			if (d2 < nearest) nearest = d2, closest = p;
+		}
+		const float d2 = distance2(b);
+		return d2 < nearest ? b : closest;
+	}
+
+	// where origin + direction * t enters a box for t in [0, tMax]
+	bool SegmentBox(const float3& origin, const float3& direction, const float3& boxMin, const float3& boxMax, const float tMax, float& tEnter) {
+		float tNear = 0.0f, tFar = tMax;
+		for (int i = 0; i < 3; i++) {
+			if (fabsf(direction.cell[i]) < 1e-12f) {
+				if (origin.cell[i] < boxMin.cell[i] || origin.cell[i] > boxMax.cell[i]) return false;
+				continue;
+			}
+			const float invDirection = 1.0f / direction.cell[i];
+			float t1 = (boxMin.cell[i] - origin.cell[i]) * invDirection;
+			float t2 = (boxMax.cell[i] - origin.cell[i]) * invDirection;
+			if (t1 > t2) std::swap(t1, t2);
+			tNear = max(tNear, t1);
+			tFar = min(tFar, t2);
+			if (tNear > tFar) return false;
+		}
+		tEnter = tNear;
+		return true;
+	}
+
+	// distance along a normalized direction to a capsule from outside of it, -1 for a miss
+	float RayCapsule(const float3& origin, const float3& direction, const float3& a, const float3& b, const float radius) {
+		const float3 ab = b - a, ao = origin - a;
+		const float abab = dot(ab, ab), abd = dot(ab, direction), abao = dot(ab, ao);
+		const float k = abab - abd * abd;
+		if (k > 1e-12f) {
+			// the side of the capsule, missing the infinite cylinder misses the ends too
+			const float m = abab * dot(direction, ao) - abao * abd;
+			const float c = abab * dot(ao, ao) - abao * abao - radius * radius * abab;
+			const float h = m * m - k * c;
+			if (h < 0.0f) return -1.0f;
+			const float t = (-m - sqrtf(h)) / k;
+			const float y = abao + t * abd;
+			if (y > 0.0f && y < abab) return t;
+		}
+		// the spheres at the ends
+		float nearest = -1.0f;
+		for (const float3& end : { a, b }) {
+			const float3 oc = origin - end;
+			const float m = dot(direction, oc);
+			const float h = m * m - dot(oc, oc) + radius * radius;
+			if (h < 0.0f) continue;
+			const float t = -m - sqrtf(h);
+			if (t >= 0.0f && (nearest < 0.0f || t < nearest)) nearest = t;
+		}
+		return nearest;
+	}
+
+	// the fraction of motion below tMax at which a sphere first touches a box, -1 if it doesn't. the centre touches the
+	// box rounded by the radius there: the box grown by the radius tells a face of it apart from an edge or corner,
+	// and those are capsules around the edges of the box
+	float SweepSphereBox(const float3& center, const float3& motion, const float radius, const float3& boxMin, const float3& boxMax, const float tMax) {
+		const float3 closest = clamp(center, boxMin, boxMax);
+		if (sqrLength(center - closest) < radius * radius) return 0.0f;
+		const float motionLength = length(motion);
+		float tEnter;
+		if (motionLength <= 0.0f || !SegmentBox(center, motion, boxMin - radius, boxMax + radius, tMax, tEnter)) return -1.0f;
+
+		const float3 p = center + motion * tEnter;
+		int outside = 0;
+		float3 corner;
+		int3 inside = make_int3(0);
+		for (int i = 0; i < 3; i++) {
+			if (p.cell[i] < boxMin.cell[i]) outside++, corner[i] = boxMin.cell[i];
+			else if (p.cell[i] > boxMax.cell[i]) outside++, corner[i] = boxMax.cell[i];
+			else corner[i] = boxMin.cell[i], inside[i] = 1;
+		}
+		if (outside <= 1) return tEnter;
+
+		// an edge has the one capsule along it, a corner the three that meet there
+		const float3 direction = motion / motionLength;
+		float nearest = -1.0f;
+		for (int axis = 0; axis < 3; axis++) {
+			if (outside == 2 && !inside[axis]) continue;
+			float3 a = corner, b = corner;
+			a[axis] = boxMin.cell[axis], b[axis] = boxMax.cell[axis];
+			const float distance = RayCapsule(center, direction, a, b, radius);
+			if (distance < 0.0f) continue;
+			const float t = distance / motionLength;
+			if (t < tMax && (nearest < 0.0f || t < nearest)) nearest = t;
+		}
+		return nearest;
+	}
+
+	// tests the solid voxels in the grid space bounds with contact(voxelMin, voxelMax, point, normal, depth), bricks are
+	// skipped when their box fails the same test
+	template <typename Contact>
+	bool Overlap(const GridSpace& grid, const int worldIndex, const float3& boundsMin, const float3& boundsMax, const Contact& contact, std::vector<VoxelContact>* contacts) {
+		const int3 start = make_int3(floorf(boundsMin));
+		const int3 end = make_int3(floorf(boundsMax)) + 1;
+		bool found = false;
+		float3 point, normal;
+		float depth;
+		const bool stopped = VisitSolidVoxels(grid.world, start, end,
+			[&](const float3& brickMin, const float3& brickMax) { return contact(brickMin, brickMax, point, normal, depth); },
+			[&](const int x, const int y, const int z) {
+				const float3 voxelMin = make_float3(make_int3(x, y, z));
+				if (!contact(voxelMin, voxelMin + 1.0f, point, normal, depth)) return false;
+				found = true;
+				if (!contacts) return true;
+				contacts->push_back({ grid.ToWorld(point), grid.ToWorldNormal(normal), depth * grid.voxelSize, make_int3(x, y, z), worldIndex });
+				return false;
+			});
+		return found || stopped;
+	}
+
+	// calls query(world, worldIndex) for every active world. overlaps without contacts stop at the first world that has one
+	template <typename Query>
+	bool OverlapScene(const Scene& scene, const bool stopAtFirst, const Query& query) {
+		const std::vector<VoxelWorld*>& active = scene.worlds.GetActive();
+		const std::vector<int>& slots = scene.worlds.GetActiveSlots();
+		bool found = false;
+		for (size_t i = 0; i < active.size(); i++) {
+			if (query(*active[i], slots[i])) {
+				found = true;
+				if (stopAtFirst) break;
+			}
+		}
+		return found;
+	}
+}
+
+bool Tmpl8::VoxelCollision::OverlapSphere(const VoxelWorld& world, const int worldIndex, const float3& center, const float radius, std::vector<VoxelContact>* contacts) {
+	if (!world.IsActive()) return false;
+	const GridSpace grid(world);
+	const float3 c = grid.ToGrid(center);
+	const float r = radius / grid.voxelSize;
+	return Overlap(grid, worldIndex, c - r, c + r, [&](const float3& boxMin, const float3& boxMax, float3& point, float3& normal, float& depth) {
+		return SphereBoxContact(c, r, boxMin, boxMax, point, normal, depth);
+	}, contacts);
+}
+
+bool Tmpl8::VoxelCollision::OverlapBox(const VoxelWorld& world, const int worldIndex, const float3& boxMin, const float3& boxMax, std::vector<VoxelContact>* contacts) {
+	if (!world.IsActive()) return false;
+	const GridSpace grid(world);
+	float3 gridMin = float3(1e34f), gridMax = float3(-1e34f);
+	for (int i = 0; i < 8; i++) {
+		const float3 corner = grid.ToGrid(float3(i & 1 ? boxMax.x : boxMin.x, i & 2 ? boxMax.y : boxMin.y, i & 4 ? boxMax.z : boxMin.z));
+		gridMin = fminf(gridMin, corner);
+		gridMax = fmaxf(gridMax, corner);
+	}
+	return Overlap(grid, worldIndex, gridMin, gridMax, [&](const float3& voxelMin, const float3& voxelMax, float3& point, float3& normal, float& depth) {
+		return BoxBoxContact(gridMin, gridMax, voxelMin, voxelMax, point, normal, depth);
+	}, contacts);
+}
+
+bool Tmpl8::VoxelCollision::OverlapCapsule(const VoxelWorld& world, const int worldIndex, const float3& a, const float3& b, const float radius, std::vector<VoxelContact>* contacts) {
+	if (!world.IsActive()) return false;
+	const GridSpace grid(world);
+	const float3 gridA = grid.ToGrid(a), gridB = grid.ToGrid(b);
+	const float r = radius / grid.voxelSize;
+	return Overlap(grid, worldIndex, fminf(gridA, gridB) - r, fmaxf(gridA, gridB) + r, [&](const float3& boxMin, const float3& boxMax, float3& point, float3& normal, float& depth) {
+		return SphereBoxContact(ClosestOnSegment(gridA, gridB, boxMin, boxMax), r, boxMin, boxMax, point, normal, depth);
+	}, contacts);
+}
+
+Tmpl8::VoxelSweepHit Tmpl8::VoxelCollision::SweepSphere(const VoxelWorld& world, const int worldIndex, const float3& center, const float radius, const float3& motion) {
+	VoxelSweepHit result;
+	if (!world.IsActive()) return result;
+	const GridSpace grid(world);
+	const float3 c = grid.ToGrid(center), m = grid.ToGridVector(motion);
+	const float r = radius / grid.voxelSize;
+	const float3 boundsMin = fminf(c, c + m) - r, boundsMax = fmaxf(c, c + m) + r;
+
+	// voxels after the nearest hit so far can't be nearer, their bricks are skipped when the sphere only reaches them later
+	float nearest = 1.0f;
+	int3 voxel = make_int3(0);
+	VisitSolidVoxels(world, make_int3(floorf(boundsMin)), make_int3(floorf(boundsMax)) + 1,
+		[&](const float3& brickMin, const float3& brickMax) {
+			float tEnter;
+			return SegmentBox(c, m, brickMin - r, brickMax + r, nearest, tEnter);
+		},
+		[&](const int x, const int y, const int z) {
+			const float3 voxelMin = make_float3(make_int3(x, y, z));
+			const float t = SweepSphereBox(c, m, r, voxelMin, voxelMin + 1.0f, nearest);
+			if (t < 0.0f) return false;
+			result.hit = true;
+			nearest = t;
+			voxel = make_int3(x, y, z);
+			// nothing is nearer than a voxel the sphere already touches
+			return t <= 0.0f;
+		});
+	if (!result.hit) return result;
+
+	// the contact where the sphere stops, its radius grows a little so it still touches there
+	const float3 voxelMin = make_float3(voxel);
+	const float3 stop = c + m * nearest;
+	float3 point, normal;
+	float depth;
+	if (!SphereBoxContact(stop, r * 1.01f + 1e-4f, voxelMin, voxelMin + 1.0f, point, normal, depth)) {
+		point = clamp(stop, voxelMin, voxelMin + 1.0f);
+		normal = -m;
+	}
+	result.t = nearest;
+	result.point = grid.ToWorld(point);
+	result.normal = grid.ToWorldNormal(normal);
+	result.voxel = voxel;
+	result.worldIndex = worldIndex;
+	return result;
+}
+
+bool Tmpl8::VoxelCollision::OverlapSphere(const Scene& scene, const float3& center, const float radius, std::vector<VoxelContact>* contacts) {
+	return OverlapScene(scene, !contacts, [&](const VoxelWorld& world, const int worldIndex) {
+		return OverlapSphere(world, worldIndex, center, radius, contacts);
+	});
+}
+
+bool Tmpl8::VoxelCollision::OverlapBox(const Scene& scene, const float3& boxMin, const float3& boxMax, std::vector<VoxelContact>* contacts) {
+	return OverlapScene(scene, !contacts, [&](const VoxelWorld& world, const int worldIndex) {
+		return OverlapBox(world, worldIndex, boxMin, boxMax, contacts);
+	});
+}
+
+bool Tmpl8::VoxelCollision::OverlapCapsule(const Scene& scene, const float3& a, const float3& b, const float radius, std::vector<VoxelContact>* contacts) {
+	return OverlapScene(scene, !contacts, [&](const VoxelWorld& world, const int worldIndex) {
+		return OverlapCapsule(world, worldIndex, a, b, radius, contacts);
+	});
+}
+
+Tmpl8::VoxelSweepHit Tmpl8::VoxelCollision::SweepSphere(const Scene& scene, const float3& center, const float radius, const float3& motion) {
+	VoxelSweepHit nearest;
+	const std::vector<VoxelWorld*>& active = scene.worlds.GetActive();
+	const std::vector<int>& slots = scene.worlds.GetActiveSlots();
+	for (size_t i = 0; i < active.size(); i++) {
+		const VoxelSweepHit hit = SweepSphere(*active[i], slots[i], center, radius, motion);
+		if (hit.hit && (!nearest.hit || hit.t < nearest.t)) nearest = hit;
+	}
+	return nearest;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+namespace Tmpl8 {
+	class Scene;
+	class VoxelWorld;
+
+	// where a shape touches a solid voxel, in world space
+	struct VoxelContact {
+		float3 point;		// closest point on the voxel
+		float3 normal;		// out of the voxel, moving the shape along it by depth separates them
+		float depth;
+		int3 voxel;			// in the grid of the world
+		int worldIndex;
+	};
+
+	// the first solid voxel a moving sphere touches
+	struct VoxelSweepHit {
+		bool hit = false;
+		float t = 1.0f;			// fraction of the motion that is free, 1 without a hit
+		float3 point = float3(0);
+		float3 normal = float3(0);
+		int3 voxel = int3(0);
+		int worldIndex = -1;
+	};
+
+	// collision queries straight on brick occupancy instead of rays. shapes are taken into the voxel grid of every
+	// world with its inverse transform, empty and missing bricks are skipped as a whole and only the solid voxels
+	// near the shape are tested. worlds are treated as uniformly scaled, a stretched world uses its smallest scale.
+	// overlaps append a contact per solid voxel when contacts is given, without it they stop at the first one
+	namespace VoxelCollision {
+		bool OverlapSphere(const Scene& scene, const float3& center, const float radius, std::vector<VoxelContact>* contacts = nullptr);
+		// in a rotated world the box is tested as the box around its corners in the grid of that world
+		bool OverlapBox(const Scene& scene, const float3& boxMin, const float3& boxMax, std::vector<VoxelContact>* contacts = nullptr);
+		// the sphere swept from a to b
+		bool OverlapCapsule(const Scene& scene, const float3& a, const float3& b, const float radius, std::vector<VoxelContact>* contacts = nullptr);
+		// moves the sphere along motion and returns where it first touches a voxel, t is 0 when it already does
+		VoxelSweepHit SweepSphere(const Scene& scene, const float3& center, const float radius, const float3& motion);
+
+		// the same against a single world, worldIndex is only copied into the results
+		bool OverlapSphere(const VoxelWorld& world, const int worldIndex, const float3& center, const float radius, std::vector<VoxelContact>* contacts = nullptr);
+		bool OverlapBox(const VoxelWorld& world, const int worldIndex, const float3& boxMin, const float3& boxMax, std::vector<VoxelContact>* contacts = nullptr);
+		bool OverlapCapsule(const VoxelWorld& world, const int worldIndex, const float3& a, const float3& b, const float radius, std::vector<VoxelContact>* contacts = nullptr);
+		VoxelSweepHit SweepSphere(const VoxelWorld& world, const int worldIndex, const float3& center, const float radius, const float3& motion);
+	}
+}
@@ -0,0 +1,102 @@
+#include "precomp.h"
+
+WorldHandle WorldRegistry::Add(VoxelWorld* world) {
+	const int slot = TakeFreeSlot();
+	Activate(slot, world);
+	return GetHandle(slot);
+}
+
+int WorldRegistry::TakeFreeSlot() {
+	if (freeSlots.empty()) {
+		slots.emplace_back();
+		return static_cast<int>(slots.size()) - 1;
+	}
+	const int slot = freeSlots.back();
+	freeSlots.pop_back();
+	return slot;
+}
+
+void WorldRegistry::Place(const int slot, VoxelWorld* world) {
+	if (slot >= static_cast<int>(slots.size())) {
+		// the slots that get skipped over are free
+		const int first = static_cast<int>(slots.size());
+		slots.resize(slot + 1);
+		for (int i = slot - 1; i >= first; i--) {
+			freeSlots.insert(freeSlots.begin(), i);
+		}
+	} else {
+		freeSlots.erase(std::remove(freeSlots.begin(), freeSlots.end(), slot), freeSlots.end());
+	}
+	Activate(slot, world);
+}
+
+void WorldRegistry::Activate(const int slot, VoxelWorld* world) {
+	Slot& s = slots[slot];
+	s.world = world;
+	s.removed = false;
+	s.activeIndex = static_cast<int>(active.size());
+	active.push_back(world);
+	activeSlots.push_back(slot);
+}
+
+void WorldRegistry::Remove(const WorldHandle& handle) {
+	if (Get(handle)) Remove(handle.slot);
+}
+
+void WorldRegistry::Remove(const int slot) {
+	if (!(*this)[slot] || slots[slot].removed) return;
+	slots[slot].removed = true;
+	removedSlots.push_back(slot);
+}
+
+void WorldRegistry::Flush() {
+	for (const int slot : removedSlots) {
+		Slot& s = slots[slot];
+
+		// move the last active world into the gap
+		const int last = static_cast<int>(active.size()) - 1;
+		active[s.activeIndex] = active[last];
+		activeSlots[s.activeIndex] = activeSlots[last];
+		slots[activeSlots[s.activeIndex]].activeIndex = s.activeIndex;
+		active.pop_back();
+		activeSlots.pop_back();
+
+		VoxelWorld::Destroy(s.world);
+		s.world = nullptr;
+		s.activeIndex = -1;
+		s.removed = false;
+		s.generation++;
+		freeSlots.push_back(slot);
+	}
+	removedSlots.clear();
+}
+
+void WorldRegistry::Clear() {
+	for (VoxelWorld* world : active) {
+		VoxelWorld::Destroy(world);
+	}
+	active.clear();
+	activeSlots.clear();
+	removedSlots.clear();
+	freeSlots.clear();
+	// generations keep counting, so handles from before the clear stay invalid
+	for (int i = static_cast<int>(slots.size()) - 1; i >= 0; i--) {
+		Slot& s = slots[i];
+		if (s.world) s.generation++;
+		s.world = nullptr;
+		s.activeIndex = -1;
+		s.removed = false;
+		freeSlots.push_back(i);
+	}
+}
+
+VoxelWorld* WorldRegistry::Get(const WorldHandle& handle) const {
+	if (handle.slot < 0 || handle.slot >= static_cast<int>(slots.size())) return nullptr;
+	const Slot& s = slots[handle.slot];
+	return s.generation == handle.generation ? s.world : nullptr;
+}
+
+WorldHandle WorldRegistry::GetHandle(const int slot) const {
+	if (!(*this)[slot]) return WorldHandle();
+	return WorldHandle{ slot, slots[slot].generation };
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+namespace Tmpl8 {
+	class VoxelWorld;
+
+	// refers to a world for as long as it exists, a handle to a removed world stays invalid even when its slot is reused
+	struct WorldHandle {
+		int slot = -1;
+		uint generation = 0;
+
+		bool operator==(const WorldHandle& other) const { return slot == other.slot && generation == other.generation; }
+		bool operator!=(const WorldHandle& other) const { return !(*this == other); }
+	};
+
+	// slot map of the worlds in a scene. a world keeps its slot for its whole life, so the slot can be stored in rays,
+	// selections and edits without being shifted by other worlds going away. removal is deferred to Flush, which runs
+	// between frames, so rays that are being traced never see a world disappear. the active worlds are kept in a
+	// compact array for traversal, adding and removing are O(1)
+	class WorldRegistry {
+	public:
+		WorldRegistry() = default;
+		WorldRegistry(const WorldRegistry&) = delete;
+		WorldRegistry& operator=(const WorldRegistry&) = delete;
+
+		WorldHandle Add(VoxelWorld* world);
+		// puts a world in a specific free slot, for code that addresses worlds by slot before they exist
+		void Place(const int slot, VoxelWorld* world);
+		// the world stays in the scene until the next Flush
+		void Remove(const WorldHandle& handle);
+		void Remove(const int slot);
+		// destroys the removed worlds and frees their slots, call once per frame while no rays are traced
+		void Flush();
+		// destroys all worlds right away, slots are handed out from 0 again
+		void Clear();
+
+		// nullptr if the world was removed
+		VoxelWorld* Get(const WorldHandle& handle) const;
+		WorldHandle GetHandle(const int slot) const;
+		// nullptr for free slots
+		VoxelWorld* operator[](const int slot) const {
+			return slot >= 0 && slot < static_cast<int>(slots.size()) ? slots[slot].world : nullptr;
+		}
+
+		int GetSlotCount() const { return static_cast<int>(slots.size()); }
+		int GetActiveCount() const { return static_cast<int>(active.size()); }
+		bool IsEmpty() const { return active.empty(); }
+		// the worlds to traverse, activeSlots[i] is the slot of active[i]
+		const std::vector<VoxelWorld*>& GetActive() const { return active; }
+		const std::vector<int>& GetActiveSlots() const { return activeSlots; }
+
+	private:
+		struct Slot {
+			VoxelWorld* world = nullptr;
+			uint generation = 0;
+			int activeIndex = -1;
+			bool removed = false;
+		};
+		int TakeFreeSlot();
+		void Activate(const int slot, VoxelWorld* world);
+
+		std::vector<Slot> slots;
+		std::vector<int> freeSlots;		// used as a stack, Clear pushes them in reverse so slot 0 comes first
+		std::vector<VoxelWorld*> active;
+		std::vector<int> activeSlots;
+		std::vector<int> removedSlots;
+	};
+}
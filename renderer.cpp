@@ -1,4 +1,7 @@
 #include "precomp.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include <SvenUtils/InputManager.h>
 #include <SvenUtils/TweenUtils.h>
 #include "DirectionalLight.h"
@@ -73,6 +76,10 @@ extern Shader* shader;
 // Initialize the renderer
 // -----------------------------------------------------------
 void Renderer::Init() {
+	// the asset folders are scanned in the background while the rest starts up
+	AssetCatalog::GetInstance().Watch("assets");
+	AssetCatalog::GetInstance().Watch("assets/levels");
+
 	// create fp32 rgb pixel buffer to render to
 	reprojection = (float4*)MALLOC64(SCRWIDTH * SCRHEIGHT * 16);
 	prevReprojection = (float4*)MALLOC64(SCRWIDTH * SCRHEIGHT * 16);
@@ -103,6 +110,9 @@ void Renderer::Init() {
 	pointLight->quadraticTerm = 0.032f;
 	lights.push_back(pointLight);
 
+	// edited bricks make the accumulated frames stale
+	scene.Subscribe([this](const std::vector<BrickChange>&) { ResetAccumulation(); });
+
 	//const float3& position, const float2& size, const float3& rotation, const int& numSamples, const float3& color, float intensity
 	areaLight = std::make_shared<AreaLight>(float3(0.0f, 2.0f, 0.0f), float2(1.0f, 1.0f), float3(0.0f, 0.0f, 0.0f), 1, float3(1.0f), 0.0f);
 	areaLight->position = float3(-2.8f, 2.6f,-2.3f);
@@ -249,6 +259,9 @@ void Renderer::Init() {
 	//print result to avoid compiler optimization
 	printf("Result: %f, %f, %f\n", result.x, result.y, result.z);
 #endif
+#if 0
+	Benchmarks::Run(scene, camera);
+#endif
 }
 
 // -----------------------------------------------------------
@@ -260,14 +273,8 @@ void Renderer::Tick(float deltaTime) {
 	Timer t;
 
 
-	//settings.fps is how many times per second we want to update the cellular automata
-	if (settings.fps > 0) {
-		const float targetFrameTime = 1.0f / settings.fps;
-		if (time > targetFrameTime) {
-			HandleCellularAutomata();
-			time = 0;
-		}
-	}
+	//the cellular automata runs on its own thread, this picks up the newest generation before the frame is traced
+	HandleCellularAutomata();
 
 	sceneManager.Update(deltaTime);
 
@@ -300,6 +307,9 @@ void Renderer::Tick(float deltaTime) {
 		break;
 	default: break;
 	}
+	scene.FlushRemovals();
+	scene.UpdateStreaming(camera.camPos);
+	scene.FlushChanges();
 	RenderScreen(deltaDistance);
 
 	if (!CanSelectWorld) {
@@ -313,71 +323,50 @@ void Renderer::Tick(float deltaTime) {
 
 	camera.UpdatePrevState();
 	//PerformanceReport(t);
-	time += deltaTime;
 }
 
 void Tmpl8::Renderer::UpdateBallPhysics(float deltaTime) {
-	float3 ballPosition = ball.position;
-	float3 totalForce = float3(0, 0, 0); // Initialize a vector to accumulate forces from all directions
-
-	int rays = 100; // Total number of rays
-	float deltaTheta = 2.0f * PI / rays; // Azimuth angle step (in radians)
-	float deltaPhi = PI / (rays - 1.0f); // Inclination angle step (in radians), adjusted for full coverage
-
-	for (int i = 0; i < rays; ++i) {
-		for (int j = 0; j < rays; ++j) {
-			// Calculate spherical coordinates
-			float theta = i * deltaTheta;
-			float phi = j * deltaPhi - (PI / 2.0f); // Offset by PI/2 to start from the top
-
-			// Convert spherical coordinates to Cartesian coordinates for the ray direction
-			float3 rayDir = float3(
-				cos(phi) * sin(theta), // x
-				sin(phi),              // y
-				cos(phi) * cos(theta)  // z
-			);
-
-			// Create and cast the ray
-			Ray r = Ray(ballPosition, rayDir);
-			scene.FindNearest(r);
-			if (r.voxel != 0) {
-				float3 intersectionPoint = r.IntersectionPoint();
-				float distance = length(intersectionPoint - ballPosition);
-
-				// Check if the ray intersected within the ball's radius
-				if (distance < ball.radius) {
-					// Reflect the ray direction based on the surface normal at the intersection point
-					float3 normal = r.GetNormal();
-					float3 reflection = reflect(rayDir, normal);
-
-					// Accumulate the reflection force
-					totalForce += reflection * (ball.radius - distance);
-				}
-			}
-		}
-	}
+	const float timeStep = deltaTime / 1000.0f;
+	const float restitution = 0.9f; // how much of the speed into a surface is kept in a bounce
+
 	// Gravity vector (assuming the negative y-direction is downward)
 	const float3 gravity = float3(0, -9.81f, 0); // Adjust the magnitude as necessary
 
 	// Apply gravity to the ball's velocity
-	ball.velocity += gravity * (deltaTime / 1000.0f);
-
-	// Calculate reflection forces from rays (as previously described)
-	// Ensure totalForce is not a zero vector before normalizing
-	if (length(totalForce) > 0.0f) {
-		float3 normalizedForce = normalize(totalForce);
-		float magnitude = 0.01f; // Adjust this magnitude as necessary
-		ball.velocity += normalizedForce * magnitude;
+	ball.velocity += gravity * timeStep;
+
+	// move until the ball touches a voxel, bounce off it and slide the rest of the way along it
+	const float skin = ball.radius * 0.01f; // kept free so the next sweep doesn't start out touching
+	float3 motion = ball.velocity * timeStep;
+	for (int i = 0; i < 4 && sqrLength(motion) > 0.0f; i++) {
+		const VoxelSweepHit hit = VoxelCollision::SweepSphere(scene, ball.position, ball.radius, motion);
+		if (!hit.hit) {
+			ball.position += motion;
+			break;
+		}
+		ball.position += motion * max(hit.t - skin / length(motion), 0.0f);
+		const float speedIn = dot(ball.velocity, hit.normal);
+		if (speedIn < 0.0f) ball.velocity -= hit.normal * speedIn * (1.0f + restitution);
+		motion *= 1.0f - hit.t;
+		const float motionIn = dot(motion, hit.normal);
+		if (motionIn < 0.0f) motion -= hit.normal * motionIn;
+	}
+
+	// edits can put voxels inside the ball, push it out of the deepest one
+	ballContacts.clear();
+	if (VoxelCollision::OverlapSphere(scene, ball.position, ball.radius, &ballContacts)) {
+		const VoxelContact* deepest = &ballContacts[0];
+		for (const VoxelContact& contact : ballContacts) {
+			if (contact.depth > deepest->depth) deepest = &contact;
+		}
+		ball.position += deepest->normal * deepest->depth;
 	}
 
-	// Update the ball's position based on its velocity
-	ball.position += ball.velocity * (deltaTime / 1000.0f);
-
 	// Collision detection with the ground
 	float groundLevel = 0.0f; // Adjust this to your scene's ground level
 	if (ball.position.y < groundLevel + ball.radius) {
 		ball.position.y = groundLevel + ball.radius; // Adjust the ball's position to sit on the ground
-		ball.velocity.y *= -0.9f; // Reflect the y-velocity to simulate a bounce, adjust the coefficient as necessary
+		ball.velocity.y *= -restitution; // Reflect the y-velocity to simulate a bounce
 	}
 
 	// Optionally, apply damping to the velocity
@@ -410,6 +399,15 @@ void Renderer::RenderScreen(const float cameraDistance) {
 	const bool antiAliasing = settings.AntiAliasing;
 	const bool jitter = settings.Jitter;
 
+	// primary rays only come out the same every frame without jitter, anti aliasing or depth of field
+	const bool noEffect = reprojectionEnabled || (!antiAliasing && !jitter);
+	PrimaryHitCache* cache = nullptr;
+	if (settings.CachePrimaryHits && noEffect && !camera.depthOfField && primaryHits.BeginFrame(camera, scene)) {
+		cache = &primaryHits;
+	} else {
+		primaryHits.Invalidate();
+	}
+
 #pragma omp parallel for schedule(dynamic)
 	for (int y = 0; y < SCRHEIGHT; y++) {
 		for (int x = 0; x < SCRWIDTH; x++) {
@@ -426,7 +424,7 @@ void Renderer::RenderScreen(const float cameraDistance) {
 			PixelInfo currentPixel(x, y);
 
 			if (reprojectionEnabled) {
-				NoEffect(currentPixel);
+				NoEffect(currentPixel, cache);
 				// far away pixels are not reprojected to avoid ghosting/motion blur with the reprojection
 				if (currentPixel.ray.t > 5.0f) {
 					float4 color = ToneMapping(float4(currentPixel.color, 0), exposure, toneMapping);
@@ -438,7 +436,7 @@ void Renderer::RenderScreen(const float cameraDistance) {
 			} else if (jitter) {
 				ApplyJitter(currentPixel);
 			} else {
-				NoEffect(currentPixel);
+				NoEffect(currentPixel, cache);
 			}
 
 			//clamp the color to avoid fireflies
@@ -590,8 +588,12 @@ inline float4 Tmpl8::Renderer::ApplyReprojection(PixelInfo& currentPixel, const
 	return currentPixel.color;
 }
 
-void Tmpl8::Renderer::NoEffect(PixelInfo& currentPixel) const {
+void Tmpl8::Renderer::NoEffect(PixelInfo& currentPixel, PrimaryHitCache* cache) const {
 	currentPixel.ray = camera.GetPrimaryRay((float)currentPixel.x, (float)currentPixel.y);
+	if (cache) {
+		cache->FindNearest(scene, currentPixel.ray, currentPixel.x + currentPixel.y * SCRWIDTH);
+		currentPixel.traced = true;
+	}
 	Trace(currentPixel);
 	return;
 }
@@ -630,13 +632,12 @@ void Renderer::ApplyJitter(PixelInfo& currentPixel) const {
 // Evaluate light transport
 // -----------------------------------------------------------
 void Renderer::Trace(PixelInfo& currentPixel) const {
+	if (!currentPixel.traced) scene.FindNearest(currentPixel.ray);
 	if (settings.PathTracing) {
 		currentPixel.color = PerformPathTracing(currentPixel, 0);
 		return;
 	}
 	if (settings.StepThrough) {
-		scene.FindNearest(currentPixel.ray);
-
 		if (currentPixel.ray.steps == 0) {
 			currentPixel.color = GetEnvironmentLight(currentPixel.ray);
 			return;
@@ -648,7 +649,6 @@ void Renderer::Trace(PixelInfo& currentPixel) const {
 	}
 
 	if (settings.Normals) {
-		scene.FindNearest(currentPixel.ray);
 		if (currentPixel.ray.voxel == 0) {
 			currentPixel.color = GetEnvironmentLight(currentPixel.ray);
 			return;
@@ -658,7 +658,6 @@ void Renderer::Trace(PixelInfo& currentPixel) const {
 	}
 
 	if (settings.UV) {
-		scene.FindNearest(currentPixel.ray);
 		if (currentPixel.ray.voxel == 0) {
 			currentPixel.color = GetEnvironmentLight(currentPixel.ray);
 		}
@@ -673,7 +672,8 @@ void Renderer::Trace(PixelInfo& currentPixel) const {
 
 
 float3 Renderer::PerformPathTracing(PixelInfo& currentPixel, int depth) const {
-	scene.FindNearest(currentPixel.ray);
+	// the primary ray comes in traced, see Trace
+	if (depth > 0) scene.FindNearest(currentPixel.ray);
 
 	float3 floorColor;
 	if (settings.RenderFloor && IsLookingAtFloor(currentPixel.ray, floorColor)) {
@@ -688,11 +688,12 @@ float3 Renderer::PerformPathTracing(PixelInfo& currentPixel, int depth) const {
 		return float3(0); // Terminate the path early
 	}
 
-	const Material& material = currentPixel.ray.GetMaterial();
+	const SurfaceInfo surface = currentPixel.ray.ComputeSurface();
+	const Material& material = *surface.material;
 	const float3 intersectionPoint = currentPixel.ray.IntersectionPoint();
-	const float3 normal = currentPixel.ray.GetNormal();
+	const float3 normal = surface.normal;
 	currentPixel.depth = length(intersectionPoint - camera.camPos);
-	const float3 albedo = currentPixel.ray.GetAlbedo();
+	const float3 albedo = surface.albedo;
 	const float3 emission = material.GetEmission();
 	const float3 viewDir = -currentPixel.ray.D;
 
@@ -761,15 +762,16 @@ float3 Renderer::PerformPathTracing(PixelInfo& currentPixel, int depth) const {
 	return outRadiance;
 }
 
+// the ray has to be traced already
 float3 Renderer::PerformSimpleRendering(Ray& ray) const {
-	scene.FindNearest(ray);
 	if (ray.voxel == 0) {
 		return GetEnvironmentLight(ray);
 	}
 
+	const SurfaceInfo surface = ray.ComputeSurface();
 	float3 I = ray.IntersectionPoint();
-	float3 N = ray.GetNormal();
-	float3 albedo = ray.GetAlbedo();
+	float3 N = surface.normal;
+	float3 albedo = surface.albedo;
 
 	float3 directLighting = CalculateDirectLighting(ray, I, N);
 	return directLighting * albedo;
@@ -882,6 +884,8 @@ void Renderer::DrawBasicInfoImguiWindow() {
 	//fps and ms
 	ImGui::Text("FPS: %f", fps);
 	ImGui::Text("MS: %f", ms);
+	if (primaryHits.IsEnabled()) ImGui::Text("Primary Hit Cache: %.1f%%", primaryHits.GetHitRate() * 100.0f);
+	else ImGui::Text("Primary Hit Cache: off");
 	ImGui::Text("voxel: %i", r.voxel);
 	ImGui::Text("voxel: %i", r.index);
 	ImGui::Text("world: %i", r.worldIndex);
@@ -987,16 +991,19 @@ void Tmpl8::Renderer::DrawCellularAutomataImguiWindow() {
 	bool changed = false;
 
 	ImGui::SliderFloat("probability", &settings.probablity, 0, 1);
+	//grid size in bricks, used by the next randomize
+	ImGui::DragInt3("Grid Size", &settings.AutomataGridSize.x, 1, 1, 64);
 	//radius
-	ImGui::DragInt("Radius", &settings.radius, 1, 0, WORLDSIZE);
+	const int3 gridSize = settings.AutomataGridSize;
+	ImGui::DragInt("Radius", &settings.radius, 1, 0, max(gridSize.x, max(gridSize.y, gridSize.z)) * BRICKSIZE / 2);
 	if (ImGui::Button("Randomize")) {
 		changed = true;
 		RandomizeCellularAutomata();
 	}
 
-	if (ImGui::Button("iterate")) {
+	if (ImGui::Button("iterate") && automata) {
 		changed = true;
-		HandleCellularAutomata();
+		automata->StepOnce();
 	}
 
 	if (ImGui::Button("Clear")) {
@@ -1004,6 +1011,17 @@ void Tmpl8::Renderer::DrawCellularAutomataImguiWindow() {
 		ClearCellularAutomata();
 	}
 
+	if (automata) {
+		const AutomataSimulation::Stats stats = automata->GetStats();
+		ImGui::Text("Generation: %u", stats.generation);
+		ImGui::Text("Simulation Rate: %.1f generations/s", stats.rate);
+		ImGui::Text("Queued Generations: %d / %d", stats.queued, AutomataSimulation::MaxQueued);
+		ImGui::Text("Alive Cells: %lld", stats.aliveCount);
+		ImGui::Text("Active Regions: %d / %d", stats.activeRegions, stats.regionCount);
+		ImGui::Text("Step Time: %.2f ms", stats.stepTime * 1000.0f);
+		ImGui::Text("Write Time: %.2f ms", stats.writeTime * 1000.0f);
+	}
+
 	//dropdown for checkboxes
 
 	if (ImGui::CollapsingHeader("Survival Settings")) {
@@ -1020,7 +1038,31 @@ void Tmpl8::Renderer::DrawCellularAutomataImguiWindow() {
 		}
 	}
 
-	ImGui::DragInt("StartState", &settings.StartState, 1, 1, 10);
+	ImGui::DragInt("StartState", &settings.StartState, 1, 1, 64);
+
+	const char* neighbourhoods[] = { "Moore", "Von Neumann", "Custom" };
+	ImGui::Combo("Neighbourhood", &settings.NeighbourHood, neighbourhoods, IM_ARRAYSIZE(neighbourhoods));
+	if (settings.NeighbourHood == NeighbourHood::Custom) {
+		//one 3x3 grid of checkboxes per z layer, the center cell is never its own neighbour
+		for (int z = 0; z < 3; z++) {
+			ImGui::Text("z %d", z - 1);
+			for (int y = 0; y < 3; y++) {
+				for (int x = 0; x < 3; x++) {
+					const int i = x + y * 3 + z * 9;
+					if (x > 0) ImGui::SameLine();
+					ImGui::PushID(i);
+					if (i == 13) {
+						bool center = false;
+						ImGui::BeginDisabled();
+						ImGui::Checkbox("##kernel", &center);
+						ImGui::EndDisabled();
+					}
+					else ImGui::Checkbox("##kernel", &settings.CustomKernel[i]);
+					ImGui::PopID();
+				}
+			}
+		}
+	}
 	ImGui::DragFloat("ticks per second", &settings.fps, 1, 0, 100);
 
 	return;
@@ -1108,13 +1150,18 @@ void Renderer::DrawWorldSettingsImguiWindow() {
 
 	//get the world
 	VoxelWorld* world = scene.worlds[selectedWorld];
+	if (!world) {
+		selectedWorld = -1;
+		ImGui::End();
+		return;
+	}
 	bool changed = false;
 
 
 	changed |= world->DrawImGui(0);
 	std::string deleteLabel = "Delete World##" + std::to_string(selectedWorld);
 	if (ImGui::Button(deleteLabel.c_str())) {
-		scene.worlds.erase(scene.worlds.begin() + selectedWorld);
+		scene.RemoveWorld(scene.worlds.GetHandle(selectedWorld));
 		selectedWorld = -1;
 		changed = true;
 	}
@@ -1123,23 +1170,21 @@ void Renderer::DrawWorldSettingsImguiWindow() {
 		if (ImGui::BeginTabItem("Models")) {
 
 
-			// Read all the .vox files in the assets folder and store them in a vector
-			std::vector<std::string> voxFiles;
-			for (const auto& entry : std::filesystem::directory_iterator("assets")) {
-				if (entry.path().extension() == ".vox") {
-					voxFiles.push_back(entry.path().filename().string());
-				}
-			}
+			// the .vox files in the assets folder, kept up to date by the catalog
+			std::shared_ptr<const AssetList> voxFiles = AssetCatalog::GetInstance().GetList("assets", ".vox");
 
 			// Dropdown for selecting .vox file
 			static int selectedItem = -1; // Index of the selected item in the combo box
-			if (!voxFiles.empty()) {
-				std::vector<const char*> cStrVoxFiles; // ImGui needs const char* array
-				for (const auto& file : voxFiles) {
-					cStrVoxFiles.push_back(file.c_str());
+			if (selectedItem >= static_cast<int>(voxFiles->names.size())) selectedItem = -1;
+			if (!voxFiles->IsEmpty()) {
+				// start reading the file as soon as it is picked, it is usually in memory by the time a button is pressed
+				if (ImGui::Combo("Vox Files", &selectedItem, voxFiles->items.data(), static_cast<int>(voxFiles->items.size())) && selectedItem >= 0) {
+					AssetCatalog::GetInstance().Preload(voxFiles->GetPath(selectedItem));
 				}
-
-				ImGui::Combo("Vox Files", &selectedItem, &cStrVoxFiles[0], static_cast<int>(cStrVoxFiles.size()) - 1);
+			}
+			VoxInfo voxInfo;
+			if (selectedItem >= 0 && AssetCatalog::GetInstance().GetVoxInfo(voxFiles->GetPath(selectedItem), voxInfo)) {
+				ImGui::Text("%i models, largest %ix%ix%i, %.1f MB", voxInfo.modelCount, voxInfo.size.x, voxInfo.size.y, voxInfo.size.z, static_cast<double>(voxInfo.fileSize) / (1024.0 * 1024.0));
 			}
 
 			// Position input for the .vox file
@@ -1147,14 +1192,14 @@ void Renderer::DrawWorldSettingsImguiWindow() {
 
 			if (ImGui::Button("Draw Vox File") && selectedItem >= 0) {
 				// Load the selected .vox file
-				std::string path = "assets/" + voxFiles[selectedItem];
+				std::string path = voxFiles->GetPath(selectedItem);
 				DrawVoxFile(scene, path.c_str(), settings.VoxelFilePosition, selectedWorld);
 				changed = true;
 			}
 
 			if (ImGui::Button("Load Vox File") && selectedItem >= 0) {
 				// Load the selected .vox file
-				std::string path = "assets/" + voxFiles[selectedItem];
+				std::string path = voxFiles->GetPath(selectedItem);
 				LoadVoxFile(scene, path.c_str());
 				changed = true;
 			}
@@ -1171,6 +1216,9 @@ void Renderer::DrawWorldSettingsImguiWindow() {
 void Renderer::Shutdown() {
 
 	sceneManager.Destroy();
+	AssetCatalog::GetInstance().Stop();
+	delete automata;
+	automata = nullptr;
 
 	// save current camera
 	FILE* f = fopen("camera.bin", "wb");
@@ -1191,7 +1239,7 @@ void Renderer::HandleUserInput() {
 		PixelInfo currentPixel;
 		currentPixel.ray = r;
 
-		scene.FindNearest(r);
+		scene.FindNearest(currentPixel.ray);
 		float4 color = PerformPathTracing(currentPixel, 0);
 	}
 
@@ -1212,10 +1260,8 @@ Ray Renderer::GetMouseRay() const {
 void Renderer::DebugDraw() {
 	//if (!settings.DebugDraw) return;
 
-	int index = 0;
-	for (auto& world : scene.worlds) {
-
-		if (index++ != selectedWorld) continue;
+	VoxelWorld* world = scene.worlds[selectedWorld];
+	if (world) {
 		std::vector<float3> corners = world->GetCorners();
 		DrawLine(corners[0], corners[1], float4(1, 0, 0, 1));
 		DrawLine(corners[0], corners[2], float4(1, 0, 0, 1));
@@ -1389,132 +1435,46 @@ void Renderer::HandleCamera() {
 }
 
 void Tmpl8::Renderer::HandleCellularAutomata() {
-	if (scene.worlds.empty()) return;
-	VoxelWorld* world = scene.worlds[0];
-	if (world == nullptr) return;
-
-	std::vector<int3> NeighbourOffsets;
-	if (settings.NeighbourHood == NeighbourHood::VonNeumann) {
-		NeighbourOffsets = std::vector<int3>(
-			{ int3(0, 0, 1), int3(0, 0, -1), int3(1, 0, 0), int3(-1, 0, 0), int3(0, 1, 0), int3(0, -1, 0) }
-		);
-	} else {
-		NeighbourOffsets = std::vector<int3>(
-			{ int3(0, 0, 1), int3(0, 0, -1), int3(1, 0, 0), int3(-1, 0, 0), int3(0, 1, 0), int3(0, -1, 0),
-						int3(1, 1, 0), int3(1, -1, 0), int3(-1, 1, 0), int3(-1, -1, 0),
-						int3(1, 1, 1), int3(1, 1, -1), int3(1, -1, 1), int3(1, -1, -1),
-						int3(-1, 1, 1), int3(-1, 1, -1), int3(-1, -1, 1), int3(-1, -1, -1) }
-		);
+	if (automata == nullptr) return;
+	// the simulation goes away with its world
+	VoxelWorld* world = scene.worlds.Get(automataWorld);
+	if (world == nullptr) {
+		delete automata;
+		automata = nullptr;
+		return;
 	}
 
-	bool survival[26];
-	memcpy(survival, settings.Survival, 26 * sizeof(bool));
-	bool spawn[26];
-	memcpy(spawn, settings.Spawn, 26 * sizeof(bool));
-	const int startState = settings.StartState;
-
-	int3 dimensions = world->gridDimensions * BRICKSIZE;
-
-	memset(newCellStates, 0, dimensions.x * dimensions.y * dimensions.z * sizeof(int));
-
-#pragma omp parallel for schedule(dynamic)
-	for (int x = 0; x < dimensions.x; x++) {
-		for (int y = 0; y < dimensions.y; y++) {
-			for (int z = 0; z < dimensions.z; z++) {
-
-				int index = x + y * dimensions.x + z * dimensions.x * dimensions.y;
-				int state = cellStates[index];
-
-				int count = 0;
-				const int3 pos = int3(x, y, z);
-				for (const auto& offset : NeighbourOffsets) {
-					int3 neighbourPos = pos + offset;
-					//if out of bounds, go to the other side
-					if (neighbourPos.x < 0) neighbourPos.x = dimensions.x - 1;
-					if (neighbourPos.y < 0) neighbourPos.y = dimensions.y - 1;
-					if (neighbourPos.z < 0) neighbourPos.z = dimensions.z - 1;
-					if (neighbourPos.x >= dimensions.x) neighbourPos.x = 0;
-					if (neighbourPos.y >= dimensions.y) neighbourPos.y = 0;
-					if (neighbourPos.z >= dimensions.z) neighbourPos.z = 0;
-
-
-					int neighbourIndex = neighbourPos.x + neighbourPos.y * dimensions.x + neighbourPos.z * dimensions.x * dimensions.y;
-					if (cellStates[neighbourIndex] == startState - 1) {
-						count++;
-					}
-				}
-
-				if (state == 0) {
-					if (spawn[count]) {
-						newCellStates[index] = startState - 1;
-					}
-				} else {
-					if (survival[count] && state == startState - 1) {
-						newCellStates[index] = state;
-					} else {
-						newCellStates[index] = state - 1;
-					}
-
-				}
-				//set color gradient based on state, red is alive, yellow is dying
-				uint color;
-				if (newCellStates[index] == 0) {
-					color = 0;
-				} else {
-					float t = (float)newCellStates[index] / (float)startState;
-					float4 c = lerp(float4(1, 0, 0, 1), float4(1, 1, 0, 1), t);
-					color = RGBF32_to_RGB8(&c);
-				}
+	//settings.fps is how many times per second we want to update the cellular automata
+	automata->SetRules(settings.Survival, settings.Spawn, settings.StartState, GetAutomataKernel());
+	automata->SetRate(settings.fps);
+	automata->Present(world);
+}
 
-				world->Set(x, y, z, color);
-			}
-		}
-	}
 
-	//swap the arrays
-	std::swap(cellStates, newCellStates);
+std::vector<int3> Tmpl8::Renderer::GetAutomataKernel() const {
+	if (settings.NeighbourHood == NeighbourHood::Custom) return AutomataEngine::MakeKernel(settings.CustomKernel);
+	return AutomataEngine::GetKernel(settings.NeighbourHood);
 }
 
-
 void Tmpl8::Renderer::RandomizeCellularAutomata() {
-	cellStates = (int*)MALLOC64(WORLDSIZE * WORLDSIZE * WORLDSIZE * 4);
-	newCellStates = (int*)MALLOC64(WORLDSIZE * WORLDSIZE * WORLDSIZE * 4);
-	memset(cellStates, 0, WORLDSIZE * WORLDSIZE * WORLDSIZE * 4);
-	memset(newCellStates, 0, WORLDSIZE * WORLDSIZE * WORLDSIZE * 4);
+	delete automata;
 
-	//resize world
+	//resize world, the automaton is as large as the world's grid
 	scene.CLearWorlds();
-	int3 gridSize = int3(WORLDSIZE / BRICKSIZE);
-	//scene.worlds[0]->Resize(gridSize);
-	//scene.worlds[0]->Clear(0);
 	VoxelWorld* world = new VoxelWorld();
-	world->Resize(gridSize);
-	scene.worlds.push_back(world);
-
-	const int radius = settings.radius;
-	const int3 center = WORLDSIZE / 2;
-	const int3 start = center - radius;
-	const int3 end = center + radius;
-	//randomize the cell states
-	for (int x = start.x; x < end.x; x++) {
-		for (int y = start.y; y < end.y; y++) {
-			for (int z = start.z; z < end.z; z++) {
-				const int index = x + y * WORLDSIZE + z * WORLDSIZE * WORLDSIZE;
-				const int random = RandomFloat() > settings.probablity ? 0 : 1;
-
-				cellStates[index] = random == 0 ? 0 : settings.StartState;
-				uint color = random == 0 ? 0x000000 : 0xff0000;
-				scene.worlds[0]->Set(x, y, z, color);
-			}
-		}
-	}
+	world->Resize(clamp(settings.AutomataGridSize, 1, 64));
+	automata = new AutomataSimulation(world->gridDimensions * BRICKSIZE);
+	// the engine rounds the width up to whole words
+	const int3 dimensions = automata->GetDimensions();
+	world->Resize(int3(dimensions.x / BRICKSIZE, dimensions.y / BRICKSIZE, dimensions.z / BRICKSIZE));
+	automataWorld = scene.worlds.Add(world);
+
+	automata->SetRules(settings.Survival, settings.Spawn, settings.StartState, GetAutomataKernel());
+	automata->Randomize(int3(dimensions.x / 2, dimensions.y / 2, dimensions.z / 2), settings.radius, settings.probablity);
 }
 
 void Tmpl8::Renderer::ClearCellularAutomata() {
-	memset(cellStates, 0, WORLDSIZE * WORLDSIZE * WORLDSIZE * 4);
-	memset(newCellStates, 0, WORLDSIZE * WORLDSIZE * WORLDSIZE * 4);
-
-	scene.worlds[0]->Clear(0);
+	if (automata) automata->Clear();
 }
 
 void Renderer::ResetAccumulation() {
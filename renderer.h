@@ -12,6 +12,7 @@ struct PixelInfo {
 	float depth, dummy; // 8 bytes
 	float4 color; // 16 bytes
 	Ray ray; // 196 bytes
+	bool traced = false; // the ray already holds its nearest hit, from the primary hit cache
 
 	PixelInfo() : x(0), y(0), color(float4(0)), depth(0) {}
 	PixelInfo(uint x, uint y) : x(x), y(y) {}
@@ -40,6 +41,7 @@ namespace Tmpl8 {
 		void Init();
 		void Trace(PixelInfo& currentPixel) const;
 		void Tick(float deltaTime);
+		// not called yet: the ball isn't drawn or owned by any scene, a scene that adds one ticks it from its Update
 		void UpdateBallPhysics(float deltaTime);
 		void PerformanceReport(Timer& t);
 		void RenderScreen(const float cameraDistance);
@@ -48,7 +50,7 @@ namespace Tmpl8 {
 
 		inline float4 ApplyReprojection(PixelInfo& currentPixel, const float& cameraDepthDelta, const float& depthThreshold, const float& blendFactor) const;
 
-		void NoEffect(PixelInfo& currentPixel) const;
+		void NoEffect(PixelInfo& currentPixel, PrimaryHitCache* cache = nullptr) const;
 		void ApplyAntiAliasing(PixelInfo& currentPixel) const;
 		void ApplyJitter(PixelInfo& currentPixel) const;
 		void DrawLine(const float3& from, const float3& to, const float4 color = float4(1, 0, 0, 0), const bool override = false, const float duration = 0.0f);
@@ -101,18 +103,21 @@ namespace Tmpl8 {
 
 		float fps = 0.0f;
 		float ms = 0.0f;
-		float time = 0.0f;
 
 		Sphere ball;
+		std::vector<VoxelContact> ballContacts;
 
-		int* cellStates;
-		int* newCellStates;
+		PrimaryHitCache primaryHits;
+
+		AutomataSimulation* automata = nullptr;
+		WorldHandle automataWorld;
 		void HandleUserInput();
 		void PlaceShapeAtMouse();
 		void SelectWorld();
 		void HandleCamera();
 
 		void HandleCellularAutomata();
+		std::vector<int3> GetAutomataKernel() const;
 		void RandomizeCellularAutomata();
 		void ClearCellularAutomata();
 
@@ -13,6 +13,13 @@
 #include <assert.h>
 #include <io.h>
 #include <filesystem>
+#include <atomic>
+#include <functional>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <map>
+#include <unordered_map>
 
 
 
@@ -426,11 +433,17 @@ struct Line {
 
 
 #include "tools/ogt_vox.h"
+#include "AssetCatalog.h"
 #include "Material.h"
 #include "ImGuiExtensions.h"
 #include "Shapes.h"
+#include "WorldRegistry.h"
+#include "RayBatch.h"
 #include "GameScene.h"
 #include "PuzzleLevel.h"
+#include "LevelCache.h"
+#include "LevelSolver.h"
+#include "LevelGenerator.h"
 #include "PuzzleScene.h"
 #include "CellularAutomata.h"
 #include "FreeCam.h"
@@ -439,9 +452,18 @@ struct Line {
 #include "Morton.h"
 #include "ToneMapping.h"
 #include "Cube.h"
+#include "InstancePool.h"
 #include "scene.h"
+#include "BrickStreamer.h"
+#include "BrickPager.h"
+#include "SceneFile.h"
+#include "VoxelCollision.h"
+#include "AutomataEngine.h"
+#include "AutomataSimulation.h"
 
 #include "camera.h"
+#include "PrimaryHitCache.h"
+#include "Benchmarks.h"
 #include "renderer.h"
 #include "Light.h"
 #include "Color.h"
@@ -1,7 +1,6 @@
 #include "precomp.h"
 Scene::Scene() {
-	worlds = std::vector<VoxelWorld*>(1);
-	worlds[0] = new VoxelWorld();
+	worlds.Add(new VoxelWorld());
 #ifdef TWOLEVEL
 
 	//bricks = (Brick*)MALLOC64(GRIDSIZE3 * sizeof(Brick*));
@@ -18,54 +17,127 @@ Scene::Scene() {
 
 void Scene::GenerateGrid() {
 	//for each world call the generate grid function
-	for (int i = 0; i < worlds.size(); i++) {
-		if (worlds[i]) {
-			worlds[i]->GenerateGrid();
-		} else {
-			worlds[i] = new VoxelWorld();
-			worlds[i]->GenerateGrid();
-		}
+	for (VoxelWorld* world : worlds.GetActive()) {
+		world->GenerateGrid();
 	}
 }
 
 void Scene::Set(const uint x, const uint y, const uint z, const uint v, const int materialIndex, const int worldIndex) {
-	VoxelWorld* w = worlds[worldIndex];
+	GetWorld(worldIndex)->Set(x, y, z, v, materialIndex);
+}
+
+void Tmpl8::Scene::ConstructBVH() {
+
+}
+
+void Tmpl8::Scene::FlushChanges() {
+	changes.clear();
+	// instances share a store, its changes are taken once and every world that shows them reports them at its own place
+	const std::vector<VoxelWorld*>& active = worlds.GetActive();
+	const std::vector<int>& slots = worlds.GetActiveSlots();
+	storeOrder.clear();
+	for (size_t i = 0; i < active.size(); i++) {
+		storeOrder.emplace_back(active[i]->store.get(), static_cast<int>(i));
+	}
+	std::sort(storeOrder.begin(), storeOrder.end(), [](const std::pair<BrickStore*, int>& a, const std::pair<BrickStore*, int>& b) {
+		return std::less<BrickStore*>()(a.first, b.first) || (a.first == b.first && a.second < b.second);
+	});
+	for (size_t first = 0, last; first < storeOrder.size(); first = last) {
+		for (last = first + 1; last < storeOrder.size() && storeOrder[last].first == storeOrder[first].first; last++);
+		storeOrder[first].first->TakeChanges(storeChanges);
+		if (storeChanges.empty()) continue;
+		for (size_t i = first; i < last; i++) {
+			const int activeIndex = storeOrder[i].second;
+			active[activeIndex]->CollectChanges(slots[activeIndex], storeChanges, changes);
+		}
+	}
+
+	if (changes.empty()) return;
+	for (const auto& subscriber : subscribers) {
+		subscriber.second(changes);
+	}
+}
 
+int Tmpl8::Scene::Subscribe(const BrickChangeCallback& callback) {
+	subscribers.emplace_back(nextSubscriberId, callback);
+	return nextSubscriberId++;
+}
+
+void Tmpl8::Scene::Unsubscribe(const int id) {
+	subscribers.erase(std::remove_if(subscribers.begin(), subscribers.end(),
+		[id](const std::pair<int, BrickChangeCallback>& subscriber) { return subscriber.first == id; }), subscribers.end());
+}
+
+void Tmpl8::Scene::UpdateStreaming(const float3& cameraPosition) {
+	for (VoxelWorld* world : worlds.GetActive()) {
+		if (world->streamer) {
+			world->streamer->Update(cameraPosition);
+		}
+		if (world->pager) {
+			world->pager->Update(cameraPosition);
+		}
+	}
+}
+
+VoxelWorld* Tmpl8::Scene::GetWorld(const int worldIndex) {
+	VoxelWorld* w = worlds[worldIndex];
 	if (!w) {
 		// create a new world
 		w = new VoxelWorld();
-		worlds[worldIndex] = w;
+		worlds.Place(worldIndex, w);
 	}
+	return w;
+}
 
-	w->Set(x, y, z, v, materialIndex);
+void Tmpl8::Scene::FillBox(const int3& min, const int3& max, const uint v, const int materialIndex, const int worldIndex) {
+	GetWorld(worldIndex)->FillBox(min, max, v, materialIndex);
 }
 
-void Tmpl8::Scene::ConstructBVH() {
+void Tmpl8::Scene::FillSphere(const int3& center, const float radius, const uint v, const int materialIndex, const int worldIndex, const float probability) {
+	GetWorld(worldIndex)->FillSphere(center, radius, v, materialIndex, probability);
+}
+
+void Tmpl8::Scene::CsgSphere(const CsgOp op, const float3& center, const float radius, const uint v, const int materialIndex, const int worldIndex, const float probability, const uint seed) {
+	GetWorld(worldIndex)->CsgSphere(op, center, radius, v, materialIndex, probability, seed);
+}
+
+void Tmpl8::Scene::CsgBox(const CsgOp op, const int3& min, const int3& max, const uint v, const int materialIndex, const int worldIndex, const float probability, const uint seed) {
+	GetWorld(worldIndex)->CsgBox(op, min, max, v, materialIndex, probability, seed);
+}
 
+void Tmpl8::Scene::SetVoxels(std::vector<VoxelEdit>& edits, const int worldIndex) {
+	GetWorld(worldIndex)->SetVoxels(edits);
 }
 
 void Tmpl8::Scene::CLearWorlds() {
 	//delete all worlds
-	for (int i = 0; i < worlds.size(); i++) {
-		if (worlds[i]) {
-			delete worlds[i];
-		}
-	}
-	worlds.clear();
+	worlds.Clear();
+}
+
+WorldHandle Tmpl8::Scene::SpawnInstance(const VoxelWorld& prefab) {
+	if (prefab.streamer || prefab.pager) return WorldHandle();
+	return worlds.Add(instances.Acquire(prefab));
+}
+
+void Tmpl8::Scene::RemoveWorld(const WorldHandle& handle) {
+	worlds.Remove(handle);
+}
+
+void Tmpl8::Scene::FlushRemovals() {
+	worlds.Flush();
 }
 
 void Scene::FindNearestEmpty(Ray& ray) const {
 	float nearest = 1e34f;
 	Ray nearestRay = ray;
-	for (int i = 0; i < worlds.size(); i++) {
-		if (worlds[i]) {
-			Ray copy = ray;
-			worlds[i]->FindNearestEmpty(copy);
-			copy.worldIndex = i;
-			if (copy.t <= nearest) {
-				nearest = copy.t;
-				nearestRay = copy;
-			}
+	const std::vector<VoxelWorld*>& active = worlds.GetActive();
+	for (size_t i = 0; i < active.size(); i++) {
+		Ray copy = ray;
+		active[i]->FindNearestEmpty(copy);
+		copy.worldIndex = worlds.GetActiveSlots()[i];
+		if (copy.t <= nearest) {
+			nearest = copy.t;
+			nearestRay = copy;
 		}
 	}
 	ray = nearestRay;
@@ -75,17 +147,16 @@ void Scene::FindNearest(Ray& ray) const {
 	float nearest = 1e34f;
 	Ray nearestRay = ray;
 	int mostSteps = 0;
-	for (int i = 0; i < worlds.size(); i++) {
-		if (worlds[i]) {
-			Ray copy = ray;
-			worlds[i]->FindNearest(copy);
-			copy.worldIndex = i;
-			if (copy.t <= nearest) {
-				nearest = copy.t;
-				nearestRay = copy;
-				if (copy.steps > mostSteps) {
-					mostSteps = copy.steps;
-				}
+	const std::vector<VoxelWorld*>& active = worlds.GetActive();
+	for (size_t i = 0; i < active.size(); i++) {
+		Ray copy = ray;
+		active[i]->FindNearest(copy);
+		copy.worldIndex = worlds.GetActiveSlots()[i];
+		if (copy.t <= nearest) {
+			nearest = copy.t;
+			nearestRay = copy;
+			if (copy.steps > mostSteps) {
+				mostSteps = copy.steps;
 			}
 		}
 	}
@@ -97,17 +168,16 @@ void Scene::FindNearest(Ray& ray) const {
 bool Scene::IsOccluded(Ray& ray) const {
 	float nearest = 1e34f;
 	Ray nearestRay = ray;
-	for (int i = 0; i < worlds.size(); i++) {
-		if (worlds[i]) {
-			Ray copy = ray;
-			bool occluded = worlds[i]->IsOccluded(copy);
-			copy.worldIndex = i;
-			if (occluded) {
-				nearest = copy.t;
-				nearestRay = copy;
-				ray = nearestRay;
-				return true;
-			}
+	const std::vector<VoxelWorld*>& active = worlds.GetActive();
+	for (size_t i = 0; i < active.size(); i++) {
+		Ray copy = ray;
+		bool occluded = active[i]->IsOccluded(copy);
+		copy.worldIndex = worlds.GetActiveSlots()[i];
+		if (occluded) {
+			nearest = copy.t;
+			nearestRay = copy;
+			ray = nearestRay;
+			return true;
 		}
 	}
 	ray = nearestRay;
@@ -115,10 +185,127 @@ bool Scene::IsOccluded(Ray& ray) const {
 }
 
 bool Tmpl8::Scene::IsOccluded(Ray& ray, const int worldIndex) const {
-	if (worldIndex < 0 || worldIndex >= worlds.size()) {
+	const VoxelWorld* world = worlds[worldIndex];
+	if (!world) {
 		return false;
 	}
-	return worlds[worldIndex]->IsOccluded(ray);
+	return world->IsOccluded(ray);
+}
+
+void Tmpl8::Scene::TraceBatch(RayBatch& batch, const int flags) const {
+	const int count = batch.Size();
+	const bool anyHit = flags & RayQueryAnyHit;
+	const bool attributes = (flags & RayQueryAttributes) && !anyHit;
+	batch.hit.resize(count);
+	batch.t.resize(count);
+	batch.voxel.resize(count);
+	batch.worldIndex.resize(count);
+	if (attributes) {
+		batch.normalX.resize(count), batch.normalY.resize(count), batch.normalZ.resize(count);
+		batch.voxelX.resize(count), batch.voxelY.resize(count), batch.voxelZ.resize(count);
+	}
+
+	// world space bounds, rotated worlds get the box around their corners
+	const std::vector<VoxelWorld*>& active = worlds.GetActive();
+	const std::vector<int>& slots = worlds.GetActiveSlots();
+	const int worldCount = static_cast<int>(active.size());
+	std::vector<float3> boundsMin(worldCount, float3(1e34f)), boundsMax(worldCount, float3(-1e34f));
+	for (int w = 0; w < worldCount; w++) {
+		for (const float3& corner : active[w]->GetCorners()) {
+			boundsMin[w] = fminf(boundsMin[w], corner);
+			boundsMax[w] = fmaxf(boundsMax[w], corner);
+		}
+	}
+
+	const int packetCount = (count + 7) / 8;
+#pragma omp parallel if (packetCount > 1)
+	{
+		// per lane the worlds it enters with their entry distance, sorted so the nearest world goes first
+		std::vector<std::pair<float, int>> entries[8];
+#pragma omp for schedule(dynamic, 4)
+		for (int packet = 0; packet < packetCount; packet++) {
+			const int first = packet * 8;
+			const int lanes = min(8, count - first);
+			// a partial packet repeats its last ray, the extra lanes are never written back
+			float lane[7][8];
+			const std::vector<float>* inputs[7] = { &batch.originX, &batch.originY, &batch.originZ, &batch.directionX, &batch.directionY, &batch.directionZ, &batch.tMax };
+			for (int a = 0; a < 7; a++) {
+				for (int i = 0; i < 8; i++) lane[a][i] = (*inputs[a])[first + min(i, lanes - 1)];
+			}
+			const __m256 ox = _mm256_loadu_ps(lane[0]), oy = _mm256_loadu_ps(lane[1]), oz = _mm256_loadu_ps(lane[2]);
+			const __m256 one = _mm256_set1_ps(1.0f);
+			const __m256 rdx = _mm256_div_ps(one, _mm256_loadu_ps(lane[3]));
+			const __m256 rdy = _mm256_div_ps(one, _mm256_loadu_ps(lane[4]));
+			const __m256 rdz = _mm256_div_ps(one, _mm256_loadu_ps(lane[5]));
+			const __m256 tMax = _mm256_loadu_ps(lane[6]);
+			const __m256 zero = _mm256_setzero_ps();
+
+			for (int i = 0; i < 8; i++) entries[i].clear();
+			for (int w = 0; w < worldCount; w++) {
+				// slab test of the whole packet against the world bounds
+				const __m256 x1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(boundsMin[w].x), ox), rdx);
+				const __m256 x2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(boundsMax[w].x), ox), rdx);
+				const __m256 y1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(boundsMin[w].y), oy), rdy);
+				const __m256 y2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(boundsMax[w].y), oy), rdy);
+				const __m256 z1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(boundsMin[w].z), oz), rdz);
+				const __m256 z2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(boundsMax[w].z), oz), rdz);
+				const __m256 tNear = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(x1, x2), _mm256_min_ps(y1, y2)), _mm256_min_ps(z1, z2));
+				const __m256 tFar = _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(x1, x2), _mm256_max_ps(y1, y2)), _mm256_max_ps(z1, z2));
+				// ordered compares are false for NaN, so a lane the test can't decide on is traced anyway
+				const __m256 miss = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(tFar, tNear, _CMP_LT_OQ), _mm256_cmp_ps(tFar, zero, _CMP_LT_OQ)),
+					_mm256_cmp_ps(tNear, tMax, _CMP_GE_OQ));
+				int enter = ~_mm256_movemask_ps(miss) & ((1 << lanes) - 1);
+				if (!enter) continue;
+
+				float entry[8];
+				_mm256_storeu_ps(entry, _mm256_max_ps(tNear, zero));
+				while (enter) {
+					const int i = static_cast<int>(_tzcnt_u32(enter));
+					enter &= enter - 1;
+					entries[i].emplace_back(entry[i] == entry[i] ? entry[i] : 0.0f, w);
+				}
+			}
+
+			for (int i = 0; i < lanes; i++) {
+				const int index = first + i;
+				const float3 O = float3(lane[0][i], lane[1][i], lane[2][i]);
+				const float3 D = float3(lane[3][i], lane[4][i], lane[5][i]);
+				std::sort(entries[i].begin(), entries[i].end());
+				float nearest = lane[6][i];
+				Ray nearestRay;
+				bool hit = false;
+				for (const auto& [entry, w] : entries[i]) {
+					// the world starts behind what was hit already
+					if (entry >= nearest) break;
+					if (anyHit) {
+						if (active[w]->IsOccluded(Ray(O, D, nearest))) {
+							hit = true;
+							break;
+						}
+						continue;
+					}
+					Ray ray(O, D);
+					active[w]->FindNearest(ray);
+					if (ray.voxel == 0 || ray.t >= nearest) continue;
+					nearest = ray.t;
+					nearestRay = ray;
+					nearestRay.worldIndex = slots[w];
+					hit = true;
+				}
+
+				batch.hit[index] = hit;
+				batch.t[index] = anyHit || !hit ? lane[6][i] : nearest;
+				batch.voxel[index] = hit && !anyHit ? nearestRay.voxel : 0;
+				batch.worldIndex[index] = hit && !anyHit ? nearestRay.worldIndex : -1;
+				if (attributes) {
+					const float3 normal = hit ? nearestRay.GetNormal() : float3(0);
+					batch.normalX[index] = normal.x, batch.normalY[index] = normal.y, batch.normalZ[index] = normal.z;
+					const int3 voxel = hit ? nearestRay.localVoxel : int3(0);
+					batch.voxelX[index] = voxel.x, batch.voxelY[index] = voxel.y, batch.voxelZ[index] = voxel.z;
+				}
+			}
+		}
+	}
 }
 
 bool Tmpl8::Scene::DrawImGui() {
@@ -133,41 +320,47 @@ bool Tmpl8::Scene::DrawImGui() {
 
 	if (ImGui::Button("Add World")) {
 		VoxelWorld* w = new VoxelWorld(newWorldSize);
-		worlds.push_back(w);
+		worlds.Add(w);
 		//w->RandomizeTransform();
 		w->GenerateGrid();
 		changed = true;
 	}
 
-	int indexToRemove = -1;
-	for (int i = 0; i < worlds.size(); i++) {
+	// native scene files, loaded by mapping them instead of rebuilding the bricks
+	static char sceneFilePath[260] = "scene.vxs";
+	ImGui::InputText("Scene File", sceneFilePath, sizeof(sceneFilePath));
+	if (ImGui::Button("Save Scene")) {
+		if (!SceneFile::Save(*this, sceneFilePath)) printf("Failed to write scene file %s\n", sceneFilePath);
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Load Scene")) {
+		CLearWorlds();
+		if (SceneFile::Load(*this, sceneFilePath) < 0) printf("Failed to load scene file %s\n", sceneFilePath);
+		changed = true;
+	}
+	ImGui::Text("Pooled Instances: %i / %i", instances.GetActiveCount(), instances.GetCapacity());
+
+	for (int i = 0; i < worlds.GetSlotCount(); i++) {
 		if (worlds[i]) {
 			ImGui::Dummy(ImVec2(0.0f, 10.0f));
 			std::string label = "Voxel World " + std::to_string(i);
 			if (!ImGui::CollapsingHeader(label.c_str())) continue;
 			std::string deleteLabel = "Delete##" + std::to_string(i);
 			if (ImGui::Button(deleteLabel.c_str())) {
-				indexToRemove = i;
+				worlds.Remove(i);
+				changed = true;
 			}
 
 			changed |= worlds[i]->DrawImGui(i);
 		}
 	}
 
-	if (indexToRemove != -1) {
-		delete worlds[indexToRemove];
-		worlds.erase(worlds.begin() + indexToRemove);
-		changed = true;
-	}
-
 	return changed;
 }
 
 void Tmpl8::Scene::Clear(const uint v) {
-	for (int i = 0; i < worlds.size(); i++) {
-		if (worlds[i]) {
-			worlds[i]->Clear(v);
-		}
+	for (VoxelWorld* world : worlds.GetActive()) {
+		world->Clear(v);
 	}
 }
 
@@ -194,6 +387,9 @@ void Brick::Set(const uint x, const uint y, const uint z, const uint v, const in
 	}
 
 	grid[index] = voxel;
+
+	// only write the flag when it changes, so parallel edits don't fight over the cache line
+	if (generated.load(std::memory_order_relaxed)) generated.store(false, std::memory_order_relaxed);
 }
 
 void Tmpl8::Brick::Clear(const uint v) {
@@ -203,6 +399,60 @@ void Tmpl8::Brick::Clear(const uint v) {
 	if (v != 0) {
 		voxelCount = BRICKSIZE3;
 	}
+	generated = false;
+}
+
+void Tmpl8::Brick::Commit(const int countDelta) {
+	if (countDelta > 0) voxelCount.fetch_add(countDelta, std::memory_order_relaxed);
+	else if (countDelta < 0) voxelCount.fetch_sub(-countDelta, std::memory_order_relaxed);
+	if (generated.load(std::memory_order_relaxed)) generated.store(false, std::memory_order_relaxed);
+}
+
+void Tmpl8::Brick::Assign(const uint* voxels) {
+	size_t count = 0;
+	for (int z = 0; z < BRICKSIZE; z++) {
+		for (int y = 0; y < BRICKSIZE; y++) {
+			for (int x = 0; x < BRICKSIZE; x++) {
+				const uint voxel = voxels[x + y * BRICKSIZE + z * BRICKSIZE2];
+				grid[GetVoxelIndex(x, y, z)] = voxel;
+				count += (voxel & 0x00FFFFFF) != 0;
+			}
+		}
+	}
+	voxelCount = count;
+	if (generated.load(std::memory_order_relaxed)) generated.store(false, std::memory_order_relaxed);
+}
+
+//fill the local region [min, max) of the brick with a single voxel value
+void Tmpl8::Brick::FillRegion(const int3& min, const int3& max, const uint voxel) {
+	int countDelta = 0;
+#if !MORTON && BRICKSIZE == 8
+	if (min.x == 0 && max.x == BRICKSIZE) {
+		// a row of the brick is 8 uints, so every full row is a single AVX store
+		const __m256i value = _mm256_set1_epi32(static_cast<int>(voxel));
+		const __m256i colorMask = _mm256_set1_epi32(0x00FFFFFF);
+		const int filled = (voxel & 0x00FFFFFF) ? BRICKSIZE : 0;
+		for (int z = min.z; z < max.z; z++) {
+			for (int y = min.y; y < max.y; y++) {
+				__m256i* row = reinterpret_cast<__m256i*>(grid + GetVoxelIndex(0, y, z));
+				const __m256i empty = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_load_si256(row), colorMask), _mm256_setzero_si256());
+				const int emptyCount = _mm_popcnt_u32(_mm256_movemask_ps(_mm256_castsi256_ps(empty)));
+				countDelta += filled - (BRICKSIZE - emptyCount);
+				_mm256_store_si256(row, value);
+			}
+		}
+		Commit(countDelta);
+		return;
+	}
+#endif
+	for (int z = min.z; z < max.z; z++) {
+		for (int y = min.y; y < max.y; y++) {
+			for (int x = min.x; x < max.x; x++) {
+				Write(x, y, z, voxel, countDelta);
+			}
+		}
+	}
+	Commit(countDelta);
 }
 
 
@@ -232,10 +482,11 @@ bool IsOutsideGrid(const DDAState& state) {
 	return state.posX >= BRICKSIZE || state.posY >= BRICKSIZE || state.posZ >= BRICKSIZE;
 }
 //find nearest voxel inside brick
-void Brick::FindNearest(Ray& ray, const float& brickEntryT) const {
+void Brick::FindNearest(Ray& ray, const float& brickEntryT, const int brickEntryAxis) const {
 	// Initialize traversal state for 3D DDA algorithm
 	DDAState s;
 	s.travelDistance = brickEntryT;
+	s.entryAxis = brickEntryAxis;
 
 	if (!Setup3DDDA(ray, s)) {
 		return; // Exit if ray setup fails
@@ -284,27 +535,31 @@ void Brick::FindNearest(Ray& ray, const float& brickEntryT) const {
 			ray.t = s.travelDistance;
 			ray.voxel = cell;
 			ray.index = index;
+			// the last step tells us which face we came through, so the normal doesn't have to be reconstructed
+			ray.entryAxis = s.entryAxis;
+			ray.entrySign = s.entryAxis >= 0 ? -s.stepDirection[s.entryAxis] : 0;
+			ray.localVoxel = gridPosition * BRICKSIZE + make_int3(s.posX, s.posY, s.posZ);
 			break;
 #endif
 		}
 
 		if (s.nextIntersection.x < s.nextIntersection.y) {
 			if (s.nextIntersection.x < s.nextIntersection.z) {
-				s.travelDistance = s.nextIntersection.x, s.posX += s.stepDirection.x;
+				s.travelDistance = s.nextIntersection.x, s.posX += s.stepDirection.x, s.entryAxis = 0;
 				if (s.posX >= BRICKSIZE) break;
 				s.nextIntersection.x += s.deltaDistance.x;
 			} else {
-				s.travelDistance = s.nextIntersection.z, s.posZ += s.stepDirection.z;
+				s.travelDistance = s.nextIntersection.z, s.posZ += s.stepDirection.z, s.entryAxis = 2;
 				if (s.posZ >= BRICKSIZE) break;
 				s.nextIntersection.z += s.deltaDistance.z;
 			}
 		} else {
 			if (s.nextIntersection.y < s.nextIntersection.z) {
-				s.travelDistance = s.nextIntersection.y, s.posY += s.stepDirection.y;
+				s.travelDistance = s.nextIntersection.y, s.posY += s.stepDirection.y, s.entryAxis = 1;
 				if (s.posY >= BRICKSIZE) break;
 				s.nextIntersection.y += s.deltaDistance.y;
 			} else {
-				s.travelDistance = s.nextIntersection.z, s.posZ += s.stepDirection.z;
+				s.travelDistance = s.nextIntersection.z, s.posZ += s.stepDirection.z, s.entryAxis = 2;
 				if (s.posZ >= BRICKSIZE) break;
 				s.nextIntersection.z += s.deltaDistance.z;
 			}
@@ -338,7 +593,7 @@ bool Tmpl8::Brick::FindNearestEmpty(Ray& ray, const float& brickEntryT) const {
 		ray.steps++; // Increment the number of steps the ray has taken
 
 		int materialIndex = cell >> 24;
-		Material m = MaterialList[materialIndex];
+		const Material& m = MaterialList[materialIndex];
 		uint voxelWithNoMaterial = cell & 0x00FFFFFF;
 		if (voxelWithNoMaterial || m.transparency == 0.0f) {
 			ray.t = s.travelDistance;
@@ -481,9 +736,17 @@ bool Tmpl8::Brick::Setup3DDDA(const Ray& ray, DDAState& state) const {
 bool VoxelWorld::Setup3DDDA(const Ray& ray, DDAState& state) const {
 	// if ray is not inside the world: advance until it is
 	state.travelDistance = 0;
+	state.entryAxis = -1;
 	if (!cube.Contains(ray.O)) {
 		state.travelDistance = cube.Intersect(ray);
 		if (state.travelDistance > 1e33f) return false; // ray misses voxel data entirely
+
+		// the slab we entered last is the face of the cube we came through
+		const float3 nearPlanes = float3(ray.Dsign.x > 0 ? cube.b[1].x : cube.b[0].x,
+			ray.Dsign.y > 0 ? cube.b[1].y : cube.b[0].y,
+			ray.Dsign.z > 0 ? cube.b[1].z : cube.b[0].z);
+		const float3 tNear = (nearPlanes - ray.O) * ray.rD;
+		state.entryAxis = tNear.x > tNear.y ? (tNear.x > tNear.z ? 0 : 2) : (tNear.y > tNear.z ? 1 : 2);
 	}
 
 	// setup amanatides & woo - assume world is 1x1x1, from (0,0,0) to (1,1,1)
@@ -520,41 +783,239 @@ VoxelWorld::VoxelWorld(const int3 _newGridDimensions) {
 	scale = float3(1, 1, 1);
 	UpdateTransform();
 
-	bricks = new Brick * [GetGridSize(gridDimensions)];
+	store = std::make_shared<BrickStore>(GetGridSize(gridDimensions));
+	bricks = store->bricks;
+}
+
+VoxelWorld::VoxelWorld(const VoxelWorld& other) {
+	gridDimensions = other.gridDimensions;
+	newGridDimensions = other.newGridDimensions;
+	position = other.position;
+	rotation = other.rotation;
+	scale = other.scale;
+	NoiseFrequency = other.NoiseFrequency;
+	NoiseAmplitude = other.NoiseAmplitude;
+	NoiseColor = other.NoiseColor;
+	cube = other.cube;
+	transform = other.transform;
+	invTransform = other.invTransform;
+	// the streamer and pager stay with the original, and would take the shared bricks along when it goes.
+	// Scene::SpawnInstance refuses such worlds, and a shared store can't start streaming or paging
+	store = other.store;
+	bricks = store->bricks;
+	instance = true;
+}
+
+VoxelWorld::~VoxelWorld() {
+	// these still use the bricks, so they go before the store does
+	SetStreaming(false);
+	ClosePageFile();
+}
+
+void VoxelWorld::Destroy(VoxelWorld* world) {
+	if (!world) return;
+	if (world->pool) world->pool->Release(world);
+	else delete world;
+}
 
+Tmpl8::BrickStore::BrickStore(const int brickCount) : brickCount(brickCount) {
+	bricks = new std::atomic<Brick*>[brickCount];
+	changes = new std::atomic<uint8_t>[brickCount];
 	//set each brick to null
-	const int gridSize = GetGridSize(gridDimensions);
-	for (int i = 0; i < gridSize; i++) {
-		bricks[i] = 0;
+	for (int i = 0; i < brickCount; i++) {
+		bricks[i] = nullptr;
+		changes[i] = 0;
+	}
+}
+
+Tmpl8::BrickStore::~BrickStore() {
+	for (int i = 0; i < brickCount; i++) {
+		delete bricks[i].load();
+	}
+	delete[] bricks;
+	delete[] changes;
+}
+
+void Tmpl8::BrickStore::MarkRemoved(const int index, const bool wasOccupied) {
+	const uint8_t removal = wasOccupied ? RemovedOccupied : RemovedEmpty;
+	uint8_t change = changes[index].load(std::memory_order_relaxed);
+	while (!(change & Removed) && !changes[index].compare_exchange_weak(change, change | removal, std::memory_order_relaxed));
+	MarkChanged(index);
+}
+
+void Tmpl8::BrickStore::CarryChange(const int index, const uint8_t change) {
+	if (change & Removed) MarkRemoved(index, (change & RemovedOccupied) != 0);
+	else if (change & Listed) MarkChanged(index);
+}
+
+void Tmpl8::BrickStore::TakeChanges(std::vector<StoreChange>& storeChanges) {
+	storeChanges.clear();
+	{
+		std::lock_guard<std::mutex> lock(changedMutex);
+		std::swap(changedSlots, takenSlots);
+	}
+	for (const int index : takenSlots) {
+		const uint8_t change = changes[index].exchange(0, std::memory_order_relaxed);
+		Brick* b = bricks[index].load();
+
+		// a removed brick is compared against what it held at the last flush, not against a brick that took its slot since
+		const bool wasOccupied = (change & Removed) ? (change & RemovedOccupied) != 0 : b && b->flushedVoxelCount != 0;
+		const size_t count = b ? b->voxelCount.load() : 0;
+		StoreChange storeChange = { index, OccupancyChange::None };
+		if (!wasOccupied && count != 0) storeChange.occupancy = OccupancyChange::BecameOccupied;
+		else if (wasOccupied && count == 0) storeChange.occupancy = OccupancyChange::BecameEmpty;
+		if (b) b->flushedVoxelCount = count;
+		storeChanges.push_back(storeChange);
+	}
+	takenSlots.clear();
+}
+
+void Tmpl8::BrickStore::DropChanges() {
+	std::lock_guard<std::mutex> lock(changedMutex);
+	for (const int index : changedSlots) {
+		changes[index].store(0, std::memory_order_relaxed);
 	}
+	changedSlots.clear();
 }
 
 void Tmpl8::VoxelWorld::GenerateGrid() {
-	const int zGridSize = BRICKSIZE * gridDimensions.z;
-	const int yGridSize = BRICKSIZE * gridDimensions.y;
-	const int xGridSize = BRICKSIZE * gridDimensions.x;
-	const int3 worldSize = gridDimensions * BRICKSIZE;
+	MakeStoreWritable();
+	const std::vector<float> xCoords = GetNoiseXCoordinates();
+
+	// one brick at a time: evaluate the noise for the whole brick, then publish it in one go
+	const int brickCount = GetGridSize(gridDimensions);
 #pragma omp parallel for schedule(dynamic)
-	for (int z = 0; z < zGridSize; z++) {
-		const float fz = (float)z / zGridSize;
-		for (int y = 0; y < yGridSize; y++) {
-			const float fy = (float)y / yGridSize;
-			float fx = 0;
-			for (int x = 0; x < xGridSize; x++, fx += 1.0f / xGridSize) {
-				const float n = noise3D(fx, fy, fz, NoiseFrequency, NoiseAmplitude);
-
-				//uint color = RandomColor();
-				uint color;
-				if (NoiseColor == 0) {
-					color = ComputeVoxelColor(x, y, z, worldSize);
-				} else {
-					color = NoiseColor;
+	for (int i = 0; i < brickCount; i++) {
+		GenerateBrick(i, xCoords.data());
+	}
+}
+
+// x is accumulated instead of divided, like the old per voxel loop did, so worlds generate the same
+std::vector<float> Tmpl8::VoxelWorld::GetNoiseXCoordinates() const {
+	const int xGridSize = gridDimensions.x * BRICKSIZE;
+	std::vector<float> xCoords(xGridSize);
+	float fx = 0;
+	for (int x = 0; x < xGridSize; x++, fx += 1.0f / xGridSize) {
+		xCoords[x] = fx;
+	}
+	return xCoords;
+}
+
+void Tmpl8::VoxelWorld::GenerateBrick(const int i, const float* xCoords, const bool overwrite) {
+	static_assert(BRICKSIZE == 8, "noise3DBlock evaluates 8x8x8 blocks");
+	const float threshold = 0.09f;
+	const int3 worldSize = gridDimensions * BRICKSIZE;
+
+	const int3 brickPosition = make_int3(i % gridDimensions.x, (i / gridDimensions.x) % gridDimensions.y, i / (gridDimensions.x * gridDimensions.y));
+	const int3 origin = brickPosition * BRICKSIZE;
+	float xs[BRICKSIZE], ys[BRICKSIZE], zs[BRICKSIZE];
+	for (int k = 0; k < BRICKSIZE; k++) {
+		xs[k] = xCoords[origin.x + k];
+		ys[k] = (float)(origin.y + k) / worldSize.y;
+		zs[k] = (float)(origin.z + k) / worldSize.z;
+	}
+
+	float noise[BRICKSIZE3];
+	const float2 bounds = noise3DBlock(xs, ys, zs, threshold, noise, NoiseFrequency, NoiseAmplitude);
+	if (bounds.y <= threshold) return; // nothing in this brick can be solid
+	const bool full = bounds.x > threshold;
+
+	const auto writeInto = [&](Brick* b) {
+		int countDelta = 0;
+		for (int z = 0; z < BRICKSIZE; z++) {
+			for (int y = 0; y < BRICKSIZE; y++) {
+				for (int x = 0; x < BRICKSIZE; x++) {
+					if (!full && noise[x + y * BRICKSIZE + z * BRICKSIZE2] <= threshold) continue;
+					const uint color = NoiseColor == 0 ? ComputeVoxelColor(origin.x + x, origin.y + y, origin.z + z, worldSize) : NoiseColor;
+					b->Write(x, y, z, color, countDelta);
 				}
-				if (n > 0.09f) Set(x, y, z, color, 0);
 			}
 		}
+		b->Commit(countDelta);
+	};
+
+	Brick* b = bricks[i].load(std::memory_order_acquire);
+	if (!b) {
+		// fill a private brick first, so other threads only ever see it complete
+		Brick* newBrick = new Brick(brickPosition);
+		writeInto(newBrick);
+		// only a brick that is nothing but noise can be thrown away and generated again
+		newBrick->generated = true;
+		if (bricks[i].compare_exchange_strong(b, newBrick, std::memory_order_acq_rel, std::memory_order_acquire)) {
+			if (pager) pager->Adopt(i);
+			store->MarkChanged(i);
+			return;
+		}
+		delete newBrick;
+	}
+	if (!overwrite) return;
+	writeInto(b);
+	store->MarkChanged(i);
+}
+
+void Tmpl8::VoxelWorld::SetStreaming(const bool enabled) {
+	if (enabled == (streamer != nullptr)) return;
+	// evictions would delete bricks that instances still use
+	if (enabled && store.use_count() > 1) return;
+	if (enabled) {
+		ClosePageFile();
+		streamer = new BrickStreamer(this);
+	} else {
+		delete streamer;
+		streamer = nullptr;
+	}
+}
+
+bool Tmpl8::VoxelWorld::WritePageFile(const char* path) {
+	SetStreaming(false);
+	// closing the page file would take its bricks along, a paged world is written while the pager can still page them in
+	return BrickPager::Write(this, path, true);
+}
+
+bool Tmpl8::VoxelWorld::OpenPageFile(const char* path) {
+	// the pager deletes its bricks when it closes, instances would be left with dangling ones
+	if (store.use_count() > 1) return false;
+	SetStreaming(false);
+	ClosePageFile();
+	BrickPager* newPager = BrickPager::Open(path);
+	if (!newPager) return false;
+
+	// the page file replaces whatever the world held before
+	if (newPager->GetGridDimensions() != gridDimensions) Resize(newPager->GetGridDimensions());
+	for (int i = 0; i < GetGridSize(gridDimensions); i++) {
+		delete TakeBrick(i);
 	}
+	newPager->Attach(this);
+	pager = newPager;
+	return true;
+}
+
+void Tmpl8::VoxelWorld::ClosePageFile() {
+	delete pager;
+	pager = nullptr;
+}
+
+void Tmpl8::VoxelWorld::CopyHit(const Ray& transformedRay, Ray& ray) const {
+	ray.t = transformedRay.t;
+
+	//ray.D = transformedRay.D;
+	//ray.O = transformedRay.O;
+	ray.voxel = transformedRay.voxel;
+	ray.index = transformedRay.index;
+	ray.steps = transformedRay.steps;
+	ray.worldIndex = transformedRay.worldIndex;
+	ray.Dsign = transformedRay.Dsign;
+	ray.entryAxis = transformedRay.entryAxis;
+	ray.entrySign = transformedRay.entrySign;
+	ray.localVoxel = transformedRay.localVoxel;
+#if SPHERES
+	ray.N = transformedRay.N;
+#endif // SPHERES
+
+	ray.worldTransform = transform;
+	ray.invWorldTransform = invTransform;
 }
+
 //find nearest brick inside world
 void VoxelWorld::FindNearest(Ray& ray) const {
 	if(!IsActive()) return;
@@ -581,52 +1042,54 @@ void VoxelWorld::FindNearest(Ray& ray) const {
 		// get the brick
 		const int index = GetBrickIndex(bx, by, bz, gridDimensions);
 		const Brick* b = bricks[index];
+		if (!b && pager) b = pager->Fault(index);
 		transformedRay.steps++;
+		if (streamer && b) streamer->MarkUsed(index);
+		if (pager && b) pager->MarkUsed(index);
 		if (b && !b->IsEmpty()) {
 			//ray.t = s.travelDistanceravelDistance;
 			//ray.voxel = 0xff0000;
 			//return;
 			// find the nearest intersection in the brick
 			float brickEntryT = s.travelDistance;
-			b->FindNearest(transformedRay, brickEntryT);
+			b->FindNearest(transformedRay, brickEntryT, s.entryAxis);
 
 			// if an intersection was found, return
 			if (transformedRay.voxel != 0) {
-				ray.t = transformedRay.t;
-
-				//ray.D = transformedRay.D;
-				//ray.O = transformedRay.O;
-				ray.voxel = transformedRay.voxel;
-				ray.index = transformedRay.index;
-				ray.steps = transformedRay.steps;
-				ray.worldIndex = transformedRay.worldIndex;
-				ray.Dsign = transformedRay.Dsign;
-#if SPHERES
-				ray.N = transformedRay.N;
-#endif // SPHERES
-
-				ray.worldTransform = transform;
-				ray.invWorldTransform = invTransform;
+				CopyHit(transformedRay, ray);
+				return;
+			}
+		} else if (!b && streamer) {
+			// the brick isn't generated yet, show its placeholder instead of waiting for it
+			const uint placeholder = streamer->Touch(index);
+			if (placeholder) {
+				transformedRay.t = s.travelDistance;
+				transformedRay.voxel = placeholder;
+				transformedRay.index = 0;
+				transformedRay.entryAxis = s.entryAxis;
+				transformedRay.entrySign = s.entryAxis >= 0 ? -s.stepDirection[s.entryAxis] : 0;
+				transformedRay.localVoxel = make_int3(bx, by, bz) * BRICKSIZE;
+				CopyHit(transformedRay, ray);
 				return;
 			}
 		}
 		if (s.nextIntersection.x < s.nextIntersection.y) {
 			if (s.nextIntersection.x < s.nextIntersection.z) {
-				s.travelDistance = s.nextIntersection.x, s.posX += s.stepDirection.x;
+				s.travelDistance = s.nextIntersection.x, s.posX += s.stepDirection.x, s.entryAxis = 0;
 				if (s.posX >= static_cast<uint>(gridDimensions.x)) break;
 				s.nextIntersection.x += s.deltaDistance.x;
 			} else {
-				s.travelDistance = s.nextIntersection.z, s.posZ += s.stepDirection.z;
+				s.travelDistance = s.nextIntersection.z, s.posZ += s.stepDirection.z, s.entryAxis = 2;
 				if (s.posZ >= static_cast<uint>(gridDimensions.z)) break;
 				s.nextIntersection.z += s.deltaDistance.z;
 			}
 		} else {
 			if (s.nextIntersection.y < s.nextIntersection.z) {
-				s.travelDistance = s.nextIntersection.y, s.posY += s.stepDirection.y;
+				s.travelDistance = s.nextIntersection.y, s.posY += s.stepDirection.y, s.entryAxis = 1;
 				if (s.posY >= static_cast<uint>(gridDimensions.y)) break;
 				s.nextIntersection.y += s.deltaDistance.y;
 			} else {
-				s.travelDistance = s.nextIntersection.z, s.posZ += s.stepDirection.z;
+				s.travelDistance = s.nextIntersection.z, s.posZ += s.stepDirection.z, s.entryAxis = 2;
 				if (s.posZ >= static_cast<uint>(gridDimensions.z)) break;
 				s.nextIntersection.z += s.deltaDistance.z;
 			}
@@ -659,6 +1122,7 @@ void Tmpl8::VoxelWorld::FindNearestEmpty(Ray& ray) const {
 		// get the brick
 		const int index = GetBrickIndex(bx, by, bz, gridDimensions);
 		const Brick* b = bricks[index];
+		if (!b && pager) b = pager->Fault(index);
 		transformedRay.steps++;
 		if (b) {
 			if (b->IsEmpty()) {
@@ -669,7 +1133,7 @@ void Tmpl8::VoxelWorld::FindNearestEmpty(Ray& ray) const {
 
 			if (b->FindNearestEmpty(transformedRay, brickEntryT)) {
 
-				const Material m = transformedRay.GetMaterial();
+				const Material& m = transformedRay.GetMaterial();
 
 				if (m.transparency == 0.0f || transformedRay.voxel == 0) {
 					ray.t = transformedRay.t;
@@ -681,6 +1145,7 @@ void Tmpl8::VoxelWorld::FindNearestEmpty(Ray& ray) const {
 					ray.steps = transformedRay.steps;
 					ray.worldIndex = transformedRay.worldIndex;
 					ray.Dsign = transformedRay.Dsign;
+					ray.entryAxis = -1; // not tracked here, normal gets reconstructed
 #if SPHERES
 					ray.N = transformedRay.N;
 #endif // SPHERES
@@ -736,6 +1201,7 @@ bool Tmpl8::VoxelWorld::IsOccluded(const Ray& ray) const {
 		// get the brick
 		int index = GetBrickIndex(bx, by, bz, gridDimensions);
 		Brick* b = bricks[index];
+		if (!b && pager && s.travelDistance < transformedRay.t) b = pager->Fault(index);
 		if (b && !b->IsEmpty()) {
 			float brickEntryT = s.travelDistance;
 
@@ -743,6 +1209,9 @@ bool Tmpl8::VoxelWorld::IsOccluded(const Ray& ray) const {
 
 			// if an intersection was found, return
 			if (occluded) return true;
+		} else if (!b && streamer && s.travelDistance < transformedRay.t && streamer->Touch(index)) {
+			// placeholders cast shadows too, so lighting doesn't pop when the brick arrives
+			return true;
 		}
 		if (s.nextIntersection.x < s.nextIntersection.y) {
 			if (s.nextIntersection.x < s.nextIntersection.z) {
@@ -825,11 +1294,11 @@ bool Tmpl8::VoxelWorld::DrawImGui(const int index) {
 		// Tab for noise settings
 		if (ImGui::BeginTabItem("Noise Settings")) {
 			if (ImGui::Button("Clear World")) {
+				// the streamer and pager count the bricks they hold, they let go of theirs themselves
+				SetStreaming(false);
+				ClosePageFile();
 				for (int i = 0; i < GetGridSize(gridDimensions); i++) {
-					if (bricks[i]) {
-						delete bricks[i];
-						bricks[i] = 0;
-					}
+					delete TakeBrick(i);
 				}
 				changed = true;
 			}
@@ -845,6 +1314,49 @@ bool Tmpl8::VoxelWorld::DrawImGui(const int index) {
 			ImGui::EndTabItem();
 		}
 
+		// Tab for streaming the noise in around the camera
+		if (ImGui::BeginTabItem("Streaming")) {
+			bool streaming = streamer != nullptr;
+			std::string streamingLabel = "Stream Bricks##" + std::to_string(index);
+			if (ImGui::Checkbox(streamingLabel.c_str(), &streaming)) {
+				SetStreaming(streaming);
+				changed = true;
+			}
+			if (streamer) changed |= streamer->DrawImGui(index);
+			ImGui::EndTabItem();
+		}
+
+		// Tab for keeping the world in a memory mapped page file
+		if (ImGui::BeginTabItem("Paging")) {
+			std::string pathLabel = "Page File##" + std::to_string(index);
+			std::string writeLabel = "Write Page File##" + std::to_string(index);
+			std::string openLabel = "Open Page File##" + std::to_string(index);
+			std::string closeLabel = "Close Page File##" + std::to_string(index);
+			char path[260];
+			strncpy(path, pageFilePath.c_str(), sizeof(path) - 1);
+			path[sizeof(path) - 1] = 0;
+			if (ImGui::InputText(pathLabel.c_str(), path, sizeof(path))) pageFilePath = path;
+			if (ImGui::Button(writeLabel.c_str())) {
+				if (!WritePageFile(path)) printf("Failed to write page file %s\n", path);
+			}
+			ImGui::SameLine();
+			if (ImGui::Button(openLabel.c_str())) {
+				if (!OpenPageFile(path)) printf("Failed to open page file %s\n", path);
+				changed = true;
+			}
+			if (pager) {
+				ImGui::SameLine();
+				if (ImGui::Button(closeLabel.c_str())) {
+					ClosePageFile();
+					changed = true;
+				}
+			}
+			if (pager) {
+				changed |= pager->DrawImGui(index);
+			}
+			ImGui::EndTabItem();
+		}
+
 		//tab that shows the corners of the world
 		if (ImGui::BeginTabItem("Matrix")) {
 			MatrixProperties("testets", transform);
@@ -886,33 +1398,317 @@ void Tmpl8::VoxelWorld::Set(const uint x, const uint y, const uint z, const uint
 
 	//if out of bounds, return
 	if (bx >= static_cast<uint>(gridDimensions.x) || by >= static_cast<uint>(gridDimensions.y) || bz >= static_cast<uint>(gridDimensions.z)) return;
+	MakeStoreWritable();
 
 	// Calculate the index of the brick in the 1D array
 	int index = GetBrickIndex(bx, by, bz, gridDimensions);
 
-	Brick* b = bricks[index];
-
-	if (!b) {
-		// create a new brick
-		int3 gridPos = int3(bx, by, bz);
-		b = new Brick(gridPos);
-		bricks[index] = b;
-	}
+	Brick* b = GetOrCreateBrick(index, int3(bx, by, bz));
 	// set the voxel in the brick
 	b->Set(x, y, z, v, materialIndex);
+	store->MarkChanged(index);
+}
+
+//clamp a voxel range to the world, returns false if nothing is left
+bool Tmpl8::VoxelWorld::ClampToGrid(int3& start, int3& end, int3& brickMin, int3& brickMax) const {
+	start = max(start, make_int3(0));
+	end = min(end, gridDimensions * BRICKSIZE);
+	if (start.x >= end.x || start.y >= end.y || start.z >= end.z) return false;
+
+	brickMin = make_int3(start.x >> BRICKBITS, start.y >> BRICKBITS, start.z >> BRICKBITS);
+	brickMax = make_int3(((end.x - 1) >> BRICKBITS) + 1, ((end.y - 1) >> BRICKBITS) + 1, ((end.z - 1) >> BRICKBITS) + 1);
+	return true;
+}
+
+//bricks are created up front so the parallel writes never allocate
+void Tmpl8::VoxelWorld::AllocateBricks(const int3& brickMin, const int3& brickMax) {
+	for (int bz = brickMin.z; bz < brickMax.z; bz++) {
+		for (int by = brickMin.y; by < brickMax.y; by++) {
+			for (int bx = brickMin.x; bx < brickMax.x; bx++) {
+				GetOrCreateBrick(GetBrickIndex(bx, by, bz, gridDimensions), int3(bx, by, bz));
+			}
+		}
+	}
+}
+
+//returns the brick at index, creating it if needed. safe to call from multiple threads
+Brick* Tmpl8::VoxelWorld::GetOrCreateBrick(const int index, const int3& gridPosition) {
+	// bricks stored in the page file or not streamed in yet are loaded instead of being replaced by an empty one
+	Brick* b = FaultBrick(index);
+	if (b) return b;
+
+	// threads racing for the same brick all allocate one, only the first to publish it wins
+	Brick* newBrick = new Brick(gridPosition);
+	if (bricks[index].compare_exchange_strong(b, newBrick, std::memory_order_acq_rel, std::memory_order_acquire)) {
+		if (pager) pager->Adopt(index);
+		return newBrick;
+	}
+	delete newBrick;
+	return b;
+}
+
+//returns the brick at index, mapping it in from the page file or generating it for streamed worlds first. null if the slot is empty
+Brick* Tmpl8::VoxelWorld::FaultBrick(const int index) {
+	Brick* b = bricks[index].load(std::memory_order_acquire);
+	if (b) return b;
+	if (pager) return pager->Fault(index);
+	if (streamer) return streamer->Fault(index);
+	return nullptr;
+}
+
+//instances only show the bricks of the world they were copied from, the first edit through one gives it its own copy.
+//the changes that weren't flushed yet come along, this world didn't get to see them yet
+void Tmpl8::VoxelWorld::MakeStoreWritable() {
+	if (!instance) return;
+	instance = false;
+	if (store.use_count() == 1) return;
+
+	std::shared_ptr<BrickStore> ownStore = std::make_shared<BrickStore>(store->brickCount);
+	for (int i = 0; i < store->brickCount; i++) {
+		const Brick* b = bricks[i].load();
+		if (b) ownStore->bricks[i] = b->Clone();
+		ownStore->CarryChange(i, store->changes[i].load());
+	}
+	store = ownStore;
+	bricks = store->bricks;
+}
+
+void Tmpl8::VoxelWorld::FillBox(const int3& boxMin, const int3& boxMax, const uint v, const int materialIndex) {
+	int3 start = boxMin, end = boxMax, brickMin, brickMax;
+	if (!ClampToGrid(start, end, brickMin, brickMax)) return;
+	MakeStoreWritable();
+
+	const uint voxel = (materialIndex << 24) | v;
+	// clearing doesn't need new bricks, but paged and streamed bricks that aren't loaded still have to be cleared
+	if (voxel & 0x00FFFFFF) AllocateBricks(brickMin, brickMax);
+
+	const int3 brickRange = brickMax - brickMin;
+	const int brickCount = brickRange.x * brickRange.y * brickRange.z;
+#pragma omp parallel for schedule(dynamic) if (brickCount > 4)
+	for (int i = 0; i < brickCount; i++) {
+		const int bx = brickMin.x + i % brickRange.x;
+		const int by = brickMin.y + (i / brickRange.x) % brickRange.y;
+		const int bz = brickMin.z + i / (brickRange.x * brickRange.y);
+		const int index = GetBrickIndex(bx, by, bz, gridDimensions);
+		Brick* b = FaultBrick(index);
+		if (!b) continue;
+
+		const int3 origin = make_int3(bx, by, bz) * BRICKSIZE;
+		b->FillRegion(max(start, origin) - origin, min(end, origin + BRICKSIZE) - origin, voxel);
+		store->MarkChanged(index);
+	}
+}
+
+void Tmpl8::VoxelWorld::FillSphere(const int3& center, const float radius, const uint v, const int materialIndex, const float probability) {
+	MakeStoreWritable();
+	// same bounds and inside test as the per voxel DrawSphere
+	const int3 start = center - make_int3(static_cast<int>(radius));
+	const int3 end = center + make_int3(static_cast<int>(radius));
+	const uint voxel = (materialIndex << 24) | v;
+	const uint empty = materialIndex << 24;
+	const float3 sphereCenter = float3(center);
+
+	const auto inside = [&](const int x, const int y, const int z) {
+		return length(float3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)) - sphereCenter) - radius < 0;
+	};
+
+	if (probability >= 1.0f) {
+		// bricks that are completely inside the sphere get filled with row stores, only the shell is tested per voxel
+		int3 clampedStart = start, clampedEnd = end, brickMin, brickMax;
+		if (!ClampToGrid(clampedStart, clampedEnd, brickMin, brickMax)) return;
+		if (voxel & 0x00FFFFFF) AllocateBricks(brickMin, brickMax);
+
+		const int3 brickRange = brickMax - brickMin;
+		const int brickCount = brickRange.x * brickRange.y * brickRange.z;
+#pragma omp parallel for schedule(dynamic) if (brickCount > 4)
+		for (int i = 0; i < brickCount; i++) {
+			const int bx = brickMin.x + i % brickRange.x;
+			const int by = brickMin.y + (i / brickRange.x) % brickRange.y;
+			const int bz = brickMin.z + i / (brickRange.x * brickRange.y);
+			const int index = GetBrickIndex(bx, by, bz, gridDimensions);
+			Brick* b = FaultBrick(index);
+			if (!b) continue;
+
+			const int3 origin = make_int3(bx, by, bz) * BRICKSIZE;
+			const int3 from = max(clampedStart, origin);
+			const int3 to = min(clampedEnd, origin + BRICKSIZE);
+
+			// the sphere is convex, so if all corners of the region are inside, everything is
+			bool allInside = true;
+			for (int corner = 0; corner < 8 && allInside; corner++) {
+				allInside = inside(corner & 1 ? to.x - 1 : from.x, corner & 2 ? to.y - 1 : from.y, corner & 4 ? to.z - 1 : from.z);
+			}
+			if (allInside) {
+				b->FillRegion(from - origin, to - origin, voxel);
+				store->MarkChanged(index);
+				continue;
+			}
+
+			int countDelta = 0;
+			for (int z = from.z; z < to.z; z++) {
+				for (int y = from.y; y < to.y; y++) {
+					for (int x = from.x; x < to.x; x++) {
+						if (inside(x, y, z)) b->Write(x - origin.x, y - origin.y, z - origin.z, voxel, countDelta);
+					}
+				}
+			}
+			b->Commit(countDelta);
+			store->MarkChanged(index);
+		}
+		return;
+	}
+
+	// a new pattern every call, hashed per voxel so the threads don't share a random state
+	const uint seed = RandomUInt();
+	FillShape(start, end, voxel, true, [&](const int x, const int y, const int z, uint& value) {
+		if (!inside(x, y, z)) return false;
+		if (VoxelHash(x, y, z, seed) >= probability) value = empty;
+		return true;
+	});
+}
+
+void Tmpl8::VoxelWorld::CsgSphere(const CsgOp op, const float3& center, const float radius, const uint v, const int materialIndex, const float probability, const uint seed) {
+	const int3 start = make_int3(floorf(center - radius));
+	const int3 end = make_int3(ceilf(center + radius)) + 1;
+	ApplyCsg(op, start, end, [&](const float3& p) { return length(p - center) - radius; }, (materialIndex << 24) | v, probability, seed);
+}
+
+void Tmpl8::VoxelWorld::CsgBox(const CsgOp op, const int3& boxMin, const int3& boxMax, const uint v, const int materialIndex, const float probability, const uint seed) {
+	// the voxels from min to max - 1 are inside, the distance is along the axis that is furthest out
+	const float3 center = make_float3(boxMin + boxMax - 1) * 0.5f;
+	const float3 halfSize = make_float3(boxMax - boxMin) * 0.5f;
+	ApplyCsg(op, boxMin, boxMax, [&](const float3& p) {
+		const float3 d = fabs(p - center) - halfSize;
+		return max(d.x, max(d.y, d.z));
+	}, (materialIndex << 24) | v, probability, seed);
+}
+
+//apply a list of single voxel writes, sorted by brick so every brick is visited once
+void Tmpl8::VoxelWorld::SetVoxels(std::vector<VoxelEdit>& edits) {
+	const uint3 worldSize = make_uint3(gridDimensions * BRICKSIZE);
+	edits.erase(std::remove_if(edits.begin(), edits.end(), [&](const VoxelEdit& edit) {
+		return edit.x >= worldSize.x || edit.y >= worldSize.y || edit.z >= worldSize.z;
+	}), edits.end());
+	if (edits.empty()) return;
+	MakeStoreWritable();
+
+	const auto brickOf = [&](const VoxelEdit& edit) {
+		return GetBrickIndex(edit.x >> BRICKBITS, edit.y >> BRICKBITS, edit.z >> BRICKBITS, gridDimensions);
+	};
+	// stable, so later writes to the same voxel still win
+	std::stable_sort(edits.begin(), edits.end(), [&](const VoxelEdit& a, const VoxelEdit& b) {
+		return brickOf(a) < brickOf(b);
+	});
+
+	// find where each brick's run of edits starts and create missing bricks
+	std::vector<int> runStarts;
+	for (int i = 0; i < static_cast<int>(edits.size()); i++) {
+		const int index = brickOf(edits[i]);
+		if (i > 0 && index == brickOf(edits[i - 1])) continue;
+		runStarts.push_back(i);
+		GetOrCreateBrick(index, int3(edits[i].x >> BRICKBITS, edits[i].y >> BRICKBITS, edits[i].z >> BRICKBITS));
+	}
+	runStarts.push_back(static_cast<int>(edits.size()));
+
+	const int runCount = static_cast<int>(runStarts.size()) - 1;
+#pragma omp parallel for schedule(dynamic) if (runCount > 4)
+	for (int run = 0; run < runCount; run++) {
+		const int index = brickOf(edits[runStarts[run]]);
+		Brick* b = bricks[index];
+		int countDelta = 0;
+		for (int i = runStarts[run]; i < runStarts[run + 1]; i++) {
+			const VoxelEdit& edit = edits[i];
+			b->Write(edit.x & (BRICKSIZE - 1), edit.y & (BRICKSIZE - 1), edit.z & (BRICKSIZE - 1), edit.voxel, countDelta);
+		}
+		b->Commit(countDelta);
+		store->MarkChanged(index);
+	}
+}
+
+//one task per brick, bricks are only created once a voxel lands in them
+size_t Tmpl8::VoxelWorld::SetDense(const uint8_t* source, const int3& size, const int3& stride, const int3& offset, const uint* palette) {
+	int3 start = offset, end = offset + size, brickMin, brickMax;
+	if (!ClampToGrid(start, end, brickMin, brickMax)) return 0;
+	MakeStoreWritable();
+
+	const int3 brickRange = brickMax - brickMin;
+	const int brickCount = brickRange.x * brickRange.y * brickRange.z;
+	long long written = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+ : written) if (brickCount > 4)
+	for (int i = 0; i < brickCount; i++) {
+		const int bx = brickMin.x + i % brickRange.x;
+		const int by = brickMin.y + (i / brickRange.x) % brickRange.y;
+		const int bz = brickMin.z + i / (brickRange.x * brickRange.y);
+		const int3 origin = make_int3(bx, by, bz) * BRICKSIZE;
+		const int3 from = max(start, origin);
+		const int3 to = min(end, origin + BRICKSIZE);
+
+		const int index = GetBrickIndex(bx, by, bz, gridDimensions);
+		Brick* b = nullptr;
+		int countDelta = 0;
+		for (int z = from.z; z < to.z; z++) {
+			for (int y = from.y; y < to.y; y++) {
+				const uint8_t* row = source + (z - offset.z) * stride.z + (y - offset.y) * stride.y;
+				for (int x = from.x; x < to.x; x++) {
+					const uint voxel = palette[row[(x - offset.x) * stride.x]];
+					if (!voxel) continue;
+					if (!b) b = GetOrCreateBrick(index, make_int3(bx, by, bz));
+					b->Write(x & (BRICKSIZE - 1), y & (BRICKSIZE - 1), z & (BRICKSIZE - 1), voxel, countDelta);
+					written++;
+				}
+			}
+		}
+		if (!b) continue;
+		b->Commit(countDelta);
+		store->MarkChanged(index);
+	}
+	return static_cast<size_t>(written);
 }
 
 //clear the world with a specific value
 void Tmpl8::VoxelWorld::Clear(const uint v) {
+	MakeStoreWritable();
 	//iterate over all bricks
 	for (int i = 0; i < GetGridSize(gridDimensions); i++) {
 		//if the brick exists, clear it
-		if (bricks[i]) {
-			bricks[i]->Clear(v);
+		if (Brick* b = bricks[i].load()) {
+			b->Clear(v);
+			store->MarkChanged(i);
+		}
+	}
+}
+
+void Tmpl8::VoxelWorld::CollectChanges(const int worldIndex, const std::vector<StoreChange>& storeChanges, std::vector<BrickChange>& changes) const {
+	const float3 brickSize = float3(BRICKSIZE * VOXELSIZE);
+	for (const StoreChange& storeChange : storeChanges) {
+		const int i = storeChange.brickIndex;
+		BrickChange change;
+		change.worldIndex = worldIndex;
+		change.brickIndex = i;
+		change.occupancy = storeChange.occupancy;
+
+		// transform the corners of the brick to get its world space bounds, the slot may be empty by now
+		const int3 gridPosition = make_int3(i % gridDimensions.x, (i / gridDimensions.x) % gridDimensions.y, i / (gridDimensions.x * gridDimensions.y));
+		const float3 localMin = float3(gridPosition) * brickSize;
+		change.boundsMin = float3(1e34f);
+		change.boundsMax = float3(-1e34f);
+		for (int corner = 0; corner < 8; corner++) {
+			const float3 offset = float3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1) * brickSize;
+			const float3 p = transform.TransformPoint(localMin + offset);
+			change.boundsMin = fminf(change.boundsMin, p);
+			change.boundsMax = fmaxf(change.boundsMax, p);
 		}
+		changes.push_back(change);
 	}
 }
 
+Brick* Tmpl8::VoxelWorld::TakeBrick(const int index) {
+	MakeStoreWritable();
+	Brick* b = bricks[index].exchange(nullptr);
+	if (b) store->MarkRemoved(index, b->flushedVoxelCount != 0);
+	return b;
+}
+
 void Tmpl8::VoxelWorld::RandomizeTransform() {
 	position = float3(RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f));
 	rotation = float3(RandomFloat(-PI, PI), RandomFloat(-PI, PI), RandomFloat(-PI, PI));
@@ -954,16 +1750,17 @@ std::vector<float3> Tmpl8::VoxelWorld::GetCorners() const {
 
 //function to resize the world to the new grid dimensions
 void Tmpl8::VoxelWorld::Resize(const int3 newGridSize) {
+	// the streamer is sized for the old grid, the page file only fits the old grid
+	const bool streaming = streamer != nullptr;
+	SetStreaming(false);
+	ClosePageFile();
+
 	// Calculate the total size for the new grid
 	const int newGridTotalSize = GetGridSize(newGridSize);
 
-	// Create a new array of Brick pointers for the new grid size
-	Brick** newBricks = new Brick * [newGridTotalSize];
-
-	// Initialize the new bricks array to null
-	for (int i = 0; i < newGridTotalSize; i++) {
-		newBricks[i] = nullptr;
-	}
+	// Create a new store for the new grid size, instances keep using the old one
+	std::shared_ptr<BrickStore> newStore = std::make_shared<BrickStore>(newGridTotalSize);
+	const bool shared = store.use_count() > 1;
 
 	// Copy existing bricks to the new array
 	// Assuming GetGridSize(int3) computes the total number of bricks for the given dimensions
@@ -977,25 +1774,50 @@ void Tmpl8::VoxelWorld::Resize(const int3 newGridSize) {
 				int oldIndex = x + y * gridDimensions.x + z * gridDimensions.x * gridDimensions.y;
 				int newIndex = x + y * newGridSize.x + z * newGridSize.x * newGridSize.y;
 
-				// Copy the pointer from the old to the new array, preserving the brick information
-				newBricks[newIndex] = bricks[oldIndex];
+				// Move the brick to the new store, or copy it when instances still see the old one
+				Brick* b = bricks[oldIndex].load();
+				if (b && shared) b = b->Clone();
+				else bricks[oldIndex] = nullptr;
+				newStore->bricks[newIndex] = b;
+				newStore->CarryChange(newIndex, store->changes[oldIndex].load());
 			}
 		}
 	}
 
-	// Delete the old array of bricks
-	delete[] bricks;
-
-	// Set the new array as the current one
-	bricks = newBricks;
+	// Set the new store as the current one, the old one deletes the bricks that fell outside the new grid
+	newStore->mappedFile = store->mappedFile;
+	store = newStore;
+	bricks = store->bricks;
+	instance = false;
 
 	// Update the grid dimensions
 	gridDimensions = newGridSize;
 
 	// Resize other related properties if needed (not shown)
 	ResizeCube(newGridSize);
+	SetStreaming(streaming);
 }
 
+bool Tmpl8::VoxelWorld::SwapStore(std::shared_ptr<BrickStore>& other) {
+	if (!other || other->brickCount != GetGridSize(gridDimensions)) return false;
+	// the changes that weren't flushed yet move along, slots the other store has no brick for are reported as removed.
+	// the changed bricks report their occupancy change against the bricks that were shown until now
+	for (int i = 0; i < other->brickCount; i++) {
+		Brick* b = other->bricks[i].load(std::memory_order_relaxed);
+		const Brick* shown = bricks[i].load(std::memory_order_relaxed);
+		uint8_t change = store->changes[i].load(std::memory_order_relaxed);
+		if (!(change & BrickStore::Removed) && shown && !b) change |= shown->flushedVoxelCount != 0 ? BrickStore::RemovedOccupied : BrickStore::RemovedEmpty;
+		other->CarryChange(i, change);
+		if (!b || !(other->changes[i].load(std::memory_order_relaxed) & BrickStore::Listed)) continue;
+		b->flushedVoxelCount = shown ? shown->flushedVoxelCount : 0;
+	}
+	// the worlds that still share the old store get to see its changes
+	if (store.use_count() == 1) store->DropChanges();
+	std::swap(store, other);
+	bricks = store->bricks;
+	instance = false;
+	return true;
+}
 
 void Tmpl8::VoxelWorld::UpdateTransform() {
 	const float3 center = cube.GetSize() / 2.0f;
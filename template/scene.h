@@ -8,13 +8,63 @@ namespace Tmpl8 {
 
 	//material list
 	inline std::vector <Material> MaterialList = {
-		Material(0, 1.0f, 0.0f, 0.0f, 1.0f) // Default material
+		Material(0, 1.0f, 0.0f, 0.0f, 1.0f).BakeLUT() // Default material
 	};
 
+	// how the occupancy of a brick changed since the last flush
+	enum class OccupancyChange {
+		None,
+		BecameOccupied,
+		BecameEmpty
+	};
+
+	// a brick slot of a store that was edited since the last flush, before it is placed in any world
+	struct StoreChange {
+		int brickIndex;
+		OccupancyChange occupancy;
+	};
+
+	// a brick that was edited since the last flush
+	struct BrickChange {
+		int worldIndex;
+		int brickIndex;
+		float3 boundsMin;	// world space AABB of the brick
+		float3 boundsMax;
+		OccupancyChange occupancy;
+	};
+
+	using BrickChangeCallback = std::function<void(const std::vector<BrickChange>& changes)>;
+
+	// a single voxel write for VoxelWorld::SetVoxels, voxel holds the material index in the top 8 bits
+	struct VoxelEdit {
+		uint x, y, z;
+		uint voxel;
+	};
+
+	// how a CSG edit combines a shape with the voxels that are already there
+	enum class CsgOp {
+		Union,		// writes the voxel inside the shape
+		Subtract,	// clears the voxels inside the shape
+		Paint		// recolours the solid voxels inside the shape, empty ones stay empty
+	};
+
+	// a random number in [0, 1) that only depends on the voxel and the seed, so stochastic patterns come out the same
+	// on any thread and every time they are drawn
+	inline float VoxelHash(const int x, const int y, const int z, const uint seed) {
+		uint h = seed ^ (static_cast<uint>(x) * 0x8da6b343u) ^ (static_cast<uint>(y) * 0xd8163841u) ^ (static_cast<uint>(z) * 0xcb1ab31fu);
+		h ^= h >> 16, h *= 0x7feb352du;
+		h ^= h >> 15, h *= 0x846ca68bu;
+		h ^= h >> 16;
+		return static_cast<float>(h >> 8) * (1.0f / 16777216.0f);
+	}
+
 	struct Brick {
 		unsigned int* grid;
 		std::atomic<size_t> voxelCount = 0;
 		int3 gridPosition;
+		std::atomic<bool> generated = false;	// still exactly what GenerateBrick made, cleared on every edit
+		size_t flushedVoxelCount = 0;		// voxel count at the last flush, to detect occupancy transitions
+		bool ownsGrid = true;				// false when grid points into a page file mapped by a BrickPager
 
 		Brick(const int3 gridPosition) {
 			voxelCount = 0;
@@ -23,12 +73,48 @@ namespace Tmpl8 {
 			memset(grid, 0, BRICKSIZE3 * sizeof(uint));
 		}
 
+		// wraps voxels that live in memory owned by someone else
+		Brick(const int3 gridPosition, uint* mappedGrid, const size_t count) {
+			voxelCount = count;
+			flushedVoxelCount = count;
+			this->gridPosition = gridPosition;
+			grid = mappedGrid;
+			ownsGrid = false;
+		}
+
+		~Brick() {
+			if (ownsGrid) FREE64(grid);
+		}
+
+		// a brick with its own copy of the voxels
+		Brick* Clone() const {
+			Brick* copy = new Brick(gridPosition);
+			memcpy(copy->grid, grid, BRICKSIZE3 * sizeof(uint));
+			copy->voxelCount = voxelCount.load();
+			copy->flushedVoxelCount = flushedVoxelCount;
+			return copy;
+		}
+
 		void Set(const uint x, const uint y, const uint z, const uint v, const int materialIndex = 0);
 		void Clear(const uint v);
-		void FindNearest(Ray& ray, const float& brickEntryT) const;
+
+		// bulk edits skip the atomic count per voxel, the difference is applied once per brick with Commit
+		inline void Write(const uint x, const uint y, const uint z, const uint voxel, int& countDelta) {
+			uint& cell = grid[GetVoxelIndex(x, y, z)];
+			countDelta += static_cast<int>((voxel & 0x00FFFFFF) != 0) - static_cast<int>((cell & 0x00FFFFFF) != 0);
+			cell = voxel;
+		}
+		void Commit(const int countDelta);
+		void FillRegion(const int3& min, const int3& max, const uint voxel);
+		// replaces every voxel, voxels is in x + y * BRICKSIZE + z * BRICKSIZE2 order
+		void Assign(const uint* voxels);
+
+		void FindNearest(Ray& ray, const float& brickEntryT, const int brickEntryAxis = -1) const;
 		bool FindNearestEmpty(Ray& ray, const float& brickEntryT) const;
 		bool IsOccluded(const Ray& ray, const float& brickEntryT) const;
 		bool IsEmpty() const;
+		// the voxel at x, y, z inside the brick
+		inline uint Get(const uint x, const uint y, const uint z) const { return grid[GetVoxelIndex(x, y, z)]; }
 	private:
 		bool Setup3DDDA(const Ray& ray, DDAState& state) const;
 
@@ -42,20 +128,110 @@ namespace Tmpl8 {
 	};
 #endif // TWOLEVEL
 
+	class MappedFile;
+
+	// the bricks of a world, shared by the world and all of its instances. deletes the bricks when the last one goes.
+	// edits mark the slots they change and the first mark since the last flush puts the slot in a list, so a flush only
+	// visits the changed slots and does so once for all the worlds that share the store
+	struct BrickStore {
+		// whether a slot is in the change list, and whether a brick was taken out of it since the last flush and if it
+		// held voxels at that flush. the slot itself can't tell a deleted brick from one that never existed
+		enum SlotChange : uint8_t { Listed = 1, RemovedEmpty = 2, RemovedOccupied = 4, Removed = RemovedEmpty | RemovedOccupied };
+
+		BrickStore(const int brickCount);
+		~BrickStore();
+
+		// safe to call from multiple threads, only the first mark of a slot since the last flush takes the lock
+		inline void MarkChanged(const int index) {
+			if (changes[index].load(std::memory_order_relaxed) & Listed) return;
+			if (changes[index].fetch_or(Listed, std::memory_order_relaxed) & Listed) return;
+			std::lock_guard<std::mutex> lock(changedMutex);
+			changedSlots.push_back(index);
+		}
+		// only the first removal since the last flush knows what was shown
+		void MarkRemoved(const int index, const bool wasOccupied);
+		// merges in the pending SlotChange bits of a slot of the store this one replaces
+		void CarryChange(const int index, const uint8_t change);
+		// the slots marked since the last call with their occupancy transition, clears the marks
+		void TakeChanges(std::vector<StoreChange>& storeChanges);
+		// forgets the pending changes, for a store that no world shows anymore
+		void DropChanges();
+
+		std::atomic<Brick*>* bricks;
+		std::atomic<uint8_t>* changes;	// SlotChange bits per slot
+		const int brickCount;
+		std::shared_ptr<MappedFile> mappedFile;	// keeps the scene file alive that the bricks point into, see SceneFile
+
+	private:
+		std::vector<int> changedSlots;
+		std::vector<int> takenSlots;
+		std::mutex changedMutex;
+	};
+
+	class BrickStreamer;
+	class BrickPager;
 
 	class VoxelWorld {
+		friend class BrickStreamer;
+		friend class BrickPager;
 	public:
 		VoxelWorld(const int3 newGridDimensions = int3(WORLDSIZE / BRICKSIZE));
+		// copies are instances: they show the bricks of the original with their own transform and settings. the bricks
+		// are read only to them, the first edit through an instance gives it a copy of its own
+		VoxelWorld(const VoxelWorld& other);
+		VoxelWorld& operator=(const VoxelWorld&) = delete;
+		~VoxelWorld();
+		// deletes the world, or hands it back to the pool it was acquired from
+		static void Destroy(VoxelWorld* world);
 		void GenerateGrid();
+		// overwrite = false leaves a slot that already holds a brick alone, so edits made in the meantime survive
+		void GenerateBrick(const int index, const float* xCoords, const bool overwrite = true);
+		std::vector<float> GetNoiseXCoordinates() const;
+		// streamed worlds generate their bricks lazily instead of all at once with GenerateGrid, not for worlds with instances
+		void SetStreaming(const bool enabled);
+		// paged worlds keep their bricks in a memory mapped file and only hold the recently used ones in memory.
+		// worlds with instances can't open one
+		bool WritePageFile(const char* path);
+		bool OpenPageFile(const char* path);
+		void ClosePageFile();
 		void FindNearest(Ray& ray) const;
 		void FindNearestEmpty(Ray& ray) const;
 		void Set(const uint x, const uint y, const uint z, const uint v, const int materialIndex = 0);
 		void Clear(const uint v);
+		// the changes taken from the store, placed in this world
+		void CollectChanges(const int worldIndex, const std::vector<StoreChange>& storeChanges, std::vector<BrickChange>& changes) const;
+		// takes the brick out of its slot so the next flush reports it as removed, the caller deletes it
+		Brick* TakeBrick(const int index);
+
+		// bulk edits, grouped by brick and written in parallel across bricks. ranges are [min, max) in voxels
+		void FillBox(const int3& min, const int3& max, const uint v, const int materialIndex = 0);
+		void FillSphere(const int3& center, const float radius, const uint v, const int materialIndex = 0, const float probability = 1.0f);
+		void SetVoxels(std::vector<VoxelEdit>& edits);
+		// writes a dense block of palette indices at offset, size and stride are per world axis so the source can be in any axis order.
+		// palette maps an index to a voxel, 0 leaves the voxel alone. returns the number of voxels written
+		size_t SetDense(const uint8_t* source, const int3& size, const int3& stride, const int3& offset, const uint* palette);
+		// shape(x, y, z, voxel) returns whether to write the voxel at x, y, z and may change the voxel value
+		template <typename Shape>
+		void FillShape(int3 start, int3 end, const uint voxel, const bool allocate, const Shape& shape);
+		// CSG edit of the shape with signed distance sdf(p) in voxels, negative inside, which has to stay within [start, end).
+		// the distance may not grow faster than the distance to the surface, so a brick whose centre is further from the
+		// surface than its corners lies entirely on one side: inside bricks are written with row stores, bricks the
+		// surface crosses are tested per voxel and outside bricks are skipped. with a probability below 1 only voxels
+		// with a VoxelHash below it are edited. union only creates the bricks it writes to
+		template <typename Sdf>
+		void ApplyCsg(const CsgOp op, int3 start, int3 end, const Sdf& sdf, const uint voxel, const float probability = 1.0f, const uint seed = 0);
+		// center and radius in voxels, the same inside test as FillSphere
+		void CsgSphere(const CsgOp op, const float3& center, const float radius, const uint v, const int materialIndex = 0, const float probability = 1.0f, const uint seed = 0);
+		// [min, max) in voxels like FillBox
+		void CsgBox(const CsgOp op, const int3& min, const int3& max, const uint v, const int materialIndex = 0, const float probability = 1.0f, const uint seed = 0);
 
 		bool IsOccluded(const Ray& ray) const;
 		bool DrawImGui(const int index);
 
 		void Resize(const int3 newGridSize);
+		// exchanges the bricks with another store of the same size, so a world can be written double buffered.
+		// false if the sizes don't match
+		bool SwapStore(std::shared_ptr<BrickStore>& other);
 		void UpdateTransform();
 		void UpdateTransformCentered();
 		void UpdateTranformRotateLocal();
@@ -75,13 +251,14 @@ namespace Tmpl8 {
 		float3 scale;
 		int NoiseColor = 0;
 		Cube cube;
-		Brick** bricks;
+		std::atomic<Brick*>* bricks;	// published with a CAS, so parallel writers can create bricks without locks
+		std::shared_ptr<BrickStore> store;	// owns bricks
 		mat4 transform;
 		mat4 invTransform;
-
-	private:
-		bool Setup3DDDA(const Ray& ray, DDAState& state) const;
-		void ResizeCube(const int3 newGridSize);
+		BrickStreamer* streamer = nullptr;
+		BrickPager* pager = nullptr;
+		std::string pageFilePath = "world.vxp";	// edited in the Paging tab of DrawImGui
+		InstancePool* pool = nullptr;	// set for instances from an InstancePool, not copied
 
 		static inline int GetBrickIndex(const int x, const int y, const int z, const int3 gridDimensions) {
 			return x + y * gridDimensions.x + z * gridDimensions.x * gridDimensions.y;
@@ -91,10 +268,113 @@ namespace Tmpl8 {
 			return gridDimensions.x * gridDimensions.y * gridDimensions.z;
 		}
 
+	private:
+		bool Setup3DDDA(const Ray& ray, DDAState& state) const;
+		void ResizeCube(const int3 newGridSize);
+		bool ClampToGrid(int3& start, int3& end, int3& brickMin, int3& brickMax) const;
+		void AllocateBricks(const int3& brickMin, const int3& brickMax);
+		Brick* GetOrCreateBrick(const int index, const int3& gridPosition);
+		Brick* FaultBrick(const int index);
+		// called by everything that writes bricks, so edits through an instance never reach the bricks it shares
+		void MakeStoreWritable();
+		void CopyHit(const Ray& transformedRay, Ray& ray) const;
+
 
 		int3 newGridDimensions;
+		bool instance = false;	// still showing the bricks of the world it was copied from
 	};
 
+	template <typename Shape>
+	void VoxelWorld::FillShape(int3 start, int3 end, const uint voxel, const bool allocate, const Shape& shape) {
+		int3 brickMin, brickMax;
+		if (!ClampToGrid(start, end, brickMin, brickMax)) return;
+		MakeStoreWritable();
+		if (allocate) AllocateBricks(brickMin, brickMax);
+
+		const int3 brickRange = brickMax - brickMin;
+		const int brickCount = brickRange.x * brickRange.y * brickRange.z;
+#pragma omp parallel for schedule(dynamic) if (brickCount > 4)
+		for (int i = 0; i < brickCount; i++) {
+			const int bx = brickMin.x + i % brickRange.x;
+			const int by = brickMin.y + (i / brickRange.x) % brickRange.y;
+			const int bz = brickMin.z + i / (brickRange.x * brickRange.y);
+			Brick* b = FaultBrick(GetBrickIndex(bx, by, bz, gridDimensions));
+			if (!b) continue;
+
+			// the part of the range that falls inside this brick
+			const int3 origin = make_int3(bx, by, bz) * BRICKSIZE;
+			const int3 from = max(start, origin);
+			const int3 to = min(end, origin + BRICKSIZE);
+			int countDelta = 0;
+			for (int z = from.z; z < to.z; z++) {
+				for (int y = from.y; y < to.y; y++) {
+					for (int x = from.x; x < to.x; x++) {
+						uint value = voxel;
+						if (shape(x, y, z, value)) b->Write(x & (BRICKSIZE - 1), y & (BRICKSIZE - 1), z & (BRICKSIZE - 1), value, countDelta);
+					}
+				}
+			}
+			b->Commit(countDelta);
+			store->MarkChanged(GetBrickIndex(bx, by, bz, gridDimensions));
+		}
+	}
+
+	template <typename Sdf>
+	void VoxelWorld::ApplyCsg(const CsgOp op, int3 start, int3 end, const Sdf& sdf, const uint voxel, const float probability, const uint seed) {
+		int3 brickMin, brickMax;
+		if (!ClampToGrid(start, end, brickMin, brickMax)) return;
+		MakeStoreWritable();
+		// the distance from the centre of a brick to the voxels in its corners
+		const float brickRadius = 0.5f * (BRICKSIZE - 1) * 1.7320508f;
+		const uint value = op == CsgOp::Subtract ? 0 : voxel;
+		const bool everyVoxel = probability >= 1.0f;
+
+		const int3 brickRange = brickMax - brickMin;
+		const int brickCount = brickRange.x * brickRange.y * brickRange.z;
+#pragma omp parallel for schedule(dynamic) if (brickCount > 4)
+		for (int i = 0; i < brickCount; i++) {
+			const int bx = brickMin.x + i % brickRange.x;
+			const int by = brickMin.y + (i / brickRange.x) % brickRange.y;
+			const int bz = brickMin.z + i / (brickRange.x * brickRange.y);
+			const int3 origin = make_int3(bx, by, bz) * BRICKSIZE;
+			const float distance = sdf(make_float3(origin) + 0.5f * (BRICKSIZE - 1));
+			if (distance >= brickRadius) continue;
+			const bool inside = distance < -brickRadius;
+
+			const int index = GetBrickIndex(bx, by, bz, gridDimensions);
+			Brick* b = FaultBrick(index);
+			// only a union adds voxels, the other operations have nothing to do in empty bricks
+			if (op != CsgOp::Union && (!b || b->IsEmpty())) continue;
+
+			const int3 from = max(start, origin);
+			const int3 to = min(end, origin + BRICKSIZE);
+			if (inside && everyVoxel && op != CsgOp::Paint) {
+				if (!b) b = GetOrCreateBrick(index, make_int3(bx, by, bz));
+				b->FillRegion(from - origin, to - origin, value);
+				store->MarkChanged(index);
+				continue;
+			}
+
+			int countDelta = 0;
+			bool written = false;
+			for (int z = from.z; z < to.z; z++) {
+				for (int y = from.y; y < to.y; y++) {
+					for (int x = from.x; x < to.x; x++) {
+						if (!everyVoxel && VoxelHash(x, y, z, seed) >= probability) continue;
+						if (!inside && !(sdf(make_float3(make_int3(x, y, z))) < 0.0f)) continue;
+						if (op == CsgOp::Paint && !(b->Get(x - origin.x, y - origin.y, z - origin.z) & 0x00FFFFFF)) continue;
+						if (!b) b = GetOrCreateBrick(index, make_int3(bx, by, bz));
+						b->Write(x - origin.x, y - origin.y, z - origin.z, value, countDelta);
+						written = true;
+					}
+				}
+			}
+			if (!written) continue;
+			b->Commit(countDelta);
+			store->MarkChanged(index);
+		}
+	}
+
 
 	class Scene {
 	public:
@@ -104,14 +384,38 @@ namespace Tmpl8 {
 		void FindNearestEmpty(Ray& ray) const;
 		bool IsOccluded(Ray& ray) const;
 		bool IsOccluded(Ray& ray, const int worldIndex) const;
+		// traces every ray in the batch, flags are RayQueryFlags. rays go in packets of 8 that test the bounds of the
+		// worlds together, so worlds a packet misses aren't traversed at all. packets run in parallel
+		void TraceBatch(RayBatch& batch, const int flags = RayQueryClosest) const;
 		bool DrawImGui();
 		void Clear(const uint v);
 		void Set(const uint x, const uint y, const uint z, const uint v, const int materialIndex = 0, const int worldIndex = 0);
+		void FillBox(const int3& min, const int3& max, const uint v, const int materialIndex = 0, const int worldIndex = 0);
+		void FillSphere(const int3& center, const float radius, const uint v, const int materialIndex = 0, const int worldIndex = 0, const float probability = 1.0f);
+		void CsgSphere(const CsgOp op, const float3& center, const float radius, const uint v, const int materialIndex = 0, const int worldIndex = 0, const float probability = 1.0f, const uint seed = 0);
+		void CsgBox(const CsgOp op, const int3& min, const int3& max, const uint v, const int materialIndex = 0, const int worldIndex = 0, const float probability = 1.0f, const uint seed = 0);
+		void SetVoxels(std::vector<VoxelEdit>& edits, const int worldIndex = 0);
+		VoxelWorld* GetWorld(const int worldIndex);
+		void UpdateStreaming(const float3& cameraPosition);
 
 		void ConstructBVH();
 		void CLearWorlds();
+		// adds a pooled instance of prefab, it shows the prefab's bricks so edits to the prefab show up in it. edits through
+		// the instance don't reach the prefab. an invalid handle for streamed or paged prefabs, their bricks go away with
+		// the streamer or pager
+		WorldHandle SpawnInstance(const VoxelWorld& prefab);
+		// takes a world out of the scene and destroys it at the next FlushRemovals
+		void RemoveWorld(const WorldHandle& handle);
+		// call once per frame before tracing
+		void FlushRemovals();
+
+		// gathers the bricks edited since the last call and notifies the subscribers, call once per frame
+		void FlushChanges();
+		const std::vector<BrickChange>& GetChanges() const { return changes; }
+		int Subscribe(const BrickChangeCallback& callback);
+		void Unsubscribe(const int id);
 
-		std::vector<VoxelWorld*> worlds;
+		WorldRegistry worlds;	// indexed by slot, which is what ray.worldIndex refers to
 #ifndef _DEBUG
 		float2 dummy;
 #endif
@@ -129,6 +433,13 @@ namespace Tmpl8 {
 		//};
 	private:
 		int3 newWorldSize = int3(16, 16, 16);
+		InstancePool instances;
+
+		std::vector<BrickChange> changes;
+		std::vector<std::pair<BrickStore*, int>> storeOrder;	// the active worlds by store, so shared stores are flushed once
+		std::vector<StoreChange> storeChanges;
+		std::vector<std::pair<int, BrickChangeCallback>> subscribers;
+		int nextSubscriberId = 0;
 
 		//BVHNode* root;
 	};
@@ -53,7 +53,8 @@ uint RandomUInt(uint& customSeed) {
 float RandomFloat(uint& customSeed) { return RandomUInt(customSeed) * 2.3283064365387e-10f; }
 
 // Perlin noise implementation - https://stackoverflow.com/questions/29711668/perlin-noise-generation
-static int numX = 512, numY = 512, numOctaves = 3, primeIndex = 0;
+static int numX = 512, numY = 512, primeIndex = 0;
+static constexpr int numOctaves = 3;
 static float persistence = 0.5f;
 static int primes[10][3] = {
 	{ 995615039, 600173719, 701464987 }, { 831731269, 162318869, 136250887 }, { 174329291, 946737083, 245679977 },
@@ -119,6 +120,113 @@ float noise3D(const float x, const float y, const float z, float frequency, floa
 	return noise;
 }
 
+// 8-wide versions of the noise functions above, giving the same results lane by lane
+static __m256 Noise8(const int i, const __m256i x, const __m256i y) {
+	__m256i n = _mm256_add_epi32(x, _mm256_mullo_epi32(y, _mm256_set1_epi32(57)));
+	n = _mm256_xor_si256(_mm256_slli_epi32(n, 13), n);
+	__m256i t = _mm256_mullo_epi32(_mm256_mullo_epi32(n, n), _mm256_set1_epi32(primes[i][0]));
+	t = _mm256_mullo_epi32(n, _mm256_add_epi32(t, _mm256_set1_epi32(primes[i][1])));
+	t = _mm256_and_si256(_mm256_add_epi32(t, _mm256_set1_epi32(primes[i][2])), _mm256_set1_epi32(0x7fffffff));
+	return _mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(_mm256_cvtepi32_ps(t), _mm256_set1_ps(1.0f / 1073741824.0f)));
+}
+static __m256 SmoothedNoise8(const int i, const __m256i x, const __m256i y) {
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256i x0 = _mm256_sub_epi32(x, one), x1 = _mm256_add_epi32(x, one);
+	const __m256i y0 = _mm256_sub_epi32(y, one), y1 = _mm256_add_epi32(y, one);
+	__m256 corners = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(Noise8(i, x0, y0), Noise8(i, x1, y0)), Noise8(i, x0, y1)), Noise8(i, x1, y1));
+	__m256 sides = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(Noise8(i, x0, y), Noise8(i, x1, y)), Noise8(i, x, y0)), Noise8(i, x, y1));
+	corners = _mm256_mul_ps(corners, _mm256_set1_ps(1.0f / 16));
+	sides = _mm256_mul_ps(sides, _mm256_set1_ps(1.0f / 8));
+	const __m256 center = _mm256_mul_ps(Noise8(i, x, y), _mm256_set1_ps(1.0f / 4));
+	return _mm256_add_ps(_mm256_add_ps(corners, sides), center);
+}
+static __m256 Interpolate8(const __m256 a, const __m256 b, const __m256 f) {
+	return _mm256_add_ps(_mm256_mul_ps(a, _mm256_sub_ps(_mm256_set1_ps(1.0f), f)), _mm256_mul_ps(b, f));
+}
+// fx and fy are the interpolation weights, which only depend on the fractional coordinates and are computed once per block
+static __m256 InterpolatedNoise8(const int i, const __m256i x, const __m256 fx, const __m256i y, const __m256 fy) {
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256 v1 = SmoothedNoise8(i, x, y);
+	const __m256 v2 = SmoothedNoise8(i, _mm256_add_epi32(x, one), y);
+	const __m256 v3 = SmoothedNoise8(i, x, _mm256_add_epi32(y, one));
+	const __m256 v4 = SmoothedNoise8(i, _mm256_add_epi32(x, one), _mm256_add_epi32(y, one));
+	return Interpolate8(Interpolate8(v1, v2, fx), Interpolate8(v3, v4, fx), fy);
+}
+
+float2 noise3DBlock(const float* x, const float* y, const float* z, const float threshold, float* out, float frequency, float amplitude) {
+	// every 2D noise term only depends on two of the three axes, so per octave each term is an 8x8 table instead of 512 evaluations
+	ALIGN(32) float xy[numOctaves][8][8], xz[numOctaves][8][8], yx[numOctaves][8][8], zx[numOctaves][8][8];	// [octave][y or z][x]
+	ALIGN(32) float yz[numOctaves][8][8], zy[numOctaves][8][8];										// [octave][z][y]
+	float amplitudes[numOctaves];
+	float2 bounds = float2(0);
+	amplitude /= 6.0f;
+	for (int i = 0; i < numOctaves; ++i) {
+		// integer coordinates and interpolation weights per axis
+		ALIGN(32) int integer[3][8];
+		ALIGN(32) float weight[3][8];
+		const float* coords[3] = { x, y, z };
+		for (int axis = 0; axis < 3; axis++) {
+			for (int k = 0; k < 8; k++) {
+				const float c = coords[axis][k] * frequency;
+				integer[axis][k] = (int)c;
+				weight[axis][k] = (1 - cosf((c - integer[axis][k]) * 3.1415927f)) * 0.5f;
+			}
+		}
+		__m256i lanes[3];
+		__m256 laneWeights[3];
+		for (int axis = 0; axis < 3; axis++) {
+			lanes[axis] = _mm256_load_si256(reinterpret_cast<const __m256i*>(integer[axis]));
+			laneWeights[axis] = _mm256_load_ps(weight[axis]);
+		}
+
+		for (int k = 0; k < 8; k++) {
+			const __m256i iy = _mm256_set1_epi32(integer[1][k]), iz = _mm256_set1_epi32(integer[2][k]);
+			const __m256 wy = _mm256_set1_ps(weight[1][k]), wz = _mm256_set1_ps(weight[2][k]);
+			_mm256_store_ps(xy[i][k], InterpolatedNoise8(i, lanes[0], laneWeights[0], iy, wy));
+			_mm256_store_ps(xz[i][k], InterpolatedNoise8(i, lanes[0], laneWeights[0], iz, wz));
+			_mm256_store_ps(yx[i][k], InterpolatedNoise8(i, iy, wy, lanes[0], laneWeights[0]));
+			_mm256_store_ps(zx[i][k], InterpolatedNoise8(i, iz, wz, lanes[0], laneWeights[0]));
+			_mm256_store_ps(yz[i][k], InterpolatedNoise8(i, lanes[1], laneWeights[1], iz, wz));
+			_mm256_store_ps(zy[i][k], InterpolatedNoise8(i, iz, wz, lanes[1], laneWeights[1]));
+		}
+
+		// bound the octave by the extremes of its tables
+		float low = 0, high = 0;
+		for (const auto* table : { xy[i], xz[i], yz[i], yx[i], zx[i], zy[i] }) {
+			const float* values = &table[0][0];
+			low += *std::min_element(values, values + 64);
+			high += *std::max_element(values, values + 64);
+		}
+		bounds.x += amplitude >= 0 ? low * amplitude : high * amplitude;
+		bounds.y += amplitude >= 0 ? high * amplitude : low * amplitude;
+
+		amplitudes[i] = amplitude;
+		amplitude *= persistence;
+		frequency *= 2.0f;
+	}
+	// leave some room for rounding differences between the bounds and the actual sums
+	bounds.x -= 1e-4f;
+	bounds.y += 1e-4f;
+	if (bounds.y <= threshold || bounds.x > threshold) return bounds;
+
+	// same summation order as noise3D
+	for (int k = 0; k < 8; k++) {
+		for (int j = 0; j < 8; j++) {
+			__m256 noise = _mm256_setzero_ps();
+			for (int i = 0; i < numOctaves; ++i) {
+				__m256 sum = _mm256_add_ps(_mm256_load_ps(xy[i][j]), _mm256_load_ps(xz[i][k]));
+				sum = _mm256_add_ps(sum, _mm256_set1_ps(yz[i][k][j]));
+				sum = _mm256_add_ps(sum, _mm256_load_ps(yx[i][j]));
+				sum = _mm256_add_ps(sum, _mm256_load_ps(zx[i][k]));
+				sum = _mm256_add_ps(sum, _mm256_set1_ps(zy[i][k][j]));
+				noise = _mm256_add_ps(noise, _mm256_mul_ps(sum, _mm256_set1_ps(amplitudes[i])));
+			}
+			_mm256_storeu_ps(out + j * 8 + k * 64, noise);
+		}
+	}
+	return bounds;
+}
+
 // math implementations
 float4::float4(const float3& a, const float d) {
 	x = a.x, y = a.y, z = a.z;
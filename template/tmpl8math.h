@@ -1517,6 +1517,9 @@ float3 TransformVector_SSE(const __m128& a, const mat4& M);
 // Perlin noise
 float noise2D(const float x, const float y);
 float noise3D(const float x, const float y, const float z, float frequency = 5.0f, float amplitude = 0.5f);
+// noise3D for a block of 8x8x8 coordinates (x, y and z hold 8 values each), returns conservative (min, max) bounds of the block.
+// out (x + y * 8 + z * 64) is only filled when the bounds don't already put the whole block on one side of threshold.
+float2 noise3DBlock(const float* x, const float* y, const float* z, const float threshold, float* out, float frequency = 5.0f, float amplitude = 0.5f);
 
 inline quat EulerToQuaternion(const float3& euler) {
 	float c1 = cosf(euler.x / 2);